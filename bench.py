@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+"""
+Run benchmark scripts, comparing interpreter configurations.
+"""
+import argparse
+import glob
+import os
+import subprocess
+import sys
+import time
+
+CONFIGS = [
+    ('no analysis', ['-A']),
+    ('default', []),
+    ('jit', ['-J']),
+]
+
+
+def time_script(script, runner, flags, repeat):
+    best = None
+    for _ in range(repeat):
+        start = time.perf_counter()
+        proc = subprocess.run([runner] + flags + [script],
+                              stdout=subprocess.DEVNULL)
+        elapsed = time.perf_counter() - start
+        if proc.returncode != 0:
+            print('{} failed with code {}'.format(script, proc.returncode))
+            sys.exit(1)
+        if best is None or elapsed < best:
+            best = elapsed
+    return best
+
+
+def run_benchmarks(scripts, runner, repeat):
+    for script in scripts:
+        print('{}:'.format(script))
+        baseline = None
+        for name, flags in CONFIGS:
+            elapsed = time_script(script, runner, flags, repeat)
+            if baseline is None:
+                baseline = elapsed
+            print('  {:<12} {:8.3f}s  ({:.2f}x)'.format(
+                name, elapsed, baseline / elapsed))
+
+
+if __name__ == '__main__':
+    ap = argparse.ArgumentParser('run benchmarks for funlisp')
+    ap.add_argument('directory', help='directory of benchmarks to run')
+    ap.add_argument('--runner', '-r', help='binary to run with',
+        default='bin/funlisp')
+    ap.add_argument('--repeat', '-n', type=int, default=3,
+        help='number of runs of each benchmark (best is reported)')
+    args = ap.parse_args()
+    run_benchmarks(
+        sorted(glob.glob(os.path.join(args.directory, '*.lisp'))),
+        args.runner, args.repeat)
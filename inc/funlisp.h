@@ -93,6 +93,127 @@ void lisp_disable_strcache(lisp_runtime *rt);
  */
 void lisp_disable_symcache(lisp_runtime *rt);
 
+/**
+ * Enable constant folding.
+ *
+ * When constant folding is enabled, the body of each lambda and macro is
+ * simplified as it is created: calls to pure builtins (such as arithmetic and
+ * comparisons) whose arguments are all constant are replaced by their result,
+ * ``if`` and ``cond`` with constant conditions are replaced by the branch which
+ * would be taken, and quoted constants are simplified. A builtin is only
+ * folded when its name is not bound by the lambda itself, but the builtin is
+ * looked up at the time the lambda is created. So, code which redefines
+ * builtins like ``+`` after using them may behave differently with folding
+ * enabled. Folding is disabled by default.
+ * @param rt runtime to enable constant folding on
+ */
+void lisp_enable_folding(lisp_runtime *rt);
+
+/**
+ * Disable constant folding.
+ * @param rt runtime to disable constant folding on
+ */
+void lisp_disable_folding(lisp_runtime *rt);
+
+/**
+ * Enable analysis of special forms.
+ *
+ * When analysis is enabled, special forms (``if``, ``cond``, ``let``,
+ * ``lambda``, ``macro``, ``define``, ``quote``, ``quasiquote`` and ``progn``)
+ * within the body of a lambda or macro are parsed once, when the lambda is
+ * created. They are then
+ * evaluated directly, rather than by calling the builtin which implements them
+ * each time. Similarly, arithmetic and comparisons with one or two arguments
+ * (e.g. ``(+ a b)`` or ``(< a b)``) are computed directly. These forms are
+ * recognized at the time the lambda is created, but each checks that its name
+ * is still bound to the same builtin before it runs, and is evaluated as usual
+ * if it isn't. So unlike constant folding, redefining ``if`` or ``+`` (for
+ * instance) affects lambdas which were already created. Forms which are not
+ * well formed are left
+ * alone, so that they produce their usual error when evaluated. Variable
+ * references and function calls are also parsed ahead of time: variables bound
+ * within the lambda are found without searching through every scope, and
+ * arguments to lambdas and builtins are evaluated straight into an array rather
+ * than a new list. Analysis is enabled by default.
+ * @param rt runtime to enable analysis on
+ */
+void lisp_enable_analysis(lisp_runtime *rt);
+
+/**
+ * Disable analysis of special forms. See lisp_enable_analysis().
+ * @param rt runtime to disable analysis on
+ */
+void lisp_disable_analysis(lisp_runtime *rt);
+
+/**
+ * Enable checking of calls as lambdas are created.
+ *
+ * When checking is enabled, analysis (see lisp_enable_analysis()) also looks
+ * at each call to a lambda or builtin which it can identify, and makes
+ * creating the lambda fail if a call would certainly fail when it runs: it
+ * passes the wrong number of arguments, or a builtin is given a constant (or
+ * the result of another builtin) of the wrong type. The error is reported with
+ * the line of the call, as lisp_print_error() shows it. Calls to lambdas which
+ * pass the right number of arguments don't count them again each time they
+ * run. The check uses the definitions which exist when the lambda is created,
+ * so redefining a function with a different number of arguments may be
+ * reported by lambdas which call it. Checking works even when analysis is
+ * disabled, in which case the code is walked only for its errors, and calls
+ * don't skip counting their arguments. Checking is disabled by default.
+ * @param rt runtime to enable checking on
+ */
+void lisp_enable_checking(lisp_runtime *rt);
+
+/**
+ * Disable checking of calls. See lisp_enable_checking().
+ * @param rt runtime to disable checking on
+ */
+void lisp_disable_checking(lisp_runtime *rt);
+
+/**
+ * Enable the JIT compiler. Once a lambda has been called a number of times, its
+ * body is compiled to machine code, which is used for later calls. Integer
+ * arithmetic and comparisons, ``if``, ``cond`` and calls to builtins are
+ * compiled, while anything else is passed back to the interpreter. The JIT
+ * works best along with analysis, see lisp_enable_analysis(). It is only
+ * available on x86-64 Linux, and has no effect elsewhere. The JIT is disabled
+ * by default.
+ * @param rt runtime to enable the JIT on
+ */
+void lisp_enable_jit(lisp_runtime *rt);
+
+/**
+ * Disable the JIT compiler. Lambdas which were already compiled continue to
+ * use their machine code. See lisp_enable_jit().
+ * @param rt runtime to disable the JIT on
+ */
+void lisp_disable_jit(lisp_runtime *rt);
+
+/**
+ * Counts of call sites which have specialized themselves, see
+ * lisp_get_quicken_stats().
+ */
+struct lisp_quicken_stats {
+	/** Call sites which were specialized to the lambda or builtin they called
+	 * the first time they ran. */
+	unsigned long specialized;
+	/** Specialized call sites which later called something else, and went back
+	 * to the generic version. */
+	unsigned long deoptimized;
+};
+
+/**
+ * Get statistics about call site specialization. When analysis is enabled
+ * (see lisp_enable_analysis()), each call within a lambda is specialized after
+ * it first runs: it checks that it is calling the same lambda or builtin as
+ * before, and if so calls it directly. When the check fails, the call site is
+ * deoptimized, and uses the general purpose version from then on. The counts
+ * are for the entire life of the runtime.
+ * @param rt runtime to get statistics for
+ * @param stats where to store the statistics
+ */
+void lisp_get_quicken_stats(lisp_runtime *rt, struct lisp_quicken_stats *stats);
+
 /** @} */
 
 /*
@@ -151,12 +272,27 @@ typedef struct lisp_scope lisp_scope;
 typedef struct lisp_text lisp_symbol;
 
 /**
- * ::lisp_integer contains an int object of whatever size the C implementation
- * supports.
+ * ::lisp_integer contains a long. Arithmetic which would overflow a long
+ * produces a ::lisp_bignum instead.
  * @ingroup types
  */
 typedef struct lisp_integer lisp_integer;
 
+/**
+ * ::lisp_bignum is an integer of any size, which is too large to fit in a
+ * ::lisp_integer. Integers are always a ::lisp_integer when they fit, so the
+ * same number is never represented both ways.
+ * @ingroup types
+ */
+typedef struct lisp_bignum lisp_bignum;
+
+/**
+ * ::lisp_float contains a double. Arithmetic on a float and an integer gives a
+ * float.
+ * @ingroup types
+ */
+typedef struct lisp_float lisp_float;
+
 /**
  * This is a string (which occurs quoted in lisp source)
  * @ingroup types
@@ -202,6 +338,41 @@ typedef struct lisp_list lisp_list;
  */
 typedef struct lisp_module lisp_module;
 
+/**
+ * ::lisp_vector is a fixed number of values, which may be indexed in constant
+ * time.
+ * @ingroup types
+ */
+typedef struct lisp_vector lisp_vector;
+
+/**
+ * ::lisp_hashmap maps keys to values. Keys are found by value, as ``equal?``
+ * compares them, so two strings with the same contents are the same key.
+ * @ingroup types
+ */
+typedef struct lisp_hashmap lisp_hashmap;
+
+/**
+ * ::lisp_strbuf is a mutable string, which Lisp code creates with
+ * ``make-string-builder`` and appends to with ``string-builder-append!``.
+ * @ingroup types
+ */
+typedef struct lisp_strbuf lisp_strbuf;
+
+/**
+ * ::lisp_rope is a concatenation of strings, which ``string-append`` returns
+ * when its result is long, so that appending to it doesn't copy the whole
+ * string again.
+ * @ingroup types
+ */
+typedef struct lisp_rope lisp_rope;
+
+/**
+ * Multiple values returned at once, see lisp_values_new().
+ * @ingroup types
+ */
+typedef struct lisp_values lisp_values;
+
 /**
  * @defgroup value Lisp Values
  * @{
@@ -256,6 +427,25 @@ lisp_value *lisp_eval(lisp_runtime *rt, lisp_scope *scope, lisp_value *value);
 lisp_value *lisp_call(lisp_runtime *rt, lisp_scope *scope, lisp_value *callable,
                       lisp_list *arguments);
 
+/**
+ * Call a callable object with an array of arguments which are already
+ * evaluated. Unlike lisp_call(), there is no need to build a list or to quote
+ * the arguments, and calling a lambda or builtin this way allocates nothing
+ * beyond what the function itself does. Macros and builtins which don't
+ * evaluate their arguments receive the values quoted, as if they had been
+ * written in the code.
+ * @param rt runtime
+ * @param scope scope in which we are being evaluated
+ * @param callable value to call
+ * @param argc number of arguments
+ * @param argv array of @a argc evaluated arguments, which the callable may
+ * modify
+ * @return the result of calling @a callable with the arguments
+ * @retval NULL when an error occurs
+ */
+lisp_value *lisp_call_v(lisp_runtime *rt, lisp_scope *scope,
+                        lisp_value *callable, int argc, lisp_value **argv);
+
 /**
  * Compare two values for equality by value (not pointer). Generally this
  * comparison should only be valid among objects of the same type.
@@ -495,6 +685,18 @@ extern lisp_type *type_symbol;
  */
 extern lisp_type *type_integer;
 
+/**
+ * Type object of ::lisp_bignum, for type checking.
+ * @sa lisp_is()
+ */
+extern lisp_type *type_bignum;
+
+/**
+ * Type object of ::lisp_float, for type checking.
+ * @sa lisp_is()
+ */
+extern lisp_type *type_float;
+
 /**
  * Type object of ::lisp_string, for type checking.
  * @sa lisp_is()
@@ -518,6 +720,36 @@ extern lisp_type *type_lambda;
  */
 extern lisp_type *type_module;
 
+/**
+ * Type object of ::lisp_values, for type checking.
+ * @sa lisp_is()
+ */
+extern lisp_type *type_values;
+
+/**
+ * Type object of ::lisp_vector, for type checking.
+ * @sa lisp_is()
+ */
+extern lisp_type *type_vector;
+
+/**
+ * Type object of ::lisp_hashmap, for type checking.
+ * @sa lisp_is()
+ */
+extern lisp_type *type_hashmap;
+
+/**
+ * Type object of ::lisp_strbuf, for type checking.
+ * @sa lisp_is()
+ */
+extern lisp_type *type_strbuf;
+
+/**
+ * Type object of ::lisp_rope, for type checking.
+ * @sa lisp_is()
+ */
+extern lisp_type *type_rope;
+
 /**
  * Flag instructing string/symbol creation routines that they should copy the
  * string buffer itself, and use the copy rather than the original argument.
@@ -598,14 +830,140 @@ char *lisp_symbol_get(lisp_symbol *s);
  * @param n the integer value
  * @return newly allocated integer
  */
-lisp_integer *lisp_integer_new(lisp_runtime *rt, int n);
+lisp_integer *lisp_integer_new(lisp_runtime *rt, long n);
 
 /**
  * Retrieve the integer value from a ::lisp_integer.
  * @param integer ::lisp_integer to return from
- * @return the int value
+ * @return the long value
+ */
+long lisp_integer_get(lisp_integer *integer);
+
+/**
+ * Create an integer from a string of decimal digits, optionally preceded by a
+ * minus sign. Parsing stops at the first character which isn't a digit.
+ * @param rt runtime
+ * @param s the digits
+ * @return a ::lisp_integer if the value fits in a long, or else a ::lisp_bignum
+ */
+lisp_value *lisp_integer_from_string(lisp_runtime *rt, char *s);
+
+/**
+ * Create a new float.
+ * @param rt runtime
+ * @param x the value
+ * @return newly allocated float
+ */
+lisp_float *lisp_float_new(lisp_runtime *rt, double x);
+
+/**
+ * Retrieve the value from a ::lisp_float.
+ * @param f ::lisp_float to return from
+ * @return the double value
+ */
+double lisp_float_get(lisp_float *f);
+
+/**
+ * Create a new vector.
+ * @param rt runtime
+ * @param n number of items
+ * @param fill value of each item, which must not be NULL
+ * @return newly allocated vector
+ */
+lisp_vector *lisp_vector_new(lisp_runtime *rt, int n, lisp_value *fill);
+
+/**
+ * Return the number of items in a vector.
+ * @param v vector
+ * @return length of the vector
+ */
+int lisp_vector_length(lisp_vector *v);
+
+/**
+ * Retrieve an item from a vector.
+ * @param v vector
+ * @param index index of the item, less than lisp_vector_length()
+ * @return the item
+ */
+lisp_value *lisp_vector_get(lisp_vector *v, int index);
+
+/**
+ * Replace an item of a vector.
+ * @param v vector
+ * @param index index of the item, less than lisp_vector_length()
+ * @param item new value of the item
+ */
+void lisp_vector_set(lisp_vector *v, int index, lisp_value *item);
+
+/**
+ * Create a new, empty hash map.
+ * @param rt runtime
+ * @return newly allocated hash map
+ */
+lisp_hashmap *lisp_hashmap_new(lisp_runtime *rt);
+
+/**
+ * Return the value a hash map has for a key.
+ * @param map hash map
+ * @param key key to look up
+ * @return the value, or NULL if @a key isn't in @a map
+ */
+lisp_value *lisp_hashmap_get(lisp_hashmap *map, lisp_value *key);
+
+/**
+ * Set the value a hash map has for a key, replacing any existing value.
+ * @warning A key which is changed after it is added (for example, a vector
+ * which is modified) may no longer be found.
+ * @param map hash map
+ * @param key key to set
+ * @param value new value of @a key
+ */
+void lisp_hashmap_set(lisp_hashmap *map, lisp_value *key, lisp_value *value);
+
+/**
+ * Remove a key from a hash map.
+ * @param map hash map
+ * @param key key to remove
+ * @return 1 if @a key was removed, or 0 if it wasn't in @a map
+ */
+int lisp_hashmap_remove(lisp_hashmap *map, lisp_value *key);
+
+/**
+ * Return the number of keys in a hash map.
+ * @param map hash map
+ * @return number of keys
  */
-int lisp_integer_get(lisp_integer *integer);
+int lisp_hashmap_length(lisp_hashmap *map);
+
+/**
+ * Return multiple values, as the ``values`` builtin does. A builtin may return
+ * the result of this, which ``call-with-values`` and ``let-values`` receive as
+ * separate values. Any of @a values which is itself multiple values counts as
+ * its first value (or nil, if it has none). The result is a new object, like
+ * any other, which holds up to four values without a separate allocation.
+ * @param rt runtime
+ * @param n number of values
+ * @param values array of @a n values, which is copied
+ * @return the only value when @a n is 1, otherwise a new ::lisp_values
+ */
+lisp_value *lisp_values_new(lisp_runtime *rt, int n, lisp_value **values);
+
+/**
+ * Return the number of values in a result, which is 1 unless it is a
+ * ::lisp_values.
+ * @param result result of a call or evaluation
+ * @return number of values
+ */
+int lisp_values_count(lisp_value *result);
+
+/**
+ * Return one of the values in a result. A result which isn't a ::lisp_values
+ * is its own first (and only) value.
+ * @param result result of a call or evaluation
+ * @param index index of the value, less than lisp_values_count()
+ * @return the value
+ */
+lisp_value *lisp_values_get(lisp_value *result, int index);
 
 /**
  * @}
@@ -626,6 +984,24 @@ int lisp_integer_get(lisp_integer *integer);
  */
 typedef lisp_value * (*lisp_builtin_func)(lisp_runtime*, lisp_scope*, lisp_list*, void*);
 
+/**
+ * A built-in function which receives its arguments as an array, rather than a
+ * list. Takes five arguments:
+ * 1. The ::lisp_runtime associated with it.
+ * 2. The ::lisp_scope this function is being called executed within.
+ * 3. The number of arguments.
+ * 4. An array of the arguments. These may or may not have been evaluated,
+ *    depending on whether ``evald`` was set when creating the builtin object.
+ * 5. The user context associated with this builtin.
+ *
+ * The argument array is owned by the runtime, and is only valid until the
+ * builtin returns. Builtins may modify the array, which is handy for storing
+ * temporary values that must be kept safe from garbage collection. Since no
+ * argument list needs to be allocated, these builtins are cheaper to call than
+ * ::lisp_builtin_func.
+ */
+typedef lisp_value * (*lisp_builtin_func_v)(lisp_runtime*, lisp_scope*, int, lisp_value**, void*);
+
 /**
  * Create a new ::lisp_builtin from a function pointer, with a given name.
  * @warning Namse of builtins are not garbage collected, since they are almost
@@ -657,6 +1033,35 @@ lisp_builtin *lisp_builtin_new(lisp_runtime *rt, char *name,
 void lisp_scope_add_builtin(lisp_runtime *rt, lisp_scope *scope, char *name,
                             lisp_builtin_func call, void *user, int evald);
 
+/**
+ * Create a new ::lisp_builtin which receives its arguments as an array. See
+ * ::lisp_builtin_func_v and lisp_builtin_new().
+ * @param rt runtime
+ * @param name name of the builtin. the interpreter will never free the name!
+ * @param call function pointer of the builtin
+ * @param user a user context pointer which will be given to the builtin
+ * @param evald non-zero if arguments should be evaluated before being given to
+ * this builtin. Zero if arguments should be given as-is.
+ * @return new builtin object
+ */
+lisp_builtin *lisp_builtin_new_v(lisp_runtime *rt, char *name,
+                                 lisp_builtin_func_v call, void *user,
+                                 int evald);
+
+/**
+ * Shortcut to declare a builtin function which receives its arguments as an
+ * array. See ::lisp_builtin_func_v and lisp_scope_add_builtin().
+ * @param rt runtime
+ * @param scope scope to bind builtin in
+ * @param name name of builtin
+ * @param call function pointer defining the builtin
+ * @param user a user context pointer which will be given to the builtin
+ * @param evald non-zero if arguments should be evaluated before being given to
+ * this builtin. Zero if arguments should be given as-is.
+ */
+void lisp_scope_add_builtin_v(lisp_runtime *rt, lisp_scope *scope, char *name,
+                              lisp_builtin_func_v call, void *user, int evald);
+
 /**
  * Given a list of arguments, evaluate each of them within a scope and return a
  * new list containing the evaluated arguments. This is most useful for
@@ -687,6 +1092,7 @@ lisp_value *lisp_progn(lisp_runtime *rt, lisp_scope *scope, lisp_list *l);
  * recognized:
  *
  *     d - integer
+ *     f - float
  *     l - list
  *     s - symbol
  *     S - string
@@ -694,6 +1100,8 @@ lisp_value *lisp_progn(lisp_runtime *rt, lisp_scope *scope, lisp_list *l);
  *     e - error
  *     b - builtin
  *     t - type
+ *     v - vector
+ *     h - hash map
  *     * - anything
  *     R - Rest of arguments
  *
@@ -722,6 +1130,23 @@ lisp_value *lisp_progn(lisp_runtime *rt, lisp_scope *scope, lisp_list *l);
  */
 int lisp_get_args(lisp_runtime *rt, lisp_list *list, char *format, ...);
 
+/**
+ * Like lisp_get_args(), but for builtins which receive their arguments as an
+ * array (see ::lisp_builtin_func_v). The format codes are the same, except that
+ * 'R' is not supported, since the remaining arguments are simply the rest of
+ * the array.
+ *
+ * @param rt runtime
+ * @param argc Number of arguments
+ * @param argv Array of arguments
+ * @param format Format string
+ * @param ... Destination pointer to place results
+ * @retval 1 on success (true)
+ * @retval 0 on failure (false)
+ */
+int lisp_get_args_v(lisp_runtime *rt, int argc, lisp_value **argv,
+                    char *format, ...);
+
 /**
  * @}
  * @defgroup modules Modules
@@ -946,6 +1371,7 @@ enum lisp_errno {
 	LE_ASSERT,   /* assertion error */
 	LE_VALUE,    /* invalid argument */
 	LE_ERRNO,    /* used for C library errors, does perror() */
+	LE_ESCAPE,   /* an escape continuation is unwinding to its call/ec */
 
 	LE_MAX_ERR   /* not a real error, don't use */
 };
@@ -963,6 +1389,10 @@ extern const char *lisp_error_name[LE_MAX_ERR];
  *     return lisp_error(rt, LE_ERROR, "you broke something");
  * @endcode
  *
+ * The message is not copied, so it should usually be a string literal. The
+ * stack trace is not built until the error is printed (see lisp_print_error()),
+ * so errors which Lisp code catches with ``try`` are cheap.
+ *
  * @param rt runtime
  * @param err_num error number, for easy programatic acccess
  * @param message message to show the user
@@ -0,0 +1,13 @@
+; Factorials and their quotients: arithmetic which overflows into bignums.
+(define factorial
+  (lambda (n)
+    (if (= n 0)
+        1
+        (* n (factorial (- n 1))))))
+
+(define main
+  (lambda (args)
+    (let ((f 0))
+      (dotimes (i 200)
+        (set! f (factorial 300)))
+      (print (/ f (factorial 298))))))
@@ -0,0 +1,10 @@
+; Naive recursive fibonacci: mostly binary arithmetic, comparisons and calls.
+(define fib
+  (lambda (n)
+    (if (< n 2)
+        n
+        (+ (fib (- n 1)) (fib (- n 2))))))
+
+(define main
+  (lambda (args)
+    (print (fib 25))))
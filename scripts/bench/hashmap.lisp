@@ -0,0 +1,20 @@
+; Counting words in a hash map, with lookups by string and symbol keys.
+(define words '("apple" "banana" "cherry" "date" "elderberry" "fig" "grape"))
+
+(define count-words
+  (lambda (counts n)
+    (dotimes (i n)
+      (for-each (w words)
+        (hash-set! counts w (+ 1 (hash-ref counts w 0)))))))
+
+(define main
+  (lambda (args)
+    (let ((counts (make-hash))
+          (squares (make-hash))
+          (sum 0))
+      (count-words counts 20000)
+      (dotimes (i 100000)
+        (hash-set! squares i (* i i)))
+      (dotimes (i 100000)
+        (set! sum (+ sum (hash-ref squares i))))
+      (print (hash-ref counts "fig") " " sum))))
@@ -0,0 +1,13 @@
+; Small helper lambdas called in a loop, which analysis inlines.
+(define inc (lambda (x) (+ x 1)))
+(define add (lambda (a b) (+ a b)))
+
+(define run
+  (lambda (n)
+    (let ((acc 0))
+      (dotimes (i n) (set! acc (add (inc acc) 1)))
+      acc)))
+
+(define main
+  (lambda (args)
+    (print (run 300000))))
@@ -0,0 +1,24 @@
+; Summing integers with each kind of loop, rather than by recursion.
+(define sum-while
+  (lambda (n)
+    (let ((i 0) (sum 0))
+      (while (< i n)
+        (set! sum (+ sum i))
+        (set! i (+ i 1)))
+      sum)))
+
+(define sum-dotimes
+  (lambda (n)
+    (let ((sum 0))
+      (dotimes (i n) (set! sum (+ sum i)))
+      sum)))
+
+(define sum-named-let
+  (lambda (n)
+    (let loop ((i 0) (sum 0))
+      (if (< i n) (loop (+ i 1) (+ sum i)) sum))))
+
+(define main
+  (lambda (args)
+    (print (list (sum-while 200000) (sum-dotimes 200000)
+                 (sum-named-let 200000)))))
@@ -0,0 +1,15 @@
+; Filling in quasiquote templates, as macros do: each template has a few
+; unquotes alongside larger constant parts.
+(define make-node
+  (lambda (n)
+    `(node ,n (leaf 1 2 3) (leaf (4 5) (6 7)) (size ,(* n 2) (unit pixels)))))
+
+(define repeat
+  (lambda (depth n)
+    (if (= depth 0)
+        (make-node n)
+        (progn (repeat (- depth 1) n) (repeat (- depth 1) (+ n 1))))))
+
+(define main
+  (lambda (args)
+    (print (repeat 17 0))))
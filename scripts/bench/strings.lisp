@@ -0,0 +1,19 @@
+; Building a long string piece by piece, with a builder and with ropes.
+(define build-with-builder
+  (lambda (n)
+    (let ((sb (make-string-builder)))
+      (dotimes (i n)
+        (string-builder-append! sb "item " i ", "))
+      (string-builder->string sb))))
+
+(define build-with-ropes
+  (lambda (n)
+    (let ((s ""))
+      (dotimes (i n)
+        (set! s (string-append s "item, ")))
+      (rope->string s))))
+
+(define main
+  (lambda (args)
+    (print (string-length (build-with-builder 200000)) " "
+           (string-length (build-with-ropes 200000)))))
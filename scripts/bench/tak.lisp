@@ -0,0 +1,14 @@
+; Takeuchi function: deep recursion through a three-argument lambda, with a let
+; binding its recursive calls on every step.
+(define tak
+  (lambda (x y z)
+    (if (>= y x)
+        z
+        (let ((a (tak (- x 1) y z))
+              (b (tak (- y 1) z x))
+              (c (tak (- z 1) x y)))
+          (tak a b c)))))
+
+(define main
+  (lambda (args)
+    (print (tak 20 12 6))))
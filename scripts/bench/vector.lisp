@@ -0,0 +1,21 @@
+; Filling and summing a lookup table by index.
+(define fill
+  (lambda (table)
+    (dotimes (i (vector-length table))
+      (vector-set! table i (* i 3)))))
+
+(define total
+  (lambda (table)
+    (let ((sum 0))
+      (dotimes (i (vector-length table))
+        (set! sum (+ sum (vector-ref table i))))
+      sum)))
+
+(define main
+  (lambda (args)
+    (let ((table (make-vector 10000 0))
+          (sum 0))
+      (dotimes (i 100)
+        (fill table)
+        (set! sum (+ sum (total table))))
+      (print sum))))
@@ -0,0 +1,67 @@
+; Integers too large for a long, which arithmetic overflows into.
+
+(define max 9223372036854775807)
+(define min (- (- max) 1))
+
+; overflow gives a bignum, and results which fit are integers again
+(assert (equal? (+ max 1) 9223372036854775808))
+(assert (equal? (- min 1) (- 9223372036854775809)))
+(assert (equal? (* max max) 85070591730234615847396907784232501249))
+(assert (equal? (- min) 9223372036854775808))
+(assert (equal? (/ min (- 1)) 9223372036854775808))
+(assert (equal? (- (+ max 1) 1) max))
+(assert (equal? (+ max 1 (- 2)) (- max 1)))
+(assert (equal? (* 4294967296 4294967296 (/ 1 2)) 0))
+
+; arithmetic on bignums
+(define a 123456789012345678901234567890)
+(define b 987654321098765432109876543210)
+(assert (equal? (+ a b) 1111111110111111111011111111100))
+(assert (equal? (- a b) (- 864197532086419753208641975320)))
+(assert (equal? (* a b) 121932631137021795226185032733622923332237463801111263526900))
+(assert (equal? (/ b a) 8))
+(assert (equal? (/ (* a b) b) a))
+(assert (equal? (/ (- (* a b)) b) (- a)))
+(assert (equal? (/ (* a b) 7) 17418947305288827889455004676231846190319637685873037646700))
+(assert (equal? (/ a b) 0))
+(assert (equal? (- a a) 0))
+(assert-error 'LE_VALUE (/ a 0))
+(assert-error 'LE_TYPE (+ a "b"))
+
+; comparison with integers and other bignums
+(assert (< max a))
+(assert (< a b))
+(assert (> a 0))
+(assert (< (- a) min))
+(assert (= a 123456789012345678901234567890))
+(assert (!= a b))
+(assert (>= b a))
+(assert (<= (- b) (- a)))
+(assert (= (eq? (+ a 0) a) 0))
+(assert (equal? (+ a 0) a))
+(assert (= (equal? a (- a)) 0))
+
+; bignums are true
+(assert (if a 1 0))
+
+; within lambdas, including the fast paths for two arguments
+(define factorial
+  (lambda (n) (if (= n 0) 1 (* n (factorial (- n 1))))))
+(assert (equal? (factorial 30) 265252859812191058636308480000000))
+(assert (equal? (/ (factorial 30) (factorial 28)) 870))
+(define sum-to
+  (lambda (n)
+    (let ((total 0))
+      (dotimes (i n) (set! total (+ total max)))
+      total)))
+(assert (equal? (sum-to 3) 27670116110564327421))
+
+; printing
+(print (factorial 25))
+(print (- (factorial 25)))
+(print (+ 1000000000000000000000 7))
+
+; OUTPUT(0)
+; 15511210043330985984000000
+; -15511210043330985984000000
+; 1000000000000000000007
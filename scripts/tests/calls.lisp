@@ -0,0 +1,72 @@
+; Variables and calls within lambdas, which analysis turns into nodes.
+
+; let bindings may refer to an outer variable of the same name
+(define shadow (lambda (x) (let ((x (+ x 1)) (y x)) (list x y))))
+(assert (equal? (shadow 1) '(2 2)))
+
+; or to later bindings, once they are bound
+(define later
+  (lambda ()
+    (let ((f (lambda () (g)))
+          (g (lambda () 5)))
+      (f))))
+(assert (equal? (later) 5))
+
+; definitions within a lambda shadow globals from then on
+(define x 10)
+(define local-define
+  (lambda ()
+    (define before x)
+    (define x 20)
+    (list before x)))
+(assert (equal? (local-define) '(10 20)))
+(assert (equal? x 10))
+
+; operators which aren't defined yet, including macros
+(define uses-later (lambda (a) (list (double a) (swap (a 1)))))
+(define double (lambda (n) (* n 2)))
+(define swap (macro (form) (list 'list (car (cdr form)) (car form))))
+(assert (equal? (uses-later 3) '(6 (1 3))))
+
+; operators which are themselves expressions
+(define pick (lambda (add) ((if add + -) 5 2)))
+(assert (equal? (list (pick 1) (pick 0)) '(7 3)))
+(define apply-each (lambda (fs v) (map (lambda (f) (f v)) fs)))
+(assert (equal? (apply-each (list car cdr) '(1 2)) '(1 (2))))
+
+; call sites keep working when they see a different operator than before
+(define apply-to-2 (lambda (f) (f 2)))
+(assert (equal? (apply-to-2 (lambda (x) (* x 3))) 6))
+(assert (equal? (apply-to-2 (lambda (x) (+ x 3))) 5))
+(assert (equal? (apply-to-2 list) '(2)))
+(define triple (lambda (x) (* x 3)))
+(define use-triple (lambda () (triple 2)))
+(assert (equal? (use-triple) 6))
+(define triple (lambda (x) (+ x x x x)))
+(assert (equal? (use-triple) 8))
+
+; arithmetic which has only seen small integers still handles other numbers
+(define add2 (lambda (a b) (+ a b)))
+(dotimes (i 10) (add2 i 1))
+(assert (equal? (add2 1.5 1) 2.5))
+(assert (equal? (add2 9223372036854775807 1) 9223372036854775808))
+(assert (equal? (add2 9223372036854775808 0.5) 9.223372036854776e18))
+(assert (equal? (add2 1 2) 3))
+
+; a deep call leaves several stack chunks behind, and a wide call then needs
+; a bigger one
+(define deep (lambda (n) (if (= n 0) 0 (+ 1 (deep (- n 1))))))
+(assert (equal? (deep 3000) 3000))
+(define ones (lambda (n l) (if (= n 0) l (ones (- n 1) (cons 1 l)))))
+(define wide (eval (list 'lambda '() (cons '+ (ones 1500 '())))))
+(assert (equal? (wide) 1500))
+(assert (equal? (deep 3000) 3000))
+
+; errors are reported as usual
+(define call-with (lambda (f) (f 1 2)))
+(assert-error 'LE_2MANY (call-with (lambda (a) a)))
+(assert-error 'LE_2FEW (call-with (lambda (a b c) a)))
+(assert-error 'LE_NOTFOUND ((lambda () undefined-variable)))
+(assert-error 'LE_NOCALL (call-with "string"))
+
+; OUTPUT(0)
@@ -0,0 +1,43 @@
+; FLAGS(-C)
+; Checking calls as lambdas are created.
+
+(define inc (lambda (x) (+ x 1)))
+(define add (lambda (a b) (+ a b)))
+
+; calls to lambdas with the wrong number of arguments
+(assert-error 'LE_2MANY (define bad (lambda () (inc 1 2))))
+(assert-error 'LE_2FEW (define bad (lambda (x) (if x (add x) 0))))
+(assert-error 'LE_NOTFOUND bad)
+(assert-error 'LE_2FEW (lambda () (let ((y 1)) (lambda (z) (add z)))))
+
+; calls to builtins with the wrong number or type of arguments
+(assert-error 'LE_2MANY (lambda (x) (car x x)))
+(assert-error 'LE_2FEW (lambda () (cons 1)))
+(assert-error 'LE_TYPE (lambda () (car 1)))
+(assert-error 'LE_TYPE (lambda (x) (+ x "one")))
+(assert-error 'LE_TYPE (lambda () (car (+ 1 2))))
+(assert-error 'LE_TYPE (lambda () (+ 'a 1)))
+(assert-error 'LE_TYPE (lambda () (< (list 1) 2)))
+
+; anything which might work is fine
+(define head (lambda (x) (car x)))
+(assert (equal? (head '(1 2)) 1))
+(define first-of-list (lambda () (car '(1 2))))
+(assert (equal? (first-of-list) 1))
+(define shadows (lambda (inc) (inc 1 2)))
+(assert (equal? (shadows +) 3))
+(define later (lambda () (not-yet-defined 1 2 3)))
+(define not-yet-defined (lambda (a b c) (list a b c)))
+(assert (equal? (later) '(1 2 3)))
+(define dynamic (lambda (f) (f)))
+(assert (equal? (dynamic (lambda () 5)) 5))
+
+; checked calls still notice when the lambda changes
+(define sum (lambda (l) (if (null? l) 0 (add (car l) (sum (cdr l))))))
+(assert (equal? (sum '(1 2 3)) 6))
+(define add (lambda (a b) (* a b)))
+(assert (equal? (sum '(1 2 3)) 0))
+(define add (lambda (a) a))
+(assert-error 'LE_2MANY (sum '(1 2 3)))
+
+; OUTPUT(0)
@@ -0,0 +1,17 @@
+; FLAGS(-C -A)
+; Checking calls still works when analysis is disabled.
+
+(define inc (lambda (x) (+ x 1)))
+
+(assert-error 'LE_2MANY (define bad (lambda () (inc 1 2))))
+(assert-error 'LE_NOTFOUND bad)
+(assert-error 'LE_2FEW (lambda () (cons 1)))
+(assert-error 'LE_TYPE (lambda () (car 1)))
+(assert-error 'LE_2FEW (lambda () (let ((y 1)) (lambda (z) (inc)))))
+
+; code which is fine still runs, without being analyzed
+(define twice (lambda (x) (if x (inc (inc x)) 0)))
+(assert (equal? (twice 1) 3))
+(assert (equal? (twice 0) 0))
+
+; OUTPUT(0)
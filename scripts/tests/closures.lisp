@@ -0,0 +1,72 @@
+; Lambdas created within other lambdas capture only the variables they use.
+; These tests check that closures see the same values they would if they
+; captured the entire scope.
+
+(define adder (lambda (x) (lambda (y) (+ x y))))
+(define add2 (adder 2))
+(assert (equal? (add2 3) 5))
+(assert (equal? (map (adder 10) '(1 2 3)) '(11 12 13)))
+
+; captured variables from several enclosing lambdas and lets
+(define nested
+  (lambda (a)
+    (let ((b (* a 2)))
+      (lambda (c)
+        (lambda (d) (list a b c d))))))
+(assert (equal? (((nested 1) 3) 4) '(1 2 3 4)))
+
+; globals are still looked up when the closure is called
+(define scale 2)
+(define scaler (lambda (x) (lambda () (* scale x))))
+(define scale-five (scaler 5))
+(define scale 3)
+(assert (equal? (scale-five) 15))
+
+; names defined after the closure is created must still be visible
+(define later
+  (lambda ()
+    (define f (lambda () (g)))
+    (define g (lambda () 'g))
+    (f)))
+(assert (equal? (later) 'g))
+
+; and names which are redefined must have their new value
+(define redefined
+  (lambda (x)
+    (define get-x (lambda () x))
+    (define x (+ x 1))
+    (get-x)))
+(assert (equal? (redefined 1) 2))
+
+; let bindings may refer to later bindings
+(define mutual
+  (lambda (n)
+    (let ((even (lambda (n) (if (= n 0) 1 (odd (- n 1)))))
+          (odd (lambda (n) (if (= n 0) 0 (even (- n 1))))))
+      (even n))))
+(assert (equal? (mutual 10) 1))
+(assert (equal? (mutual 7) 0))
+
+; recursive inner functions
+(define count-down
+  (lambda (n)
+    (define loop
+      (lambda (i acc) (if (= i 0) acc (loop (- i 1) (cons i acc)))))
+    (loop n '())))
+(assert (equal? (count-down 3) '(1 2 3)))
+
+; eval and macros may refer to variables which aren't in the code
+(define use-eval (lambda (x) (lambda (code) (eval code))))
+(assert (equal? ((use-eval 7) 'x) 7))
+(define get-x (macro () 'x))
+(define use-macro (lambda (x) (lambda () (get-x))))
+(assert (equal? ((use-macro 8)) 8))
+
+; a macro defined after the lambda, or passed to it, may assign variables
+(define mk (lambda (a) (let ((get (lambda () a))) (myset a 99) (get))))
+(define myset (macro (v x) (list 'set! v x)))
+(assert (equal? (mk 1) 99))
+(define call-it (lambda (m a) (let ((get (lambda () a))) (m a 5) (get))))
+(assert (equal? (call-it myset 1) 5))
+
+; OUTPUT(0)
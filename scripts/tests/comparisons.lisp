@@ -27,4 +27,19 @@
 (assert-error 'LE_TYPE (- 1 'a))
 (assert (= (+) 0))
 (assert-error 'LE_TYPE (+ 'a))
+
+; Within lambdas, calls with one or two arguments take a faster path, which
+; must behave the same.
+(define arith
+  (lambda (a b)
+    (list (+ a b) (- a b) (* a b) (/ a b) (- a)
+          (< a b) (<= a b) (> a b) (>= a b) (= a b) (!= a b))))
+(assert (equal? (arith 7 2) (list 9 5 14 3 (- 7) 0 0 1 1 0 1)))
+(assert (equal? (arith 2 2) (list 4 0 4 1 (- 2) 0 1 0 1 1 0)))
+(assert-error 'LE_TYPE (arith 'a 1))
+(assert-error 'LE_TYPE (arith 1 'a))
+(assert-error 'LE_VALUE (arith 1 0))
+(assert-error 'LE_NOTFOUND ((lambda () (+ 1 undefined))))
+(define sub (lambda (-) (- 5 3)))
+(assert (= (sub +) 8))
 ; OUTPUT(0)
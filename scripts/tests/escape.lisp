@@ -0,0 +1,81 @@
+; Escape continuations, which return early from call/ec.
+
+(assert (equal? (call/ec (lambda (return) 5)) 5))
+(assert (equal? (call/ec (lambda (return) (return 1) 2)) 1))
+
+; stop a search at the first hit, from within map and reduce
+(define first-over
+  (lambda (n l)
+    (call/ec
+      (lambda (return)
+        (map (lambda (x) (if (> x n) (return x) x)) l)
+        'none))))
+(assert (equal? (first-over 2 '(1 2 3 4)) 3))
+(assert (equal? (first-over 9 '(1 2 3 4)) 'none))
+(define product
+  (lambda (l)
+    (call/ec
+      (lambda (return)
+        (reduce (lambda (a b) (if (= b 0) (return 0) (* a b))) l)))))
+(assert (equal? (product '(1 2 3 4)) 24))
+(assert (equal? (product '(1 2 0 4)) 0))
+
+; and from loops and deep recursion
+(define index-of
+  (lambda (x l)
+    (call/ec
+      (lambda (return)
+        (let ((i 0))
+          (for-each (y l) (if (equal? x y) (return i) (set! i (+ i 1))))
+          (- 1))))))
+(assert (equal? (index-of 'c '(a b c d)) 2))
+(assert (equal? (index-of 'e '(a b c d)) (- 1)))
+(define find-first
+  (lambda (pred l)
+    (call/ec
+      (lambda (return)
+        (define walk
+          (lambda (l)
+            (cond
+              ((null? l) '())
+              ((pred (car l)) (return (car l)))
+              (1 (cons (car l) (walk (cdr l)))))))
+        (walk l)
+        '()))))
+(assert (equal? (find-first (lambda (x) (> x 3)) '(1 2 3 4 5)) 4))
+(assert (equal? (find-first (lambda (x) (> x 9)) '(1 2 3 4 5)) '()))
+
+; escaping many times leaves nothing behind on the stack
+(define deep
+  (lambda (n return) (if (= n 0) (return 'bottom) (deep (- n 1) return))))
+(dotimes (i 100) (call/ec (lambda (return) (deep 100 return))))
+(assert (equal? (call/ec (lambda (return) (deep 500 return))) 'bottom))
+
+; several values may be returned
+(assert (equal? (call-with-values
+                  (lambda () (call/ec (lambda (return) (return 1 2) 3)))
+                  list)
+                '(1 2)))
+(assert (equal? (call-with-values (lambda () (call/ec (lambda (k) (k)))) list)
+                '()))
+
+; an inner continuation may escape past an outer call/ec, and the other way
+(assert (equal? (call/ec
+                  (lambda (outer)
+                    (list (call/ec (lambda (inner) (outer 'outer))) 'after)))
+                'outer))
+(assert (equal? (call/ec
+                  (lambda (outer)
+                    (list (call/ec (lambda (inner) (inner 'inner))) 'after)))
+                '(inner after)))
+
+; escapes aren't caught like errors, and errors still happen as usual
+(assert (equal? (call/ec (lambda (k) (assert-error 'LE_TYPE (k 5)) 6)) 5))
+(assert-error 'LE_TYPE (call/ec (lambda (k) (car 1))))
+(assert-error 'LE_NOCALL (call/ec 1))
+
+; a continuation can't be used after its call/ec returned
+(define saved (call/ec (lambda (k) k)))
+(assert-error 'LE_ERROR (saved 1))
+
+; OUTPUT(0)
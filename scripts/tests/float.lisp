@@ -0,0 +1,54 @@
+; Floats, and arithmetic mixing them with integers.
+
+; literals with a fraction or an exponent are floats
+(assert (= 1.5 (/ 3.0 2)))
+(assert (= 1e3 1000))
+(assert (= 2.5e-1 0.25))
+(assert (= 1E+2 100))
+(assert (equal? (car '(1.5 2)) 1.5))
+
+; mixed arithmetic gives a float
+(assert (equal? (+ 1 2.5) 3.5))
+(assert (equal? (- 1 0.5 0.25) 0.25))
+(assert (equal? (* 2 2.5) 5.0))
+(assert (equal? (/ 7 2.0) 3.5))
+(assert (equal? (/ 7 2) 3))
+(assert (equal? (- 2.5) (- 0 2.5)))
+(assert (equal? (+ 123456789012345678901234567890 0.5) 1.2345678901234568e29))
+(assert-error 'LE_VALUE (/ 1.0 0))
+(assert-error 'LE_VALUE (/ 1 0.0))
+(assert-error 'LE_TYPE (+ 1.5 "a"))
+
+; comparison works across kinds, but equal? doesn't
+(assert (< 1 1.5))
+(assert (= 2 2.0))
+(assert (!= 2 2.5))
+(assert (> 100000000000000000000000 1.0))
+(assert (>= 1.0 1))
+(assert (= (equal? 1 1.0) 0))
+(assert (equal? 1.5 1.5))
+
+; within lambdas, including the fast paths for two arguments
+(define arith
+  (lambda (a b)
+    (list (+ a b) (- a b) (* a b) (/ a b) (- a) (< a b) (= a b))))
+(assert (equal? (arith 1.5 2) (list 3.5 (- 0.5) 3.0 0.75 (- 1.5) 1 0)))
+(assert (equal? (arith 3 0.5) (list 3.5 2.5 1.5 6.0 (- 3) 0 0)))
+(define average
+  (lambda (l) (/ (reduce + l) (* 1.0 (reduce (lambda (n x) (+ n 1)) 0 l)))))
+(assert (equal? (average '(1 2 3 4)) 2.5))
+
+; nonzero floats are true
+(assert (equal? (list (if 0.0 'yes 'no) (if 0.5 'yes 'no)) '(no yes)))
+
+; printing uses the fewest digits which read back the same
+(print 0.1 " " (+ 0.1 0.2) " " 3.0 " " 1e21 " " 1.5e-7 " " (- 2.25))
+; and writes whole numbers out unless they need an exponent
+(print 100.0 " " 1e6 " " 1.5e10 " " 1e16 " " 1e17 " " (- 1234.5e3))
+(define inf (* 1e308 10.0))
+(print inf " " (- inf) " " (- inf inf) " " (- (- inf inf)))
+
+; OUTPUT(0)
+; 0.1 0.30000000000000004 3.0 1e+21 1.5e-07 -2.25
+; 100.0 1000000.0 15000000000.0 10000000000000000.0 1e+17 -1234500.0
+; inf -inf nan nan
@@ -0,0 +1,44 @@
+; FLAGS(-O)
+; Tests for constant folding. Folding should never change the result of a
+; program (unless builtins are redefined).
+
+(define arith (lambda () (+ (* 2 3) (- 10 4))))
+(assert (equal? (arith) 12))
+
+(define branch
+  (lambda (x)
+    (if (< 1 2) (+ x 1) (undefined-function x))))
+(assert (equal? (branch 1) 2))
+
+(define choose
+  (lambda (x)
+    (cond
+      ((= 1 2) 'never)
+      ((null? '()) (car (cons x '())))
+      (1 'unreachable))))
+(assert (equal? (choose 'a) 'a))
+
+; arguments shadow builtins, so this must not be folded
+(define shadow (lambda (+) (+ 1 2)))
+(assert (equal? (shadow -) (- 1 2)))
+
+; let bindings shadow builtins too
+(define shadow-let (lambda () (let ((* +)) (* 3 3))))
+(assert (equal? (shadow-let) 6))
+
+; errors which would occur during folding are left for runtime
+(define divide-zero (lambda () (/ 1 0)))
+(assert-error 'LE_VALUE (divide-zero))
+
+(define quasi (lambda (x) `(1 ,(+ 1 1) ,x)))
+(assert (equal? (quasi 3) '(1 2 3)))
+
+(define no-unquote (lambda () `(a (b c))))
+(assert (equal? (no-unquote) '(a (b c))))
+
+(define unless
+  (macro (condition expr)
+    (if (= 1 1) `(if ,condition '() ,expr) 'broken)))
+(assert (equal? (unless (= 1 2) 5) 5))
+
+; OUTPUT(0)
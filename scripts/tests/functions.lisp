@@ -13,4 +13,9 @@
 ; second time to test quasiquote bug
 (assert (equal? (when (< 3 1) 5) '()))
 
+; deep recursion keeps many builtin arguments alive at once
+(define sum-to
+  (lambda (n) (if (= n 0) 0 (+ n (sum-to (- n 1))))))
+(assert (equal? (sum-to 2000) 2001000))
+
 ; OUTPUT(0)
@@ -0,0 +1,30 @@
+; Global variables used within lambdas, which remember where they found them.
+
+; redefining a global is seen by code which already used it
+(define g 1)
+(define get-g (lambda () g))
+(assert (equal? (get-g) 1))
+(define g 2)
+(assert (equal? (get-g) 2))
+
+; so is defining one which didn't exist yet
+(define get-h (lambda () h))
+(assert-error 'LE_NOTFOUND (get-h))
+(define h 3)
+(assert (equal? (get-h) 3))
+
+; and redefining a builtin
+(define second (lambda (l) (car (cdr l))))
+(assert (equal? (second '(1 2 3)) 2))
+(define cdr (lambda (l) '(4)))
+(assert (equal? (second '(1 2 3)) 4))
+
+; lambdas within lambdas, and lets, see the same globals
+(define adder (lambda (n) (lambda (x) (+ x n g))))
+(assert (equal? ((adder 1) 1) 4))
+(define g 10)
+(assert (equal? ((adder 1) 1) 12))
+(define in-let (lambda () (let ((x 1)) (+ x g))))
+(assert (equal? (in-let) 11))
+
+; OUTPUT(0)
@@ -0,0 +1,74 @@
+; Hash maps, which find keys by value as equal? does.
+
+(define h (make-hash))
+(assert (= (hash-count h) 0))
+(hash-set! h 'one 1)
+(hash-set! h "two" 2)
+(hash-set! h 3 'three)
+(hash-set! h '(4 5) 45)
+(assert (= (hash-count h) 4))
+(assert (= (hash-ref h 'one) 1))
+(assert (= (hash-ref h "two") 2))
+(assert (equal? (hash-ref h (+ 1 2)) 'three))
+(assert (= (hash-ref h (list 4 5)) 45))
+(assert (equal? (hash-ref h "one" 'missing) 'missing))
+(assert-error 'LE_NOTFOUND (hash-ref h 'two))
+
+; keys of different types aren't equal, even when they look alike
+(assert (equal? (hash-ref h 3.0 'missing) 'missing))
+(hash-set! h 0.0 'zero)
+(assert (equal? (hash-ref h (- 0.0)) 'zero))
+(hash-set! h 123456789012345678901234567890 'big)
+(assert (equal? (hash-ref h (* 123456789012345678901234567890 1)) 'big))
+(hash-set! h (vector 1 "a") 'vec)
+(assert (equal? (hash-ref h (vector 1 "a")) 'vec))
+
+; replacing and removing
+(hash-set! h 'one 'uno)
+(assert (equal? (hash-ref h 'one) 'uno))
+(assert (hash-remove! h 'one))
+(assert (= (hash-remove! h 'one) 0))
+(assert (equal? (hash-ref h 'one 'gone) 'gone))
+(assert (= (hash-count h) 6))
+
+; iteration
+(define small (make-hash))
+(hash-set! small 'a 1)
+(assert (equal? (hash-keys small) '(a)))
+(assert (equal? (hash-values small) '(1)))
+(assert (equal? (hash->list small) '((a . 1))))
+(hash-set! small 'b 2)
+(assert (= (reduce + 0 (map cdr (hash->list small))) 3))
+(hash-remove! small 'b)
+(assert (equal? (hash-keys (make-hash)) '()))
+
+; equal? compares contents
+(define other (make-hash))
+(hash-set! other 'a 1)
+(assert (equal? small other))
+(hash-set! other 'a 2)
+(assert (= (equal? small other) 0))
+
+; many entries, added and removed over and over
+(define counts (make-hash))
+(dotimes (i 2000)
+  (hash-set! counts i (* i i)))
+(assert (= (hash-count counts) 2000))
+(assert (= (hash-ref counts 1999) 3996001))
+(dotimes (round 50)
+  (dotimes (i 100)
+    (hash-set! counts (+ 10000 (* round 100) i) i))
+  (dotimes (i 100)
+    (hash-remove! counts (+ 10000 (* round 100) i))))
+(assert (= (hash-count counts) 2000))
+(assert (equal? (hash-ref counts 10000 'none) 'none))
+
+; errors
+(assert-error 'LE_TYPE (hash-ref '((a . 1)) 'a))
+(assert-error 'LE_2MANY (make-hash 1))
+(assert-error 'LE_2FEW (hash-set! h 'a))
+
+(print small)
+
+; OUTPUT(0)
+; #hash((a . 1))
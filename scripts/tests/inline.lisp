@@ -0,0 +1,55 @@
+; Calls to small lambdas, which analysis inlines into their callers.
+
+(define inc (lambda (x) (+ x 1)))
+(define add (lambda (a b) (+ a b)))
+(define add3 (lambda (a b c) (add (add a b) c)))
+(define twice-inc (lambda (y) (inc (inc y))))
+(assert (equal? (twice-inc 1) 3))
+(define sum3 (lambda () (add3 1 2 3)))
+(assert (equal? (sum3) 6))
+
+; arguments are still evaluated once each, in order, even if unused
+(define ignore (lambda (x) 0))
+(define ignores-unbound (lambda () (ignore undefined-variable)))
+(assert-error 'LE_NOTFOUND (ignores-unbound))
+(define n 0)
+(define tick (lambda () (set! n (+ n 1)) n))
+(define double (lambda (x) (+ x x)))
+(define double-tick (lambda () (double (tick))))
+(assert (equal? (double-tick) 2))
+(assert (equal? n 1))
+(define order (lambda () (list (add (tick) (* 10 (tick))))))
+(assert (equal? (order) '(32)))
+
+; redefining the lambda is seen by callers which inlined it
+(define inc (lambda (x) (+ x 100)))
+(assert (equal? (twice-inc 1) 201))
+(define inc (macro (x) x))
+(assert (equal? (twice-inc 1) 1))
+
+; variables of the lambda aren't confused with the caller's
+(define k 10)
+(define add-k (lambda (x) (+ x k)))
+(define shadows-k (lambda (k) (add-k k)))
+(assert (equal? (shadows-k 1) 11))
+(define uses-x (lambda (x) (let ((y 5)) (add x y))))
+(assert (equal? (uses-x 1) 6))
+
+; control flow, quoting and errors within an inlined lambda
+(define classify (lambda (x) (cond ((< x 0) 'negative) ((= x 0) 'zero) (1 'positive))))
+(define sign (lambda (x) (if (< x 0) (- 1) (if (= x 0) 0 1))))
+(define describe (lambda (x) (list (classify x) (sign x))))
+(assert (equal? (describe (- 3)) (list 'negative (- 1))))
+(assert (equal? (describe 4) '(positive 1)))
+(define divide (lambda (a b) (/ a b)))
+(define half-of (lambda (x) (divide x 0)))
+(assert-error 'LE_VALUE (half-of 3))
+(define wrong-args (lambda () (inc 1 2)))
+(assert-error 'LE_2MANY (wrong-args))
+
+; recursive lambdas are called as usual
+(define fact (lambda (n) (if (= n 0) 1 (* n (fact (- n 1))))))
+(define fact5 (lambda () (fact 5)))
+(assert (equal? (fact5) 120))
+
+; OUTPUT(0)
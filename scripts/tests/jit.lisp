@@ -0,0 +1,83 @@
+; FLAGS(-J)
+; Tests for the JIT. Each function is called enough times to be compiled, and
+; should give the same results before and after.
+
+(define repeat
+  (lambda (n f)
+    (if (= n 0)
+      (f)
+      (progn (f) (repeat (- n 1) f)))))
+
+(define fib
+  (lambda (n)
+    (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))
+(assert (equal? (fib 20) 6765))
+
+(define arith
+  (lambda (a b)
+    (list (+ a b) (- a b) (* a b) (/ a b) (- a)
+          (< a b) (<= a b) (> a b) (>= a b) (= a b) (!= a b))))
+(assert (equal? (repeat 150 (lambda () (arith 7 3)))
+                (list 10 4 21 2 (- 7) 0 0 1 1 0 1)))
+(assert (equal? (arith 3 7) (list 10 (- 4) 21 0 (- 3) 1 1 0 0 0 1)))
+
+(define classify
+  (lambda (x)
+    (cond
+      ((< x 0) 'negative)
+      ((= x 0) "zero")
+      (1 (quote positive)))))
+(repeat 150 (lambda () (classify 1)))
+(assert (equal? (list (classify (- 5)) (classify 0) (classify 5))
+                '(negative "zero" positive)))
+
+; overflow within compiled code gives a bignum, which is true
+(define big 9223372036854775807)
+(define truthy (lambda (x) (if x 'yes 'no)))
+(repeat 150 (lambda () (list (arith 7 3) (truthy 1))))
+(assert (equal? (arith big 2)
+                (list 9223372036854775809 9223372036854775805
+                      18446744073709551614 4611686018427387903 (- big)
+                      0 0 1 1 0 1)))
+(assert (equal? (arith (- (- big) 1) (- 1))
+                (list (- (- big) 2) (- big) 9223372036854775808
+                      9223372036854775808 9223372036854775808
+                      1 1 0 0 0 1)))
+(assert (equal? (arith (* big big) big) (list 85070591730234615856620279821087277056
+                                              85070591730234615838173535747377725442
+                                              784637716923335095224261902710254454442933591094742482943
+                                              big (- (* big big)) 0 0 1 1 0 1)))
+(assert (equal? (list (truthy 0) (truthy (+ big 1))) '(no yes)))
+
+; so do floats, and mixing them with integers and bignums
+(assert (equal? (arith 1.5 2) (list 3.5 (- 0.5) 3.0 0.75 (- 1.5) 1 1 0 0 0 1)))
+(assert (equal? (arith 3 0.5) (list 3.5 2.5 1.5 6.0 (- 3) 0 0 1 1 0 1)))
+(assert (equal? (arith (* big 4) 0.5)
+                (list 3.6893488147419103e19 3.6893488147419103e19
+                      1.8446744073709552e19 7.378697629483821e19
+                      (- 36893488147419103228) 0 0 1 1 0 1)))
+(assert (equal? (arith 7 3) (list 10 4 21 2 (- 7) 0 0 1 1 0 1)))
+
+; errors within compiled code are returned as usual
+(define add (lambda (a b) (+ a b)))
+(define divide (lambda (a b) (/ a b)))
+(define lookup (lambda (x) (if x undefined-variable 1)))
+(repeat 150 (lambda () (list (add 1 2) (divide 4 2) (lookup 0))))
+(assert-error 'LE_TYPE (add "a" 1))
+(assert-error 'LE_VALUE (divide 1 0))
+(assert-error 'LE_NOTFOUND (lookup 1))
+
+; builtins and lambdas called from compiled code
+(define first-twice (lambda (l) (list (car l) (car (cdr l)))))
+(define pair (lambda (x) (first-twice (cons x (cons (add x 1) '())))))
+(assert (equal? (repeat 150 (lambda () (pair 1))) '(1 2)))
+
+; re-binding a builtin after compiling is respected
+(define car cdr)
+(assert (equal? (first-twice '(1 2 3)) '((2 3) (3))))
+(define + (lambda (a b) (* a b 10)))
+(define if (lambda (c a b) (list c a b)))
+(assert (equal? (add 1 2) 20))
+(assert (equal? (truthy 0) '(0 yes no)))
+
+; OUTPUT(0)
@@ -37,4 +37,9 @@
 (assert-error 'LE_2MANY
   (let ((name 'which-value 'should-i-choose?)) 5))
 
+; a macro defined after a lambda may bind a name within its let
+(define shadow-later (lambda (a) (let ((y 1)) (later-mac a 8) a)))
+(define later-mac (macro (n v) (list 'define n v)))
+(assert (equal? (shadow-later 1) 8))
+
 ; OUTPUT(0)
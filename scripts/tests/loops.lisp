@@ -0,0 +1,125 @@
+; Loops and set!, both at the top level and within lambdas (where they are
+; analyzed).
+
+; set! changes the nearest binding, wherever it is
+(define x 1)
+(set! x 2)
+(assert (equal? x 2))
+(define bump (lambda () (set! x (+ x 1))))
+(bump)
+(assert (equal? x 3))
+(assert (equal? (let ((x 10)) (set! x 11) x) 11))
+(assert (equal? x 3))
+(assert-error 'LE_NOTFOUND (set! not-bound 1))
+(assert-error 'LE_NOTFOUND ((lambda () (set! not-bound 1))))
+
+; closures share the variables they set
+(define make-counter
+  (lambda ()
+    (let ((n 0))
+      (list (lambda () (set! n (+ n 1)) n)
+            (lambda () n)))))
+(define counter (make-counter))
+((car counter))
+((car counter))
+(assert (equal? ((car (cdr counter))) 2))
+
+; while
+(define i 0)
+(define total 0)
+(assert (equal? (while (< i 5) (set! total (+ total i)) (set! i (+ i 1))) '()))
+(assert (equal? total 10))
+(define sum-below
+  (lambda (n)
+    (let ((i 0) (sum 0))
+      (while (< i n)
+        (set! sum (+ sum i))
+        (set! i (+ i 1)))
+      sum)))
+(assert (equal? (sum-below 100) 4950))
+
+; dotimes
+(define squares '())
+(dotimes (i 4) (set! squares (cons (* i i) squares)))
+(assert (equal? squares '(9 4 1 0)))
+(define count-to
+  (lambda (n)
+    (let ((result '()))
+      (dotimes (i n) (set! result (cons i result)))
+      result)))
+(assert (equal? (count-to 3) '(2 1 0)))
+(assert (equal? (count-to 0) '()))
+(assert-error 'LE_TYPE (dotimes (i "3") i))
+(assert-error 'LE_TYPE ((lambda () (dotimes (i "3") i))))
+
+; for-each
+(define sum-list
+  (lambda (l)
+    (let ((sum 0))
+      (for-each (x l) (set! sum (+ sum x)))
+      sum)))
+(assert (equal? (sum-list '(1 2 3 4)) 10))
+(assert (equal? (sum-list '()) 0))
+(define seen '())
+(for-each (s '("a" "b")) (set! seen (cons s seen)))
+(assert (equal? seen '("b" "a")))
+(assert-error 'LE_TYPE (for-each (x 1) x))
+
+; closures made within a loop see the loop variable change, with or without
+; analysis
+(define last-i (lambda ()
+  (let ((get '()))
+    (dotimes (i 3) (if (= i 0) (set! get (lambda () i)) '()))
+    (get))))
+(assert (equal? (last-i) 2))
+
+; named let
+(define fact
+  (lambda (n)
+    (let loop ((i n) (acc 1))
+      (if (= i 0) acc (loop (- i 1) (* acc i))))))
+(assert (equal? (fact 10) 3628800))
+(assert (equal? (let loop ((i 0)) (if (< i 1000) (loop (+ i 1)) i)) 1000))
+
+; an inner loop may continue the outer one
+(define pairs
+  (lambda (n)
+    (let ((result '()))
+      (let outer ((i 0))
+        (if (< i n)
+          (let inner ((j 0))
+            (if (< j i)
+              (progn (set! result (cons (list i j) result)) (inner (+ j 1)))
+              (outer (+ i 1))))
+          result)))))
+(assert (equal? (pairs 3) '((2 1) (2 0) (1 0))))
+
+; it must be called with the right arguments, in tail position, within the loop
+(assert-error 'LE_2FEW (let loop ((i 0) (j 0)) (if (= i 0) (loop 1) i)))
+(assert-error 'LE_2MANY ((lambda () (let loop ((i 0)) (if (= i 0) (loop 1 2) i)))))
+(assert-error 'LE_SYNTAX (let loop ((i 0)) (if (= i 0) (progn (loop 1) 5) i)))
+(assert-error 'LE_SYNTAX (let loop ((i 1)) (if (= i 0) 0 (+ 1 (loop (- i 1))))))
+(assert-error 'LE_SYNTAX
+  (let loop ((i 1)) (if (= i 0) 0 (car (list (loop 0))))))
+(assert-error 'LE_SYNTAX (let loop ((i 1)) (if (= i 0) 0 (map loop '(0)))))
+(assert-error 'LE_SYNTAX
+  (let loop ((i 1)) (if (= i 0) 0 (call/ec (lambda (k) (loop 0))))))
+(assert-error 'LE_SYNTAX
+  (let loop ((i 1)) (if (= i 0) 0 (try (loop 0) (catch (e) e)))))
+(define sum-to
+  (lambda (n) (let loop ((i n)) (if (= i 0) 0 (+ i (loop (- i 1)))))))
+(assert-error 'LE_SYNTAX (sum-to 3))
+(define first-of
+  (lambda (n) (let loop ((i n)) (if (= i 0) 0 (car (list (loop 0)))))))
+(assert-error 'LE_SYNTAX (first-of 3))
+
+; but the name may be quoted, or re-bound
+(assert (equal? (let loop ((i 0)) (if (= i 0) '(loop 1) (loop 0))) '(loop 1)))
+(assert (equal? (let loop ((i 2)) (let ((loop 5)) (+ loop i))) 7))
+
+; a macro's expansion can't be checked, so a loop may still escape from one
+(define thunk (macro (body) (list 'lambda '() body)))
+(define escaped (let loop ((i 0)) (thunk (loop 1))))
+(assert-error 'LE_ERROR (escaped))
+
+; OUTPUT(0)
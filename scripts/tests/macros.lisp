@@ -10,4 +10,18 @@
 (setvalue test 5)
 (assert (= test 5))
 
+; Expansions are cached per call site, so this only prints once
+(defmacro noisy (x) (progn (print "expanding") x))
+(defun use-noisy (y) (noisy y))
+(assert (= (use-noisy 1) 1))
+(assert (= (use-noisy 2) 2))
+
+; Redefining a macro invalidates the expansions it produced
+(defmacro twice (x) `(+ ,x ,x))
+(defun use-twice (y) (twice y))
+(assert (= (use-twice 5) 10))
+(defmacro twice (x) `(* ,x ,x))
+(assert (= (use-twice 5) 25))
+
 ; OUTPUT(0)
+; expanding
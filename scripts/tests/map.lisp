@@ -7,6 +7,23 @@
           (map + '(1 2 3) '(3 2 1))
           '(4 4 4)))
 
+; lists of different lengths, and empty lists
+(assert (equal?
+          (map + '(1 2 3) '(1 2))
+          '(2 4)))
+(assert (equal? (map + '()) '()))
+
+; items are passed as they are, even when they would evaluate to something else
+(assert (equal?
+          (map (lambda (x) x) '((+ 1 2) sym "str"))
+          '((+ 1 2) sym "str")))
+(assert (equal?
+          (map list '(a b) '((c) (d)))
+          '((a (c)) (b (d)))))
+(assert (equal?
+          (map car '((1 2) (3 4)))
+          '(1 3)))
+
 ; argument errors:
 (assert-error 'LE_2FEW
               (map +))
@@ -8,6 +8,19 @@
           `(1 2 3 ,(+ 2 2))
           '(1 2 3 4)))
 
+; within lambdas, templates are analyzed ahead of time
+(define fill
+  (lambda (y)
+    `(a (b c) ,y (d ,(+ y 1) (e)) ,x)))
+(assert (equal? (fill 1) '(a (b c) 1 (d 2 (e)) 4)))
+(assert (equal? (fill 5) '(a (b c) 5 (d 6 (e)) 4)))
+(define just-unquote (lambda (y) `,y))
+(assert (equal? (just-unquote 'sym) 'sym))
+(define nested (lambda (y) `(1 `(2 ,y))))
+(assert (equal? (nested 3) '(1 (quasiquote (2 3)))))
+(define dotted (lambda () `(1 . 2)))
+(assert-error 'LE_SYNTAX (dotted))
+
 ; errors occurring in quasiquote are errors in real life
 (assert-error 'LE_VALUE
               `(blah (blah blah) ,(/ 1 0) (blah)))
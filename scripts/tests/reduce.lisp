@@ -5,6 +5,9 @@
 (assert (equal?
           (reduce + 1 '(2))
           3))
+(assert (equal?
+          (reduce (lambda (acc x) (cons x acc)) '() '(a (b) c))
+          '(c (b) a)))
 
 ; errors
 (assert-error 'LE_2FEW
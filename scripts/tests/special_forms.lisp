@@ -0,0 +1,85 @@
+; Special forms within lambdas are analyzed when the lambda is created. These
+; tests check that analyzed forms behave just like the builtins.
+
+(define classify
+  (lambda (n)
+    (cond
+      ((< n 0) 'negative)
+      ((= n 0) 'zero)
+      (1 'positive))))
+(assert (equal? (classify (- 0 5)) 'negative))
+(assert (equal? (classify 0) 'zero))
+(assert (equal? (classify 5) 'positive))
+
+(define no-match (lambda () (cond (0 1))))
+(assert (null? (no-match)))
+
+(define fact
+  (lambda (n)
+    (if (<= n 1) 1 (* n (fact (- n 1))))))
+(assert (equal? (fact 5) 120))
+
+; let bindings may refer to earlier bindings
+(define sum-let
+  (lambda (x)
+    (let ((a x)
+          (b (+ a 1)))
+      (progn
+        (define c (+ a b))
+        (list a b c '(a b c))))))
+(assert (equal? (sum-let 1) '(1 2 3 (a b c))))
+
+; inner lambdas and macros close over their definition scope
+(define adder (lambda (x) (lambda (y) (+ x y))))
+(assert (equal? ((adder 2) 3) 5))
+(define make-twice
+  (lambda ()
+    (macro (expr) `(progn ,expr ,expr))))
+(define twice (make-twice))
+(define counter 0)
+(twice (define counter (+ counter 1)))
+(assert (equal? counter 2))
+
+; arguments named after special forms shadow them
+(define shadow-if (lambda (if) (if 1 2 3)))
+(assert (equal? (shadow-if +) 6))
+(define shadow-quote (lambda () (define quote list) (quote 1 2)))
+(assert (equal? (shadow-quote) '(1 2)))
+
+; malformed forms still produce errors when they are evaluated
+(define bad-if (lambda () (if 1 2)))
+(assert-error 'LE_2FEW (bad-if))
+(define bad-cond (lambda () (cond (1))))
+(assert-error 'LE_SYNTAX (bad-cond))
+(define bad-let (lambda () (let (x) x)))
+(assert-error 'LE_TYPE (bad-let))
+(define bad-define (lambda () (define 1 2)))
+(assert-error 'LE_TYPE (bad-define))
+
+; errors within analyzed forms propagate
+(define error-in-if (lambda () (if (car '()) 1 2)))
+(assert-error 'LE_VALUE (error-in-if))
+(define error-in-let (lambda () (let ((x (undefined))) x)))
+(assert-error 'LE_NOTFOUND (error-in-let))
+
+; redefining a special form is seen by lambdas created before, including
+; where they were inlined
+(define two (lambda () (progn 1 2)))
+(define sign-of (lambda (x) (if (< x 0) 'minus 'plus)))
+(define describe-sign (lambda (x) (sign-of x)))
+(assert (equal? (two) 2))
+(assert (equal? (describe-sign 1) 'plus))
+(define progn (lambda (a b) (+ a b 100)))
+(define if (lambda (c a b) (list c a b)))
+(assert (equal? (two) 103))
+(assert (equal? (describe-sign 1) '(0 minus plus)))
+
+; so is redefining arithmetic, which is otherwise computed directly
+(define add-two (lambda (a b) (+ a b)))
+(define add-one (lambda (x) (add-two x 1)))
+(assert (equal? (add-one 2) 3))
+(define + (lambda (a b) (* a b 10)))
+(assert (equal? (add-two 1 2) 20))
+(assert (equal? (add-one 2) 20))
+
+; OUTPUT(0)
@@ -0,0 +1,58 @@
+; String builders, and string-append with ropes.
+
+; a builder accepts strings, symbols and numbers
+(define sb (make-string-builder))
+(string-builder-append! sb "x = " 'abc " " 42 " " (- 7))
+(string-builder-append! sb " " 1.5 " " 100000000000000000000)
+(assert (equal? (string-builder->string sb) "x = abc 42 -7 1.5 100000000000000000000"))
+(assert (equal? (string-builder->string (make-string-builder)) ""))
+(assert-error 'LE_TYPE (string-builder-append! sb '(1 2)))
+(assert-error 'LE_TYPE (string-builder-append! "not a builder" "a"))
+(assert-error 'LE_2FEW (string-builder-append!))
+; nothing is appended when an argument is bad
+(assert-error 'LE_TYPE (string-builder-append! sb "more" '(1 2)))
+(assert (= (string-length (string-builder->string sb)) 39))
+
+; short results of string-append are plain strings
+(assert (equal? (string-append "foo" "bar" "") "foobar"))
+(assert (equal? (string-append) ""))
+(assert (= (string-length "hello") 5))
+(assert-error 'LE_TYPE (string-append "a" 'b))
+
+; long results are ropes, which are equal to strings with the same text
+(define line "0123456789012345678901234567890123456789")
+(define r (string-append line line))
+(assert (= (string-length r) 80))
+(assert (equal? r (rope->string r)))
+(assert (equal? (rope->string r) r))
+(assert (equal? r (string-append line line)))
+(assert (= (equal? r (string-append line "x")) 0))
+
+; repeated appends share their pieces
+(define build
+  (lambda (n)
+    (let ((s ""))
+      (dotimes (i n) (set! s (string-append s "ab")))
+      s)))
+(define big (build 20000))
+(assert (= (string-length big) 40000))
+(assert (= (string-length (rope->string big)) 40000))
+
+; ropes and strings with the same text are the same hash key
+(define h (make-hash))
+(hash-set! h (rope->string r) 'found)
+(assert (equal? (hash-ref h r) 'found))
+
+; ropes and builders can be appended to each other
+(define sb2 (make-string-builder))
+(string-builder-append! sb2 "[" (build 40) "]")
+(assert (= (string-length (string-builder->string sb2)) 82))
+
+(print (string-append "hello, " "world"))
+(print (string-append line line))
+(print sb2)
+
+; OUTPUT(0)
+; hello, world
+; 01234567890123456789012345678901234567890123456789012345678901234567890123456789
+; <string-builder "[abababababababababababababababababababababababababababababababababababababababab]">
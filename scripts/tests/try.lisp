@@ -0,0 +1,57 @@
+; Catching errors with try, and raising them with raise.
+
+(assert (equal? (try 1 2 (catch (e) 'caught)) 2))
+(assert (equal? (try (car 1) (catch (e) (car e))) 'LE_TYPE))
+
+; the error is a list of its code, message and payload
+(define e (try (raise 'LE_VALUE "bad value" '(1 2)) (catch (e) e)))
+(assert (equal? e '(LE_VALUE "bad value" (1 2))))
+(assert (equal? (try (raise 'LE_ERROR "no payload") (catch (e) e))
+                '(LE_ERROR "no payload" ())))
+(assert (equal? (try (undefined-function 1) (catch (e) (car e))) 'LE_NOTFOUND))
+(assert (equal? (car (cdr (try (/ 1 0) (catch (e) e)))) "divide by zero"))
+
+; errors from deep within calls, and within lambdas
+(define safe-div
+  (lambda (a b)
+    (try (/ a b)
+      (catch (err) (list 'failed (car err))))))
+(assert (equal? (safe-div 6 3) 2))
+(assert (equal? (safe-div 6 0) '(failed LE_VALUE)))
+(define check-all
+  (lambda (l)
+    (map (lambda (x) (if (< x 0) (raise 'LE_VALUE "negative" x) x)) l)))
+(define first-bad
+  (lambda (l)
+    (try (check-all l) 'ok
+      (catch (e) (car (cdr (cdr e)))))))
+(assert (equal? (first-bad '(1 2 3)) 'ok))
+(assert (equal? (first-bad (list 1 (- 2) 3)) (- 2)))
+
+; the handler may use the surrounding variables and raise again
+(define wrap
+  (lambda (tag thunk)
+    (try (thunk)
+      (catch (e) (raise (car e) "wrapped" (list tag (car (cdr (cdr e)))))))))
+(assert (equal? (try (wrap 'outer (lambda () (raise 'LE_ERROR "inner" 5)))
+                  (catch (e) e))
+                '(LE_ERROR "wrapped" (outer 5))))
+(assert-error 'LE_2MANY (try (car 1) (catch (e) (car e 1))))
+
+; nothing is left behind when calls are abandoned
+(define deep (lambda (n) (if (= n 0) (raise 'LE_ERROR "bottom") (+ 1 (deep (- n 1))))))
+(dotimes (i 100) (try (deep 100) (catch (e) e)))
+(assert (equal? (try (deep 200) (catch (e) (car (cdr e)))) "bottom"))
+
+; escapes pass through try
+(assert (equal? (call/ec (lambda (k) (try (k 1) (catch (e) 2)))) 1))
+
+; raise and try must be used correctly
+(assert-error 'LE_VALUE (raise 'NOT_AN_ERROR "message"))
+(assert (equal? (car (try (raise 'LE_ESCAPE "x") (catch (e) e))) 'LE_VALUE))
+(assert-error 'LE_TYPE (raise 'LE_ERROR 5))
+(assert-error 'LE_SYNTAX (try 1))
+(assert-error 'LE_SYNTAX (try (catch (e) e)))
+(assert-error 'LE_SYNTAX (try 1 (catch e e)))
+
+; OUTPUT(0)
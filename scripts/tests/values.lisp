@@ -0,0 +1,60 @@
+; Multiple values, returned with values and received by call-with-values and
+; let-values.
+
+(define divmod (lambda (a b) (values (/ a b) (- a (* b (/ a b))))))
+
+(assert (equal? (call-with-values (lambda () (divmod 17 5)) list) '(3 2)))
+(assert (equal? (call-with-values (lambda () (values)) list) '()))
+(assert (equal? (call-with-values (lambda () 7) list) '(7)))
+(assert (equal? (call-with-values (lambda () (values 1 2)) +) 3))
+(assert (equal? (call-with-values (lambda () (values 1 2 3 4 5 6)) list)
+                '(1 2 3 4 5 6)))
+
+; one value is just that value
+(assert (equal? (values 4) 4))
+
+; let-values, at the top level and within a lambda
+(assert (equal? (let-values (((q r) (divmod 17 5)) ((x) 10)) (list q r x))
+                '(3 2 10)))
+(define describe
+  (lambda (a b)
+    (let-values (((q r) (divmod a b)))
+      (list q r (lambda () (+ q r))))))
+(define result (describe 23 4))
+(assert (equal? (car result) 5))
+(assert (equal? (car (cdr result)) 3))
+(assert (equal? ((car (cdr (cdr result)))) 8))
+(assert (equal? (let-values ((() (values))) 'none) 'none))
+
+; later bindings may use earlier ones
+(assert (equal? (let-values (((a b) (values 1 2)) ((c) (+ a b))) c) 3))
+
+; the number of values must match
+(assert-error 'LE_2FEW (let-values (((a b c) (divmod 17 5))) a))
+(assert-error 'LE_2MANY (let-values (((a) (divmod 17 5))) a))
+(assert-error 'LE_2FEW ((lambda () (let-values (((a b) 1)) a))))
+(assert-error 'LE_2MANY (call-with-values (lambda () (values 1 2)) (lambda (x) x)))
+(assert-error 'LE_TYPE (let-values (((a 1) (values 1 2))) a))
+
+; values are received after the producer has finished with others
+(define nested
+  (lambda ()
+    (call-with-values
+      (lambda () (divmod 9 2))
+      (lambda (q r) (let-values (((a b) (values r q))) (list q r a b))))))
+(assert (equal? (nested) '(4 1 1 4)))
+
+; multiple values within values are just the first one
+(assert (equal? (call-with-values (lambda () (values (values 1 2) 3)) list)
+                '(1 3)))
+(assert (equal? (call-with-values (lambda () (values (values) 3)) list)
+                '(() 3)))
+
+; values which are kept aren't changed by later ones
+(define a (values 1 2))
+(define b (values 3 4))
+(assert (equal? (call-with-values (lambda () a) list) '(1 2)))
+(define both (list (values 1 2) (values 3 4)))
+(assert (equal? (call-with-values (lambda () (car both)) list) '(1 2)))
+
+; OUTPUT(0)
@@ -0,0 +1,51 @@
+; Vectors: a fixed number of items, indexed in constant time.
+
+(define v (make-vector 3 0))
+(assert (equal? v (vector 0 0 0)))
+(assert (= (vector-length v) 3))
+(vector-set! v 0 'a)
+(vector-set! v 2 "c")
+(assert (equal? (vector-ref v 0) 'a))
+(assert (equal? (vector->list v) '(a 0 "c")))
+(assert (null? (vector-ref (make-vector 1) 0)))
+(assert (= (vector-length (vector)) 0))
+
+; conversion to and from lists
+(assert (equal? (list->vector '(1 (2) "3")) (vector 1 '(2) "3")))
+(assert (equal? (vector->list (list->vector '())) '()))
+(assert (= (equal? (vector 1 2) '(1 2)) 0))
+(assert (= (equal? (vector 1 2) (vector 1 2 3)) 0))
+
+; map gives a vector when its first argument is one, and reduce takes either
+(assert (equal? (map + (vector 1 2 3) '(10 20)) (vector 11 22)))
+(assert (equal? (map + '(1 2 3) (vector 10 20 30)) '(11 22 33)))
+(assert (equal? (map (lambda (x) x) (vector)) (vector)))
+(assert (= (reduce + (vector 1 2 3 4)) 10))
+(assert (equal? (reduce (lambda (acc x) (cons x acc)) '() (vector 'a 'b)) '(b a)))
+
+; a lookup table filled in by a lambda
+(define squares
+  (lambda (n)
+    (let ((table (make-vector n)))
+      (dotimes (i n) (vector-set! table i (* i i)))
+      table)))
+(assert (= (vector-ref (squares 100) 99) 9801))
+
+; errors
+(assert-error 'LE_VALUE (vector-ref v 3))
+(assert-error 'LE_VALUE (vector-ref v (- 1)))
+(assert-error 'LE_VALUE (vector-set! v 3 'x))
+(assert-error 'LE_VALUE (make-vector (- 1)))
+(assert-error 'LE_TYPE (vector-ref '(1 2) 0))
+(assert-error 'LE_TYPE (vector-length "abc"))
+(assert-error 'LE_VALUE (list->vector '(1 . 2)))
+(assert-error 'LE_VALUE (map + (vector 1) 2))
+(assert-error 'LE_TYPE (reduce + 1 "abc"))
+(assert-error 'LE_VALUE (reduce + (vector 1)))
+
+(print v)
+(print (vector (vector 1 2) '(3) 4.5))
+
+; OUTPUT(0)
+; #(a 0 c)
+; #(#(1 2) (3 ) 4.5)
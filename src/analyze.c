@@ -0,0 +1,2252 @@
+/*
+ * analyze.c: analysis and optimization of code as it is defined
+ *
+ * When a lambda or macro is created, its body is passed through
+ * lisp_analyze(), which may return equivalent code that is cheaper to run.
+ * Analysis never modifies the code it is given, since that code may be shared
+ * with other data (e.g. a quoted list passed to eval). Instead, only the parts
+ * of the code which change are copied.
+ *
+ * There are two passes. Constant folding (optional) simplifies the code while
+ * keeping it as lists. Then, special forms (if, cond, let, let-values, lambda,
+ * define, quote, quasiquote, progn, set! and the loops), variables and calls
+ * are replaced with nodes, and calls to small lambdas are inlined:
+ * pre-parsed forms which evaluate directly, rather than looking up a builtin
+ * and calling it with the unparsed argument list each time they run. A special
+ * form (or arithmetic computed directly) still checks that its name refers to
+ * the same builtin each time, since the name may be re-bound after the lambda
+ * is created.
+ *
+ * Stephen Brennan <stephen@brennan.io>
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "funlisp_internal.h"
+
+/*
+ * Names bound by the code being analyzed: lambda arguments, let bindings and
+ * definitions. These shadow whatever the defining scope contains, so we can't
+ * assume anything about their values. Each frame corresponds to one scope
+ * created at runtime (by a lambda call or a let).
+ *
+ * The first nbound names are bound once, when the scope is created. The rest
+ * are definitions, which may be bound (or re-bound) at any time. A frame is
+ * opaque if its code may bind or look up names which we can't see, i.e. it
+ * uses eval or calls something which may be a macro. A frame assigns if its
+ * variables may change after they are bound (by set!, or because it is a loop).
+ * A lambda frame's scope is created within the lambda's closure, rather than
+ * the scope of the enclosing frame.
+ */
+struct frame {
+	lisp_symbol **names;
+	int count;
+	int alloc;
+	int nbound;
+	int opaque;
+	int assigns;
+	int lambda;
+	lisp_symbol *loop; /* the name of a named let, bound to the loop */
+	struct frame *up;
+};
+
+struct analysis {
+	lisp_runtime *rt;
+	lisp_scope *scope; /* the scope code is being defined in */
+	struct frame *frame;
+	lisp_list *inline_params; /* of the lambda being inlined, if any */
+	int inline_depth;
+	int failed; /* checking found an error, see check_call() */
+};
+
+/* Calls with more arguments than this have only their arity checked */
+#define CHECK_MAX_ARGS 8
+
+/* Limits on the lambdas inlined by analyze_inline() */
+#define INLINE_MAX_SIZE 24
+#define INLINE_MAX_DEPTH 4
+
+typedef lisp_value *(*walker)(struct analysis *an, lisp_value *form);
+
+static lisp_value *fold(struct analysis *an, lisp_value *form);
+
+static void frame_init(struct frame *f, struct frame *up)
+{
+	f->names = NULL;
+	f->count = 0;
+	f->alloc = 0;
+	f->nbound = 0;
+	f->opaque = 0;
+	f->assigns = 0;
+	f->lambda = 0;
+	f->loop = NULL;
+	f->up = up;
+}
+
+static void frame_destroy(struct frame *f)
+{
+	free(f->names);
+}
+
+static void frame_add(struct frame *f, lisp_symbol *name)
+{
+	if (f->count >= f->alloc) {
+		f->alloc = f->alloc ? f->alloc * 2 : 8;
+		f->names = realloc(f->names, f->alloc * sizeof(lisp_symbol*));
+	}
+	f->names[f->count++] = name;
+}
+
+static int is_symbol_named(lisp_value *v, char *name)
+{
+	return v->type == type_symbol && strcmp(((lisp_symbol*)v)->s, name) == 0;
+}
+
+/* Return the index of the symbol v within params, or -1 */
+static int param_index(lisp_list *params, lisp_value *v)
+{
+	int i = 0;
+
+	if (v->type != type_symbol)
+		return -1;
+	lisp_for_each(params) {
+		if (is_symbol_named(params->left, ((lisp_symbol*)v)->s))
+			return i;
+		i++;
+	}
+	return -1;
+}
+
+/*
+ * Add every name which could be defined by this code. This intentionally looks
+ * everywhere (even within quotes and nested lambdas), since binding a name
+ * which we don't know about is worse than ignoring one which we could know.
+ */
+static void frame_add_definitions(struct frame *f, lisp_value *code)
+{
+	lisp_list *l;
+
+	if (code->type != type_list || lisp_nil_p(code))
+		return;
+
+	l = (lisp_list *) code;
+	if ((is_symbol_named(l->left, "define") ||
+	     is_symbol_named(l->left, "import")) &&
+	    l->right->type == type_list && !lisp_nil_p(l->right) &&
+	    ((lisp_list*)l->right)->left->type == type_symbol)
+		frame_add(f, (lisp_symbol*) ((lisp_list*)l->right)->left);
+
+	lisp_for_each(l) {
+		frame_add_definitions(f, l->left);
+	}
+}
+
+/*
+ * Return true if code may use set!. Like frame_add_definitions(), this looks
+ * everywhere.
+ */
+static int has_assignment(lisp_value *code)
+{
+	lisp_list *l;
+
+	if (is_symbol_named(code, "set!"))
+		return 1;
+	if (code->type != type_list || lisp_nil_p(code))
+		return 0;
+
+	l = (lisp_list *) code;
+	lisp_for_each(l) {
+		if (has_assignment(l->left))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Return the innermost frame binding sym (or NULL). If it is bound by a
+ * definition in any frame, set defined.
+ */
+static struct frame *find_binding(struct frame *frame, lisp_symbol *sym,
+                                  int *defined)
+{
+	struct frame *f, *found = NULL;
+	int i;
+
+	*defined = 0;
+	for (f = frame; f; f = f->up) {
+		for (i = 0; i < f->count; i++) {
+			if (strcmp(f->names[i]->s, sym->s) == 0) {
+				if (!found)
+					found = f;
+				if (i >= f->nbound)
+					*defined = 1;
+			}
+		}
+	}
+	return found;
+}
+
+static int is_shadowed(struct analysis *an, lisp_symbol *sym)
+{
+	int defined;
+	return find_binding(an->frame, sym, &defined) != NULL;
+}
+
+/*
+ * Return the value an operator will have when the code runs, or NULL if we
+ * can't know it.
+ */
+static lisp_value *resolve(struct analysis *an, lisp_value *op)
+{
+	if (op->type != type_symbol || is_shadowed(an, (lisp_symbol*) op))
+		return NULL;
+	return lisp_scope_find(an->scope, (lisp_symbol*) op);
+}
+
+static lisp_builtin *resolve_builtin(struct analysis *an, lisp_value *op)
+{
+	lisp_value *v = resolve(an, op);
+	if (v && v->type == type_builtin)
+		return (lisp_builtin*) v;
+	return NULL;
+}
+
+static int is_opaque(struct analysis *an, struct frame *frame,
+                     lisp_value *code);
+
+static int any_opaque(struct analysis *an, struct frame *frame, lisp_list *list)
+{
+	lisp_for_each(list) {
+		if (is_opaque(an, frame, list->left))
+			return 1;
+	}
+	return 0;
+}
+
+/* Only the unquoted parts of a quasiquote template are code */
+static int template_is_opaque(struct analysis *an, struct frame *frame,
+                              lisp_value *template)
+{
+	lisp_list *l;
+
+	if (template->type != type_list || lisp_nil_p(template))
+		return 0;
+	l = (lisp_list *) template;
+	if (is_symbol_named(l->left, "unquote"))
+		return is_opaque(an, frame, template);
+	lisp_for_each(l) {
+		if (template_is_opaque(an, frame, l->left))
+			return 1;
+	}
+	return 0;
+}
+
+/* A binding of a let or loop is (names value), and only the value is code */
+static int binding_is_opaque(struct analysis *an, struct frame *frame,
+                             lisp_value *binding)
+{
+	if (binding->type != type_list || lisp_nil_p(binding))
+		return 0;
+	return any_opaque(an, frame, (lisp_list*) ((lisp_list*) binding)->right);
+}
+
+/*
+ * The name of a named let is bound to the loop itself, so calling it is fine.
+ * Its bindings are evaluated outside of the loop.
+ */
+static int named_let_is_opaque(struct analysis *an, struct frame *frame,
+                               lisp_list *args)
+{
+	struct frame loop;
+	lisp_list *l;
+	int opaque = 0;
+
+	if (args->right->type != type_list || lisp_nil_p(args->right))
+		return 0;
+	l = (lisp_list *) ((lisp_list *) args->right)->left;
+	lisp_for_each(l) {
+		if (binding_is_opaque(an, frame, l->left))
+			return 1;
+	}
+
+	frame_init(&loop, frame);
+	frame_add(&loop, (lisp_symbol*) args->left);
+	loop.nbound = loop.count;
+	loop.loop = (lisp_symbol*) args->left;
+	opaque = any_opaque(an, &loop,
+	                    (lisp_list*) ((lisp_list*) args->right)->right);
+	frame_destroy(&loop);
+	return opaque;
+}
+
+/*
+ * Return true if a special form, implemented by the builtin op, is opaque.
+ * Lists within it which aren't evaluated (such as quoted data, lambda
+ * parameters, let bindings and cond clauses) are not calls, so only the code
+ * within them is checked.
+ */
+static int syntax_is_opaque(struct analysis *an, struct frame *frame,
+                            lisp_list *form, lisp_builtin *op)
+{
+	lisp_list *args = (lisp_list *) form->right, *l;
+
+	if (args->type != type_list || lisp_nil_p((lisp_value*) args))
+		return 0;
+
+	if (op->call_v == lisp_builtin_quote) {
+		return 0;
+	} else if (op->call_v == lisp_builtin_quasiquote) {
+		return template_is_opaque(an, frame, args->left);
+	} else if (op->call == lisp_builtin_lambda ||
+	           op->call == lisp_builtin_macro) {
+		return any_opaque(an, frame, (lisp_list*) args->right);
+	} else if (op->call == lisp_builtin_let && args->left->type == type_symbol) {
+		return named_let_is_opaque(an, frame, args);
+	} else if (op->call == lisp_builtin_let ||
+	           op->call == lisp_builtin_let_values) {
+		l = (lisp_list *) args->left;
+		lisp_for_each(l) {
+			if (binding_is_opaque(an, frame, l->left))
+				return 1;
+		}
+		return any_opaque(an, frame, (lisp_list*) args->right);
+	} else if (op->call == lisp_builtin_dotimes ||
+	           op->call == lisp_builtin_for_each) {
+		return binding_is_opaque(an, frame, args->left) ||
+			any_opaque(an, frame, (lisp_list*) args->right);
+	} else if (op->call_v == lisp_builtin_cond) {
+		lisp_for_each(args) {
+			if (args->left->type == type_list &&
+			    any_opaque(an, frame, (lisp_list*) args->left))
+				return 1;
+		}
+		return 0;
+	} else if (op->call == lisp_builtin_try) {
+		l = lisp_try_catch_clause(args);
+		for (; args->type == type_list && !lisp_nil_p((lisp_value*) args);
+		     args = (lisp_list *) args->right) {
+			if (args->left == (lisp_value *) l)
+				return any_opaque(an, frame, (lisp_list*)
+				                  ((lisp_list*) l->right)->right);
+			if (is_opaque(an, frame, args->left))
+				return 1;
+		}
+		return 0;
+	}
+	return any_opaque(an, frame, args);
+}
+
+/*
+ * Return true if code, running within frame, may use names that don't appear
+ * in it: by calling eval, or by using a macro whose expansion we can't see.
+ * Any operator could be a macro by the time the code runs, unless it is bound
+ * to something else already. So besides known macros, this includes operators
+ * which aren't bound yet, and those bound by the frames, whose values we can't
+ * know. Like frame_add_definitions(), this errs on the side of caution.
+ */
+static int is_opaque(struct analysis *an, struct frame *frame, lisp_value *code)
+{
+	struct frame *bound;
+	lisp_symbol *sym;
+	lisp_list *l;
+	lisp_value *op;
+	int defined;
+
+	if (is_symbol_named(code, "eval"))
+		return 1;
+	if (code->type != type_list || lisp_nil_p(code))
+		return 0;
+
+	l = (lisp_list *) code;
+	if (l->left->type == type_symbol) {
+		sym = (lisp_symbol *) l->left;
+		bound = find_binding(frame, sym, &defined);
+		if (bound && (defined || !bound->loop ||
+		              strcmp(bound->loop->s, sym->s) != 0))
+			return 1;
+		op = bound ? NULL : lisp_scope_find(an->scope, sym);
+		if (!bound && (!op || (op->type == type_lambda &&
+		    ((lisp_lambda*)op)->lambda_type == TP_MACRO)))
+			return 1;
+		if (op && op->type == type_builtin && !((lisp_builtin*) op)->evald)
+			return syntax_is_opaque(an, frame, l, (lisp_builtin*) op);
+	}
+	lisp_for_each(l) {
+		if (is_opaque(an, frame, l->left))
+			return 1;
+	}
+	return !lisp_nil_p((lisp_value*) l) &&
+		is_opaque(an, frame, (lisp_value*) l);
+}
+
+/*
+ * Return true if form is a constant, setting value to what it evaluates to.
+ */
+static int is_constant(struct analysis *an, lisp_value *form, lisp_value **value)
+{
+	lisp_list *l;
+	lisp_builtin *op;
+
+	if (lisp_is_number(form) || form->type == type_string) {
+		*value = form;
+		return 1;
+	}
+	if (form->type != type_list || lisp_nil_p(form))
+		return 0;
+
+	l = (lisp_list *) form;
+	op = resolve_builtin(an, l->left);
+	if (!op || op->call_v != lisp_builtin_quote ||
+	    lisp_is_bad_list(l) || lisp_list_length(l) != 2)
+		return 0;
+	*value = ((lisp_list*) l->right)->left;
+	return 1;
+}
+
+/*
+ * Return code which evaluates to value, or NULL if we can't write it.
+ */
+static lisp_value *constant_form(struct analysis *an, lisp_value *value)
+{
+	lisp_symbol *quote;
+
+	if (lisp_is_number(value) || value->type == type_string)
+		return value;
+
+	quote = lisp_symbol_new(an->rt, "quote", 0);
+	if (!resolve_builtin(an, (lisp_value*) quote))
+		return NULL;
+	return (lisp_value *) lisp_quote(an->rt, value);
+}
+
+static int contains_unquote(lisp_value *v)
+{
+	lisp_list *l;
+
+	if (is_symbol_named(v, "unquote"))
+		return 1;
+	if (v->type != type_list)
+		return 0;
+
+	l = (lisp_list *) v;
+	lisp_for_each(l) {
+		if (contains_unquote(l->left))
+			return 1;
+	}
+	return !lisp_nil_p((lisp_value*) l) && contains_unquote((lisp_value*) l);
+}
+
+/* Quasiquote can't handle templates containing a bad list */
+static int template_is_valid(lisp_value *v)
+{
+	lisp_list *l;
+
+	if (v->type != type_list)
+		return 1;
+	if (lisp_is_bad_list((lisp_list*) v))
+		return 0;
+	l = (lisp_list *) v;
+	lisp_for_each(l) {
+		if (!template_is_valid(l->left))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Apply fn to each item of a list, returning the original list if nothing
+ * changed.
+ */
+static lisp_list *walk_list(struct analysis *an, lisp_list *list, walker fn)
+{
+	lisp_value *left;
+	lisp_list *right;
+
+	if (list->type != type_list || lisp_nil_p((lisp_value*) list))
+		return list;
+
+	left = fn(an, list->left);
+	right = walk_list(an, (lisp_list*) list->right, fn);
+	if (left == list->left && (lisp_value*) right == list->right)
+		return list;
+	return lisp_list_new(an->rt, left, (lisp_value*) right);
+}
+
+static lisp_list *fold_list(struct analysis *an, lisp_list *list)
+{
+	return walk_list(an, list, fold);
+}
+
+/*
+ * Push a frame for the arguments and body of a lambda. Returns false (without
+ * pushing anything) if the argument list is invalid.
+ */
+static int push_lambda_frame(struct analysis *an, struct frame *frame,
+                             lisp_list *params, lisp_list *body)
+{
+	if (lisp_is_bad_list(params))
+		return 0;
+
+	frame_init(frame, an->frame);
+	lisp_for_each(params) {
+		if (params->left->type != type_symbol) {
+			frame_destroy(frame);
+			return 0;
+		}
+		frame_add(frame, (lisp_symbol*) params->left);
+	}
+	frame->nbound = frame->count;
+	frame_add_definitions(frame, (lisp_value*) body);
+	frame->opaque = is_opaque(an, frame, (lisp_value*) body);
+	frame->assigns = has_assignment((lisp_value*) body);
+	frame->lambda = 1;
+	an->frame = frame;
+	return 1;
+}
+
+/*
+ * Push a let frame, once the names its bindings bind have been added.
+ */
+static void finish_let_frame(struct analysis *an, struct frame *frame,
+                             lisp_list *bindings, lisp_list *body)
+{
+	frame->nbound = frame->count;
+	frame_add_definitions(frame, (lisp_value*) body);
+	frame->opaque = is_opaque(an, frame, (lisp_value*) bindings) ||
+		is_opaque(an, frame, (lisp_value*) body);
+	frame->assigns = has_assignment((lisp_value*) bindings) ||
+		has_assignment((lisp_value*) body);
+	an->frame = frame;
+}
+
+/*
+ * Push a frame for the bindings and body of a let, or a named let if name
+ * isn't NULL. Returns false (without pushing anything) if the bindings are
+ * invalid.
+ */
+static int push_let_frame(struct analysis *an, struct frame *frame,
+                          lisp_symbol *name, lisp_list *bindings,
+                          lisp_list *body)
+{
+	lisp_list *binding;
+
+	if (lisp_is_bad_list(bindings))
+		return 0;
+
+	frame_init(frame, an->frame);
+	if (name)
+		frame_add(frame, name);
+	frame->loop = name;
+	lisp_for_each(bindings) {
+		binding = (lisp_list *) bindings->left;
+		if (binding->type != type_list || lisp_is_bad_list(binding) ||
+		    lisp_list_length(binding) != 2 ||
+		    binding->left->type != type_symbol) {
+			frame_destroy(frame);
+			return 0;
+		}
+		frame_add(frame, (lisp_symbol*) binding->left);
+	}
+	finish_let_frame(an, frame, bindings, body);
+	frame->assigns = frame->assigns || name;
+	return 1;
+}
+
+/*
+ * Push a frame for the bindings and body of a let-values, in which each
+ * binding has a list of names. Returns false (without pushing anything) if
+ * the bindings are invalid.
+ */
+static int push_let_values_frame(struct analysis *an, struct frame *frame,
+                                 lisp_list *bindings, lisp_list *body)
+{
+	lisp_list *binding, *names;
+
+	if (lisp_is_bad_list(bindings))
+		return 0;
+
+	frame_init(frame, an->frame);
+	lisp_for_each(bindings) {
+		binding = (lisp_list *) bindings->left;
+		if (binding->type != type_list || lisp_is_bad_list(binding) ||
+		    lisp_list_length(binding) != 2 ||
+		    binding->left->type != type_list ||
+		    lisp_is_bad_list((lisp_list*) binding->left)) {
+			frame_destroy(frame);
+			return 0;
+		}
+		names = (lisp_list *) binding->left;
+		lisp_for_each(names) {
+			if (names->left->type != type_symbol) {
+				frame_destroy(frame);
+				return 0;
+			}
+			frame_add(frame, (lisp_symbol*) names->left);
+		}
+	}
+	finish_let_frame(an, frame, bindings, body);
+	return 1;
+}
+
+/*
+ * Push a frame for a variable and the body it is bound in, as for dotimes,
+ * for-each and the catch clause of try.
+ */
+static void push_var_frame(struct analysis *an, struct frame *frame,
+                           lisp_symbol *var, lisp_list *body)
+{
+	frame_init(frame, an->frame);
+	frame_add(frame, var);
+	frame->nbound = frame->count;
+	frame_add_definitions(frame, (lisp_value*) body);
+	frame->opaque = is_opaque(an, frame, (lisp_value*) body);
+	frame->assigns = has_assignment((lisp_value*) body);
+	an->frame = frame;
+}
+
+static void pop_frame(struct analysis *an)
+{
+	struct frame *frame = an->frame;
+	an->frame = frame->up;
+	frame_destroy(frame);
+}
+
+static lisp_value *rebuild(struct analysis *an, lisp_list *form, lisp_list *args)
+{
+	lisp_list *copy;
+
+	if ((lisp_value*) args == form->right)
+		return (lisp_value*) form;
+	copy = lisp_list_new(an->rt, form->left, (lisp_value*) args);
+	copy->line = form->line;
+	return (lisp_value*) copy;
+}
+
+/*
+ * Call a pure builtin if all of its arguments are constant, and return the
+ * constant result. Errors are left for runtime, so that they happen when (and
+ * if) the code actually runs.
+ */
+static lisp_value *fold_call(struct analysis *an, lisp_builtin *op,
+                             lisp_list *args)
+{
+	lisp_value **argv, *result;
+	int argc, i = 0;
+
+	if (!lisp_builtin_pure(op))
+		return NULL;
+
+	argc = lisp_list_length(args);
+	argv = lisp_vstack_push(an->rt, argc);
+	lisp_for_each(args) {
+		if (!is_constant(an, args->left, &argv[i++])) {
+			lisp_vstack_pop(an->rt, argc);
+			return NULL;
+		}
+	}
+
+	result = op->call_v(an->rt, an->scope, argc, argv, op->user);
+	lisp_vstack_pop(an->rt, argc);
+	if (!result) {
+		lisp_clear_error(an->rt);
+		return NULL;
+	}
+	return constant_form(an, result);
+}
+
+static lisp_value *fold_if(struct analysis *an, lisp_list *form)
+{
+	lisp_list *args = (lisp_list *) form->right;
+	lisp_list *then, *otherwise;
+	lisp_value *value;
+
+	if (lisp_list_length(args) != 3)
+		return (lisp_value*) form;
+
+	args = fold_list(an, args);
+	if (!is_constant(an, args->left, &value))
+		return rebuild(an, form, args);
+
+	then = (lisp_list *) args->right;
+	otherwise = (lisp_list *) then->right;
+	return lisp_truthy(value) ? then->left : otherwise->left;
+}
+
+static int cond_is_valid(lisp_list *clauses)
+{
+	lisp_list *clause;
+
+	if (lisp_nil_p((lisp_value*) clauses))
+		return 0;
+	lisp_for_each(clauses) {
+		if (clauses->left->type != type_list)
+			return 0;
+		clause = (lisp_list *) clauses->left;
+		if (lisp_is_bad_list(clause) || lisp_list_length(clause) != 2)
+			return 0;
+	}
+	return 1;
+}
+
+static lisp_value *fold_cond(struct analysis *an, lisp_list *form)
+{
+	lisp_list *clauses = (lisp_list *) form->right;
+	lisp_list *folded = (lisp_list *) lisp_nil_new(an->rt), *tail = NULL;
+	lisp_list *clause;
+	lisp_value *value;
+
+	if (!cond_is_valid(clauses))
+		return (lisp_value*) form;
+
+	lisp_for_each(clauses) {
+		clause = fold_list(an, (lisp_list*) clauses->left);
+		if (is_constant(an, clause->left, &value)) {
+			if (!lisp_truthy(value))
+				continue; /* never taken */
+			if (lisp_nil_p((lisp_value*) folded))
+				return ((lisp_list*) clause->right)->left;
+			lisp_list_append(an->rt, &folded, &tail, (lisp_value*) clause);
+			break; /* nothing after this can be reached */
+		}
+		lisp_list_append(an->rt, &folded, &tail, (lisp_value*) clause);
+	}
+
+	if (lisp_nil_p((lisp_value*) folded)) {
+		value = constant_form(an, lisp_nil_new(an->rt));
+		return value ? value : (lisp_value*) form;
+	}
+	return (lisp_value*) lisp_list_new(an->rt, form->left, (lisp_value*) folded);
+}
+
+static lisp_value *fold_lambda(struct analysis *an, lisp_list *form)
+{
+	lisp_list *args = (lisp_list *) form->right;
+	lisp_list *params, *body, *it;
+	struct frame frame;
+
+	if (lisp_list_length(args) < 2 || args->left->type != type_list)
+		return (lisp_value*) form;
+
+	params = (lisp_list *) args->left;
+	body = (lisp_list *) args->right;
+	if (!push_lambda_frame(an, &frame, params, body))
+		return (lisp_value*) form;
+	it = fold_list(an, body);
+	pop_frame(an);
+
+	if (it == body)
+		return (lisp_value*) form;
+	return (lisp_value*) lisp_list_new(an->rt, form->left,
+		(lisp_value*) lisp_list_new(an->rt, (lisp_value*) params,
+		                            (lisp_value*) it));
+}
+
+static lisp_value *fold_let(struct analysis *an, lisp_list *form)
+{
+	lisp_list *args = (lisp_list *) form->right;
+	lisp_list *bindings, *body, *it, *binding;
+	lisp_list *new_bindings = NULL, *tail = NULL;
+	struct frame frame;
+	int changed = 0;
+
+	if (lisp_list_length(args) < 2 || args->left->type != type_list)
+		return (lisp_value*) form;
+
+	bindings = (lisp_list *) args->left;
+	body = (lisp_list *) args->right;
+	if (!push_let_frame(an, &frame, NULL, bindings, body))
+		return (lisp_value*) form;
+
+	new_bindings = (lisp_list *) lisp_nil_new(an->rt);
+	it = bindings;
+	lisp_for_each(it) {
+		binding = fold_list(an, (lisp_list*) it->left);
+		changed = changed || binding != (lisp_list*) it->left;
+		lisp_list_append(an->rt, &new_bindings, &tail, (lisp_value*) binding);
+	}
+	it = fold_list(an, body);
+	pop_frame(an);
+
+	if (!changed && it == body)
+		return (lisp_value*) form;
+	if (!changed)
+		new_bindings = bindings;
+	return (lisp_value*) lisp_list_new(an->rt, form->left,
+		(lisp_value*) lisp_list_new(an->rt, (lisp_value*) new_bindings,
+		                            (lisp_value*) it));
+}
+
+static lisp_value *fold_quote(struct analysis *an, lisp_list *form)
+{
+	lisp_value *value;
+	(void) an;
+
+	if (lisp_list_length(form) != 2)
+		return (lisp_value*) form;
+	value = ((lisp_list*) form->right)->left;
+	if (lisp_is_number(value) || value->type == type_string)
+		return value;
+	return (lisp_value*) form;
+}
+
+static lisp_value *fold_quasiquote(struct analysis *an, lisp_list *form)
+{
+	lisp_value *value, *constant;
+
+	if (lisp_list_length(form) != 2)
+		return (lisp_value*) form;
+	value = ((lisp_list*) form->right)->left;
+	if (contains_unquote(value) || !template_is_valid(value))
+		return (lisp_value*) form;
+	constant = constant_form(an, value);
+	return constant ? constant : (lisp_value*) form;
+}
+
+static lisp_value *fold(struct analysis *an, lisp_value *form)
+{
+	lisp_list *list, *args;
+	lisp_builtin *op;
+	lisp_value *v;
+
+	if (form->type != type_list || lisp_nil_p(form) ||
+	    lisp_is_bad_list((lisp_list*) form))
+		return form;
+
+	list = (lisp_list *) form;
+	v = resolve(an, list->left);
+	if (!v)
+		return form;
+
+	if (v->type == type_lambda && ((lisp_lambda*)v)->lambda_type == TP_LAMBDA)
+		return rebuild(an, list, fold_list(an, (lisp_list*) list->right));
+	if (v->type != type_builtin)
+		return form;
+
+	op = (lisp_builtin *) v;
+	if (op->call_v == lisp_builtin_quote)
+		return fold_quote(an, list);
+	else if (op->call_v == lisp_builtin_quasiquote)
+		return fold_quasiquote(an, list);
+	else if (op->call_v == lisp_builtin_if)
+		return fold_if(an, list);
+	else if (op->call_v == lisp_builtin_cond)
+		return fold_cond(an, list);
+	else if (op->call == lisp_builtin_lambda || op->call == lisp_builtin_macro)
+		return fold_lambda(an, list);
+	else if (op->call == lisp_builtin_let)
+		return fold_let(an, list);
+	else if (op->call_v == lisp_builtin_define || op->call == lisp_builtin_progn)
+		return rebuild(an, list, fold_list(an, (lisp_list*) list->right));
+	else if (!op->evald)
+		return form; /* some other syntax we don't understand */
+
+	args = fold_list(an, (lisp_list*) list->right);
+	v = fold_call(an, op, args);
+	return v ? v : rebuild(an, list, args);
+}
+
+/*
+ * Special form nodes. Each node is created by analyze_*() below only once the
+ * form is known to be well formed, so execution doesn't need to check syntax.
+ */
+
+static lisp_value *exec_quote(lisp_runtime *rt, lisp_scope *scope,
+                              lisp_node *node)
+{
+	(void) rt;
+	(void) scope;
+	return node->a;
+}
+
+static lisp_value *exec_if(lisp_runtime *rt, lisp_scope *scope,
+                           lisp_node *node)
+{
+	lisp_value *condition = lisp_eval(rt, scope, node->a);
+	lisp_error_check(condition);
+	if (lisp_truthy(condition))
+		return lisp_eval(rt, scope, node->b);
+	else
+		return lisp_eval(rt, scope, node->c);
+}
+
+static lisp_value *exec_cond(lisp_runtime *rt, lisp_scope *scope,
+                             lisp_node *node)
+{
+	lisp_list *clauses = node->body, *clause;
+	lisp_value *test;
+
+	lisp_for_each(clauses) {
+		clause = (lisp_list *) clauses->left;
+		test = lisp_eval(rt, scope, clause->left);
+		lisp_error_check(test);
+		if (lisp_truthy(test))
+			return lisp_eval(rt, scope, ((lisp_list*) clause->right)->left);
+	}
+	return lisp_nil_new(rt);
+}
+
+static lisp_value *exec_let(lisp_runtime *rt, lisp_scope *scope,
+                            lisp_node *node)
+{
+	lisp_list *bindings = (lisp_list *) node->a, *binding;
+	lisp_scope *new_scope;
+	lisp_value *value;
+
+	new_scope = lisp_new_empty_scope(rt);
+	new_scope->up = scope;
+
+	lisp_for_each(bindings) {
+		binding = (lisp_list *) bindings->left;
+		value = lisp_eval(rt, new_scope, ((lisp_list*) binding->right)->left);
+		lisp_error_check(value);
+		lisp_scope_bind(new_scope, (lisp_symbol*) binding->left, value);
+	}
+	return lisp_progn(rt, new_scope, node->body);
+}
+
+static lisp_value *exec_let_values(lisp_runtime *rt, lisp_scope *scope,
+                                   lisp_node *node)
+{
+	lisp_list *bindings = (lisp_list *) node->a, *binding;
+	lisp_scope *new_scope;
+	lisp_value *value;
+
+	new_scope = lisp_new_empty_scope(rt);
+	new_scope->up = scope;
+
+	lisp_for_each(bindings) {
+		binding = (lisp_list *) bindings->left;
+		value = lisp_eval(rt, new_scope, ((lisp_list*) binding->right)->left);
+		lisp_error_check(value);
+		if (!lisp_bind_values(rt, new_scope, (lisp_list*) binding->left,
+		                      value))
+			return NULL;
+	}
+	return lisp_progn(rt, new_scope, node->body);
+}
+
+static lisp_value *exec_define(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_node *node)
+{
+	lisp_value *value = lisp_eval(rt, scope, node->b);
+	lisp_error_check(value);
+	lisp_scope_bind(scope, (lisp_symbol*) node->a, value);
+	return value;
+}
+
+static lisp_value *exec_progn(lisp_runtime *rt, lisp_scope *scope,
+                              lisp_node *node)
+{
+	return lisp_progn(rt, scope, node->body);
+}
+
+static lisp_value *exec_set(lisp_runtime *rt, lisp_scope *scope,
+                            lisp_node *node)
+{
+	lisp_value *value = lisp_eval(rt, scope, node->b);
+	lisp_error_check(value);
+	return lisp_scope_set(rt, scope, (lisp_symbol*) node->a, value);
+}
+
+static lisp_value *exec_while(lisp_runtime *rt, lisp_scope *scope,
+                              lisp_node *node)
+{
+	return lisp_loop_while(rt, scope, node->a, node->body);
+}
+
+static lisp_value *exec_dotimes(lisp_runtime *rt, lisp_scope *scope,
+                                lisp_node *node)
+{
+	return lisp_loop_dotimes(rt, scope, (lisp_symbol*) node->a, node->b,
+	                         node->body);
+}
+
+static lisp_value *exec_for_each(lisp_runtime *rt, lisp_scope *scope,
+                                 lisp_node *node)
+{
+	return lisp_loop_for_each(rt, scope, (lisp_symbol*) node->a, node->b,
+	                          node->body);
+}
+
+static lisp_value *exec_named_let(lisp_runtime *rt, lisp_scope *scope,
+                                  lisp_node *node)
+{
+	return lisp_loop_named_let(rt, scope, (lisp_symbol*) node->a,
+	                           (lisp_list*) node->b, node->body);
+}
+
+static lisp_value *exec_try(lisp_runtime *rt, lisp_scope *scope,
+                            lisp_node *node)
+{
+	return lisp_try(rt, scope, node->body, (lisp_symbol*) node->a,
+	                (lisp_list*) node->b);
+}
+
+/*
+ * One list within a quasiquote template which contains an unquote. Each item
+ * of body evaluates to the corresponding item of the new list.
+ */
+static lisp_value *exec_quasiquote(lisp_runtime *rt, lisp_scope *scope,
+                                   lisp_node *node)
+{
+	lisp_list *items = node->body, *rv, *tail = NULL;
+	lisp_value *value;
+
+	rv = (lisp_list *) lisp_nil_new(rt);
+	lisp_for_each(items) {
+		value = lisp_eval(rt, scope, items->left);
+		lisp_error_check(value);
+		lisp_list_append(rt, &rv, &tail, value);
+	}
+	return (lisp_value *) rv;
+}
+
+/*
+ * Return the closure for a lambda node created within scope. When the node has
+ * a list of captured names (b), the closure contains only those, copied out of
+ * the scopes between scope and the scope the enclosing code was defined in
+ * (c). Otherwise, the closure is the entire scope.
+ */
+static lisp_scope *new_closure(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_node *node)
+{
+	lisp_list *names = (lisp_list *) node->b;
+	lisp_scope *base = (lisp_scope *) node->c, *flat, *s;
+	lisp_value *value;
+
+	if (!names)
+		return scope;
+	if (lisp_nil_p((lisp_value*) names))
+		return base;
+
+	flat = lisp_new_empty_scope(rt);
+	flat->up = base;
+	lisp_for_each(names) {
+		value = NULL;
+		for (s = scope; s && s != base && !value; s = s->up)
+			value = ht_get_ptr(&s->scope, names->left);
+		if (!value)
+			return scope; /* not bound yet, e.g. a later let binding */
+		ht_insert_ptr(&flat->scope, names->left, value);
+	}
+	return flat;
+}
+
+static lisp_value *new_lambda(lisp_runtime *rt, lisp_scope *scope,
+                              lisp_node *node, int lambda_type)
+{
+	lisp_lambda *lambda = (lisp_lambda*) lisp_new(rt, type_lambda);
+	lambda->args = (lisp_list *) node->a;
+	lambda->code = node->body; /* analyzed along with the enclosing code */
+	lambda->closure = new_closure(rt, scope, node);
+	lambda->lambda_type = lambda_type;
+	return (lisp_value *) lambda;
+}
+
+static lisp_value *exec_lambda(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_node *node)
+{
+	return new_lambda(rt, scope, node, TP_LAMBDA);
+}
+
+static lisp_value *exec_macro(lisp_runtime *rt, lisp_scope *scope,
+                              lisp_node *node)
+{
+	return new_lambda(rt, scope, node, TP_MACRO);
+}
+
+/*
+ * A variable bound by an enclosing frame of the same lambda. The scope binding
+ * it is n levels up. It may not be bound yet (e.g. a let binding referring to
+ * a later one), in which case we look further up like the interpreter would.
+ */
+static lisp_value *exec_local(lisp_runtime *rt, lisp_scope *scope,
+                              lisp_node *node)
+{
+	lisp_scope *s = scope;
+	lisp_value *value;
+	int i;
+
+	for (i = 0; i < node->n; i++)
+		s = s->up;
+	value = ht_get_ptr(&s->scope, node->a);
+	if (value)
+		return value;
+	return lisp_scope_lookup(rt, scope, (lisp_symbol*) node->a);
+}
+
+/*
+ * An argument of the innermost inlined lambda whose arguments have been
+ * evaluated (see exec_inline()). Argument n is read straight from the value
+ * stack, since an inlined call has no scope.
+ */
+static lisp_value *exec_inline_arg(lisp_runtime *rt, lisp_scope *scope,
+                                   lisp_node *node)
+{
+	unsigned int i = rt->inlined_depth;
+	(void) scope;
+
+	while (!rt->inlined[i - 1].argv)
+		i--;
+	return rt->inlined[i - 1].argv[node->n];
+}
+
+/*
+ * Find a variable in the global scopes starting at scope, and remember its
+ * cell (in cache) and where the search started (in c) for next time. If any
+ * scope along the way isn't global, just look it up.
+ */
+static lisp_value *lookup_global(lisp_runtime *rt, lisp_scope *scope,
+                                 lisp_node *node)
+{
+	struct lisp_cell *cell;
+	lisp_scope *s;
+
+	for (s = scope; s && s->global; s = s->up) {
+		cell = ht_get_ptr(&s->scope, node->a);
+		if (cell) {
+			node->c = (lisp_value *) scope;
+			node->cache = cell;
+			return cell->value;
+		}
+	}
+	return lisp_scope_lookup(rt, scope, (lisp_symbol*) node->a);
+}
+
+/*
+ * A variable which the enclosing lambda doesn't bind, so it is looked up
+ * starting from the lambda's closure, n + 1 levels up. When that is the same
+ * global scope as last time, the variable's cell is still the one it would
+ * find, unless the name has been bound somewhere in between.
+ */
+static lisp_value *exec_global(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_node *node)
+{
+	struct lisp_cell *cell = node->cache;
+	int i;
+
+	for (i = 0; i <= node->n; i++)
+		scope = scope->up;
+	if (cell && (lisp_scope *) node->c == scope && !cell->shadowed)
+		return cell->value;
+	return lookup_global(rt, scope, node);
+}
+
+static int eval_args(lisp_runtime *rt, lisp_scope *scope, lisp_node *node,
+                     lisp_value **argv)
+{
+	lisp_list *args = node->body;
+	int i = 0;
+
+	lisp_for_each(args) {
+		argv[i] = lisp_eval(rt, scope, args->left);
+		if (!argv[i])
+			return 0;
+		i++;
+	}
+	return 1;
+}
+
+/*
+ * Call the operator of a call node with n arguments. Lambdas and evaluated
+ * builtins receive the analyzed arguments (body): builtins with the argv
+ * convention and lambdas have them evaluated straight onto the value stack.
+ * Anything else (e.g. a macro) gets the original arguments (b).
+ */
+static lisp_value *call_node(lisp_runtime *rt, lisp_scope *scope,
+                             lisp_node *node, lisp_value *callable)
+{
+	lisp_value **argv, *rv;
+	lisp_builtin *builtin = NULL;
+
+	if (callable->type == type_builtin &&
+	    ((lisp_builtin*) callable)->evald) {
+		builtin = (lisp_builtin *) callable;
+		if (!builtin->call_v)
+			return lisp_call(rt, scope, callable, node->body);
+	} else if (callable->type != type_lambda ||
+	           ((lisp_lambda*) callable)->lambda_type != TP_LAMBDA) {
+		return lisp_call(rt, scope, callable, (lisp_list*) node->b);
+	}
+
+	lisp_stack_push(rt, callable, (lisp_list*) node->b, scope);
+	argv = lisp_vstack_push(rt, node->n);
+	if (!eval_args(rt, scope, node, argv))
+		rv = NULL;
+	else if (builtin)
+		rv = builtin->call_v(rt, scope, node->n, argv, builtin->user);
+	else
+		rv = lisp_lambda_call_v(rt, (lisp_lambda*) callable, node->n, argv);
+	lisp_vstack_pop(rt, node->n);
+	rt->stack_depth--;
+	return rv;
+}
+
+/*
+ * Call sites specialize themselves as they run (quickening). The first time a
+ * call node runs, exec_call() records the lambda or builtin it calls in c, and
+ * switches the node to an exec function which only checks that the operator is
+ * still the same before calling it directly. If that check ever fails, the
+ * node is deoptimized to exec_call_generic() for good, so that a site which
+ * sees many operators doesn't keep switching back and forth.
+ */
+
+static lisp_value *exec_call_generic(lisp_runtime *rt, lisp_scope *scope,
+                                     lisp_node *node)
+{
+	lisp_value *callable = lisp_eval(rt, scope, node->a);
+	lisp_error_check(callable);
+	return call_node(rt, scope, node, callable);
+}
+
+static lisp_value *deoptimize(lisp_runtime *rt, lisp_scope *scope,
+                              lisp_node *node, lisp_value *callable)
+{
+	node->exec = exec_call_generic;
+	node->c = NULL;
+	rt->quicken.deoptimized++;
+	return call_node(rt, scope, node, callable);
+}
+
+static lisp_value *exec_call_lambda(lisp_runtime *rt, lisp_scope *scope,
+                                    lisp_node *node)
+{
+	lisp_value *callable, **argv, *rv = NULL;
+
+	callable = lisp_eval(rt, scope, node->a);
+	lisp_error_check(callable);
+	if (callable != node->c)
+		return deoptimize(rt, scope, node, callable);
+
+	lisp_stack_push(rt, callable, (lisp_list*) node->b, scope);
+	argv = lisp_vstack_push(rt, node->n);
+	if (eval_args(rt, scope, node, argv))
+		rv = lisp_lambda_call_v(rt, (lisp_lambda*) callable, node->n, argv);
+	lisp_vstack_pop(rt, node->n);
+	rt->stack_depth--;
+	return rv;
+}
+
+static lisp_value *exec_call_builtin(lisp_runtime *rt, lisp_scope *scope,
+                                     lisp_node *node)
+{
+	lisp_value *callable, **argv, *rv = NULL;
+	lisp_builtin *builtin;
+
+	callable = lisp_eval(rt, scope, node->a);
+	lisp_error_check(callable);
+	if (callable != node->c)
+		return deoptimize(rt, scope, node, callable);
+
+	builtin = (lisp_builtin *) callable;
+	lisp_stack_push(rt, callable, (lisp_list*) node->b, scope);
+	argv = lisp_vstack_push(rt, node->n);
+	if (eval_args(rt, scope, node, argv))
+		rv = builtin->call_v(rt, scope, node->n, argv, builtin->user);
+	lisp_vstack_pop(rt, node->n);
+	rt->stack_depth--;
+	return rv;
+}
+
+/*
+ * A call which checking found passes the right number of arguments to the
+ * lambda c (see check_call()), so they are bound without being counted again.
+ * Like the quickened calls above, it is deoptimized if the operator changes.
+ */
+static lisp_value *exec_call_verified(lisp_runtime *rt, lisp_scope *scope,
+                                      lisp_node *node)
+{
+	lisp_value *callable, **argv, *rv = NULL;
+
+	callable = lisp_eval(rt, scope, node->a);
+	lisp_error_check(callable);
+	if (callable != node->c)
+		return deoptimize(rt, scope, node, callable);
+
+	lisp_stack_push(rt, callable, (lisp_list*) node->b, scope);
+	argv = lisp_vstack_push(rt, node->n);
+	if (eval_args(rt, scope, node, argv))
+		rv = lisp_lambda_call_verified(rt, (lisp_lambda*) callable, argv);
+	lisp_vstack_pop(rt, node->n);
+	rt->stack_depth--;
+	return rv;
+}
+
+/*
+ * A call to a small lambda (c), whose body is analyzed into the caller (body).
+ * As long as the operator (a) is still that lambda, its arguments are
+ * evaluated onto the value stack and the body runs without a scope of its own.
+ * Otherwise, the original call (b) runs instead. The call is recorded in the
+ * runtime's side table rather than on the stack, so that stack traces remain
+ * the same.
+ */
+static lisp_value *exec_inline(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_node *node)
+{
+	lisp_node *call = (lisp_node *) node->b;
+	lisp_value *callable, **argv, *rv = NULL;
+
+	callable = lisp_eval(rt, scope, node->a);
+	lisp_error_check(callable);
+	if (callable != node->c)
+		return lisp_eval(rt, scope, node->b);
+
+	lisp_inline_push(rt, callable);
+	argv = lisp_vstack_push(rt, call->n);
+	if (eval_args(rt, scope, call, argv)) {
+		rt->inlined[rt->inlined_depth - 1].argv = argv;
+		rv = lisp_eval(rt, scope, node->body->left);
+	}
+	lisp_vstack_pop(rt, call->n);
+	rt->inlined_depth--;
+	return rv;
+}
+
+/*
+ * Bind the arguments of the innermost inlined lambda whose arguments have been
+ * evaluated in a new scope within scope, so that code which refers to them by
+ * name can run.
+ */
+static lisp_scope *inline_scope(lisp_runtime *rt, lisp_scope *scope)
+{
+	unsigned int i = rt->inlined_depth;
+	lisp_scope *new_scope;
+	lisp_list *params;
+	lisp_value **argv;
+
+	while (!rt->inlined[i - 1].argv)
+		i--;
+	argv = rt->inlined[i - 1].argv;
+	params = ((lisp_lambda *) rt->inlined[i - 1].callable)->args;
+
+	new_scope = lisp_new_empty_scope(rt);
+	new_scope->up = scope;
+	lisp_for_each(params) {
+		lisp_scope_bind(new_scope, (lisp_symbol*) params->left, *argv++);
+	}
+	return new_scope;
+}
+
+/*
+ * Special forms and fast paths are analyzed for the builtin their operator (a)
+ * was bound to when the lambda was created (c). Like a quickened call, the
+ * guard checks that the operator is still the same before running the analyzed
+ * form (b). Otherwise, the original form runs just as it would have without
+ * analysis, within a scope for the arguments if it is part of an inlined
+ * lambda (n).
+ */
+static lisp_value *exec_guard(lisp_runtime *rt, lisp_scope *scope,
+                              lisp_node *node)
+{
+	lisp_value *op = lisp_eval(rt, scope, node->a);
+	lisp_error_check(op);
+	if (op == node->c)
+		return lisp_eval(rt, scope, node->b);
+	if (node->n)
+		scope = inline_scope(rt, scope);
+	return lisp_eval(rt, scope, node->form);
+}
+
+static lisp_value *exec_call(lisp_runtime *rt, lisp_scope *scope,
+                             lisp_node *node)
+{
+	lisp_value *callable = lisp_eval(rt, scope, node->a);
+	lisp_builtin *builtin = (lisp_builtin *) callable;
+	lisp_error_check(callable);
+
+	if (callable->type == type_lambda &&
+	    ((lisp_lambda*) callable)->lambda_type == TP_LAMBDA)
+		node->exec = exec_call_lambda;
+	else if (callable->type == type_builtin && builtin->evald &&
+	         builtin->call_v)
+		node->exec = exec_call_builtin;
+	else
+		node->exec = exec_call_generic;
+
+	if (node->exec != exec_call_generic) {
+		node->c = callable;
+		rt->quicken.specialized++;
+	}
+	return call_node(rt, scope, node, callable);
+}
+
+static lisp_value *analyze_form(struct analysis *an, lisp_value *form);
+
+static lisp_list *analyze_list(struct analysis *an, lisp_list *list)
+{
+	return walk_list(an, list, analyze_form);
+}
+
+static lisp_node *new_node(struct analysis *an, lisp_node_exec exec,
+                           lisp_list *form)
+{
+	lisp_node *node = (lisp_node *) lisp_new(an->rt, type_node);
+	node->exec = exec;
+	node->form = (lisp_value *) form;
+	return node;
+}
+
+/*
+ * Variables bound within the current lambda are found in a known scope, as
+ * long as the binding isn't a definition and nothing could bind it behind our
+ * back (see is_opaque(): even a call to a macro which is only defined after
+ * the lambda could). Variables which the lambda doesn't bind skip straight to
+ * its closure. Within an inlined lambda, its arguments are read from the value
+ * stack.
+ */
+static lisp_value *analyze_symbol(struct analysis *an, lisp_symbol *sym)
+{
+	struct frame *f, *bound;
+	lisp_node *node;
+	int defined, depth = 0;
+
+	if (an->inline_params &&
+	    (depth = param_index(an->inline_params, (lisp_value*) sym)) >= 0) {
+		node = new_node(an, exec_inline_arg, (lisp_list*) sym);
+		node->a = (lisp_value *) sym;
+		node->n = depth;
+		return (lisp_value *) node;
+	}
+
+	depth = 0;
+	bound = find_binding(an->frame, sym, &defined);
+	for (f = an->frame; f; f = f->up) {
+		if (f->opaque)
+			return (lisp_value *) sym;
+		if (f == bound) {
+			if (defined)
+				return (lisp_value *) sym;
+			node = new_node(an, exec_local, (lisp_list*) sym);
+			node->a = (lisp_value *) sym;
+			node->n = depth;
+			return (lisp_value *) node;
+		}
+		if (f->lambda)
+			break;
+		depth++;
+	}
+	if (!f)
+		return (lisp_value *) sym;
+
+	node = new_node(an, exec_global, (lisp_list*) sym);
+	node->a = (lisp_value *) sym;
+	node->n = depth;
+	return (lisp_value *) node;
+}
+
+/*
+ * Wrap the analyzed version of form, whose operator is the builtin op, in a
+ * guard (see exec_guard()). If analysis left the form alone, so does this.
+ */
+static lisp_value *guard(struct analysis *an, lisp_list *form,
+                         lisp_builtin *op, lisp_value *analyzed)
+{
+	lisp_node *node;
+
+	if (analyzed == (lisp_value *) form)
+		return analyzed;
+	node = new_node(an, exec_guard, form);
+	node->a = analyze_symbol(an, (lisp_symbol*) form->left);
+	node->b = analyzed;
+	node->c = (lisp_value *) op;
+	node->n = an->inline_params != NULL;
+	return (lisp_value *) node;
+}
+
+/*
+ * Arguments are analyzed in case the operator turns out to be a lambda or an
+ * evaluated builtin, but the originals are kept for anything else.
+ */
+static lisp_value *analyze_call(struct analysis *an, lisp_list *form,
+                                lisp_value *op)
+{
+	lisp_node *node = new_node(an, exec_call, form);
+	node->a = op;
+	node->b = form->right;
+	node->body = analyze_list(an, (lisp_list*) form->right);
+	node->n = lisp_list_length(node->body);
+	return (lisp_value *) node;
+}
+
+static lisp_value *analyze_quote(struct analysis *an, lisp_list *form)
+{
+	lisp_node *node;
+	lisp_value *value;
+
+	if (lisp_list_length(form) != 2)
+		return (lisp_value*) form;
+
+	value = ((lisp_list*) form->right)->left;
+	if (lisp_is_number(value) || value->type == type_string)
+		return value;
+
+	node = new_node(an, exec_quote, form);
+	node->a = value;
+	return (lisp_value *) node;
+}
+
+/* Code which evaluates to value, without analyzing it */
+static lisp_value *quoted(struct analysis *an, lisp_value *value)
+{
+	lisp_node *node;
+
+	if (lisp_is_number(value) || value->type == type_string)
+		return value;
+	node = new_node(an, exec_quote, (lisp_list*) value);
+	node->a = value;
+	return (lisp_value *) node;
+}
+
+/*
+ * Return code which evaluates a quasiquote template, the same way
+ * lisp_builtin_quasiquote() would. Parts of the template without an unquote
+ * are constant, and shared by every result. Only the lists which contain an
+ * unquote are rebuilt each time.
+ */
+static lisp_value *analyze_template(struct analysis *an, lisp_value *v)
+{
+	lisp_list *list, *items, *tail = NULL;
+	lisp_node *node;
+
+	if (!contains_unquote(v) || v->type != type_list)
+		return quoted(an, v);
+
+	list = (lisp_list *) v;
+	if (is_symbol_named(list->left, "unquote"))
+		return analyze_form(an, v);
+
+	items = (lisp_list *) lisp_nil_new(an->rt);
+	lisp_for_each(list) {
+		lisp_list_append(an->rt, &items, &tail,
+			analyze_template(an, list->left));
+	}
+	node = new_node(an, exec_quasiquote, (lisp_list*) v);
+	node->body = items;
+	return (lisp_value *) node;
+}
+
+static lisp_value *analyze_quasiquote(struct analysis *an, lisp_list *form)
+{
+	lisp_value *template;
+
+	if (lisp_list_length(form) != 2)
+		return (lisp_value*) form;
+
+	template = ((lisp_list*) form->right)->left;
+	if (!template_is_valid(template))
+		return (lisp_value*) form;
+	return analyze_template(an, template);
+}
+
+/* Unquote simply evaluates its argument, wherever it appears */
+static lisp_value *analyze_unquote(struct analysis *an, lisp_list *form)
+{
+	if (lisp_list_length(form) != 2)
+		return (lisp_value*) form;
+	return analyze_form(an, ((lisp_list*) form->right)->left);
+}
+
+static lisp_value *analyze_if(struct analysis *an, lisp_list *form)
+{
+	lisp_list *args = (lisp_list *) form->right;
+	lisp_node *node;
+
+	if (lisp_list_length(args) != 3)
+		return (lisp_value*) form;
+
+	node = new_node(an, exec_if, form);
+	node->a = analyze_form(an, args->left);
+	args = (lisp_list *) args->right;
+	node->b = analyze_form(an, args->left);
+	args = (lisp_list *) args->right;
+	node->c = analyze_form(an, args->left);
+	return (lisp_value *) node;
+}
+
+static lisp_value *analyze_cond(struct analysis *an, lisp_list *form)
+{
+	lisp_list *clauses = (lisp_list *) form->right;
+	lisp_list *analyzed = (lisp_list *) lisp_nil_new(an->rt), *tail = NULL;
+	lisp_node *node;
+
+	if (!cond_is_valid(clauses))
+		return (lisp_value*) form;
+
+	lisp_for_each(clauses) {
+		lisp_list_append(an->rt, &analyzed, &tail, (lisp_value*)
+			analyze_list(an, (lisp_list*) clauses->left));
+	}
+
+	node = new_node(an, exec_cond, form);
+	node->body = analyzed;
+	return (lisp_value *) node;
+}
+
+static int list_contains(lisp_list *list, lisp_value *v)
+{
+	lisp_for_each(list) {
+		if (lisp_compare(list->left, v))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Add each symbol within code which refers to a binding in the enclosing
+ * frames to captured. Returns false if the binding might not be the same
+ * when the closure is called as when it is created (i.e. it is a definition).
+ */
+static int find_captures(struct analysis *an, lisp_value *code,
+                         lisp_list *params, lisp_list **captured,
+                         lisp_list **tail)
+{
+	lisp_list *l;
+	int defined;
+
+	if (code->type == type_symbol) {
+		if (list_contains(params, code) ||
+		    list_contains(*captured, code) ||
+		    !find_binding(an->frame, (lisp_symbol*) code, &defined))
+			return 1;
+		if (defined)
+			return 0;
+		lisp_list_append(an->rt, captured, tail, code);
+		return 1;
+	}
+	if (code->type != type_list)
+		return 1;
+
+	l = (lisp_list *) code;
+	lisp_for_each(l) {
+		if (!find_captures(an, l->left, params, captured, tail))
+			return 0;
+	}
+	if (l->type == type_list)
+		return 1;
+	return find_captures(an, (lisp_value*) l, params, captured, tail);
+}
+
+/*
+ * Return the names a lambda with the given params and body should capture
+ * from the enclosing frames, or NULL if it should capture the entire scope.
+ * Copies of variables which may change would go stale, so any assignment
+ * means capturing the entire scope. So does an opaque body, which the caller
+ * checks along with the lambda's params.
+ */
+static lisp_list *captures(struct analysis *an, lisp_list *params,
+                           lisp_list *body)
+{
+	lisp_list *captured = (lisp_list *) lisp_nil_new(an->rt), *tail = NULL;
+	struct frame *f;
+
+	for (f = an->frame; f; f = f->up)
+		if (f->opaque || f->assigns)
+			return NULL;
+	if (!find_captures(an, (lisp_value*) body, params, &captured, &tail))
+		return NULL;
+	return captured;
+}
+
+static lisp_value *analyze_lambda(struct analysis *an, lisp_list *form,
+                                  lisp_node_exec exec)
+{
+	lisp_list *args = (lisp_list *) form->right;
+	lisp_list *params, *body, *captured;
+	lisp_node *node;
+	struct frame frame;
+
+	if (lisp_list_length(args) < 2 || args->left->type != type_list)
+		return (lisp_value*) form;
+
+	params = (lisp_list *) args->left;
+	body = (lisp_list *) args->right;
+	captured = captures(an, params, body);
+	if (!push_lambda_frame(an, &frame, params, body))
+		return (lisp_value*) form;
+	if (frame.opaque)
+		captured = NULL; /* its body may refer to anything */
+
+	node = new_node(an, exec, form);
+	node->a = (lisp_value *) params;
+	node->b = (lisp_value *) captured;
+	node->c = (lisp_value *) an->scope;
+	node->body = analyze_list(an, body);
+	pop_frame(an);
+	return (lisp_value *) node;
+}
+
+static lisp_value *analyze_let(struct analysis *an, lisp_list *form)
+{
+	lisp_list *args = (lisp_list *) form->right;
+	lisp_list *bindings, *body, *analyzed, *binding, *tail = NULL;
+	lisp_symbol *name = NULL;
+	lisp_node *node;
+	struct frame frame;
+
+	if (lisp_list_length(args) >= 3 && args->left->type == type_symbol) {
+		name = (lisp_symbol *) args->left;
+		args = (lisp_list *) args->right;
+	}
+	if (lisp_list_length(args) < 2 || args->left->type != type_list)
+		return (lisp_value*) form;
+
+	bindings = (lisp_list *) args->left;
+	body = (lisp_list *) args->right;
+	if (name && !lisp_named_let_tail_calls(an->scope, name, body))
+		return (lisp_value*) form;
+	if (!push_let_frame(an, &frame, name, bindings, body))
+		return (lisp_value*) form;
+
+	analyzed = (lisp_list *) lisp_nil_new(an->rt);
+	lisp_for_each(bindings) {
+		binding = (lisp_list *) bindings->left;
+		lisp_list_append(an->rt, &analyzed, &tail, rebuild(an, binding,
+			analyze_list(an, (lisp_list*) binding->right)));
+	}
+
+	if (name) {
+		node = new_node(an, exec_named_let, form);
+		node->a = (lisp_value *) name;
+		node->b = (lisp_value *) analyzed;
+	} else {
+		node = new_node(an, exec_let, form);
+		node->a = (lisp_value *) analyzed;
+	}
+	node->body = analyze_list(an, body);
+	pop_frame(an);
+	return (lisp_value *) node;
+}
+
+static lisp_value *analyze_let_values(struct analysis *an, lisp_list *form)
+{
+	lisp_list *args = (lisp_list *) form->right;
+	lisp_list *bindings, *body, *analyzed, *binding, *tail = NULL;
+	lisp_node *node;
+	struct frame frame;
+
+	if (lisp_list_length(args) < 2 || args->left->type != type_list)
+		return (lisp_value*) form;
+
+	bindings = (lisp_list *) args->left;
+	body = (lisp_list *) args->right;
+	if (!push_let_values_frame(an, &frame, bindings, body))
+		return (lisp_value*) form;
+
+	analyzed = (lisp_list *) lisp_nil_new(an->rt);
+	lisp_for_each(bindings) {
+		binding = (lisp_list *) bindings->left;
+		lisp_list_append(an->rt, &analyzed, &tail, rebuild(an, binding,
+			analyze_list(an, (lisp_list*) binding->right)));
+	}
+
+	node = new_node(an, exec_let_values, form);
+	node->a = (lisp_value *) analyzed;
+	node->body = analyze_list(an, body);
+	pop_frame(an);
+	return (lisp_value *) node;
+}
+
+static lisp_value *analyze_define(struct analysis *an, lisp_list *form)
+{
+	lisp_list *args = (lisp_list *) form->right;
+	lisp_node *node;
+
+	if (lisp_list_length(args) != 2 || args->left->type != type_symbol)
+		return (lisp_value*) form;
+
+	node = new_node(an, exec_define, form);
+	node->a = args->left;
+	node->b = analyze_form(an, ((lisp_list*) args->right)->left);
+	return (lisp_value *) node;
+}
+
+static lisp_value *analyze_progn(struct analysis *an, lisp_list *form)
+{
+	lisp_node *node = new_node(an, exec_progn, form);
+	node->body = analyze_list(an, (lisp_list*) form->right);
+	return (lisp_value *) node;
+}
+
+static lisp_value *analyze_set(struct analysis *an, lisp_list *form)
+{
+	lisp_list *args = (lisp_list *) form->right;
+	lisp_node *node;
+
+	if (lisp_list_length(args) != 2 || args->left->type != type_symbol)
+		return (lisp_value*) form;
+
+	node = new_node(an, exec_set, form);
+	node->a = args->left;
+	node->b = analyze_form(an, ((lisp_list*) args->right)->left);
+	return (lisp_value *) node;
+}
+
+static lisp_value *analyze_while(struct analysis *an, lisp_list *form)
+{
+	lisp_list *args = (lisp_list *) form->right;
+	lisp_node *node;
+
+	if (lisp_list_length(args) < 2)
+		return (lisp_value*) form;
+
+	node = new_node(an, exec_while, form);
+	node->a = analyze_form(an, args->left);
+	node->body = analyze_list(an, (lisp_list*) args->right);
+	return (lisp_value *) node;
+}
+
+/*
+ * dotimes and for-each: the count or list (b) is evaluated outside of the loop
+ * scope, which binds only the variable (a).
+ */
+static lisp_value *analyze_loop(struct analysis *an, lisp_list *form,
+                                lisp_node_exec exec)
+{
+	lisp_list *args = (lisp_list *) form->right, *spec, *body;
+	lisp_node *node;
+	struct frame frame;
+
+	if (lisp_list_length(args) < 2 || args->left->type != type_list)
+		return (lisp_value*) form;
+	spec = (lisp_list *) args->left;
+	body = (lisp_list *) args->right;
+	if (lisp_is_bad_list(spec) || lisp_list_length(spec) != 2 ||
+	    spec->left->type != type_symbol)
+		return (lisp_value*) form;
+
+	node = new_node(an, exec, form);
+	node->a = spec->left;
+	node->b = analyze_form(an, ((lisp_list*) spec->right)->left);
+	push_var_frame(an, &frame, (lisp_symbol*) spec->left, body);
+	frame.assigns = 1; /* each iteration rebinds the variable */
+	node->body = analyze_list(an, body);
+	pop_frame(an);
+	return (lisp_value *) node;
+}
+
+/*
+ * try: the body is everything before the catch clause, which binds its
+ * variable (a) around the handler (b).
+ */
+static lisp_value *analyze_try(struct analysis *an, lisp_list *form)
+{
+	lisp_list *args = (lisp_list *) form->right, *clause, *handler;
+	lisp_list *body, *tail = NULL;
+	lisp_symbol *var;
+	lisp_node *node;
+	struct frame frame;
+
+	clause = lisp_try_catch_clause(args);
+	if (!clause)
+		return (lisp_value*) form;
+	clause = (lisp_list *) clause->right;
+	var = (lisp_symbol *) ((lisp_list *) clause->left)->left;
+	handler = (lisp_list *) clause->right;
+
+	body = (lisp_list *) lisp_nil_new(an->rt);
+	for (; !lisp_nil_p(args->right); args = (lisp_list *) args->right)
+		lisp_list_append(an->rt, &body, &tail,
+		                 analyze_form(an, args->left));
+
+	node = new_node(an, exec_try, form);
+	node->a = (lisp_value *) var;
+	node->body = body;
+	push_var_frame(an, &frame, var, handler);
+	node->b = (lisp_value *) analyze_list(an, handler);
+	pop_frame(an);
+	return (lisp_value *) node;
+}
+
+/*
+ * Calls to some builtins with one or two arguments can be computed directly,
+ * see lisp_builtin_fast_path(). Like a special form, the result is guarded in
+ * case the name is re-bound.
+ */
+static lisp_value *analyze_builtin_call(struct analysis *an, lisp_list *form,
+                                        lisp_builtin *op)
+{
+	lisp_list *args;
+	lisp_node_exec exec;
+	lisp_node *node;
+
+	exec = lisp_builtin_fast_path(op, lisp_list_length(
+		(lisp_list*) form->right));
+	if (!exec)
+		return analyze_call(an, form, analyze_symbol(an,
+			(lisp_symbol*) form->left));
+
+	args = analyze_list(an, (lisp_list*) form->right);
+	node = new_node(an, exec, form);
+	node->a = args->left;
+	if (!lisp_nil_p(args->right))
+		node->b = ((lisp_list*) args->right)->left;
+	node->c = (lisp_value *) op;
+	return guard(an, form, op, (lisp_value *) node);
+}
+
+/*
+ * Return true if code can be inlined into the current frame in place of a call
+ * to self, taking params. Besides constants and params, it may only contain
+ * variables which the caller doesn't bind (so that they refer to the same
+ * thing in the caller as in the lambda), and calls to known lambdas, evaluated
+ * builtins, if, cond, progn and quote. Anything which binds a name, or could
+ * see the unevaluated params, is out.
+ */
+static int inlinable(struct analysis *an, lisp_value *code, lisp_list *params,
+                     lisp_symbol *self, int *size)
+{
+	lisp_list *l, *clause;
+	lisp_builtin *op;
+	lisp_value *v;
+	int defined;
+
+	if (++*size > INLINE_MAX_SIZE)
+		return 0;
+	if (lisp_is_number(code) || code->type == type_string)
+		return 1;
+	if (code->type == type_symbol)
+		return param_index(params, code) >= 0 ||
+			(!is_symbol_named(code, self->s) &&
+			 !is_symbol_named(code, "eval") &&
+			 !find_binding(an->frame, (lisp_symbol*) code, &defined));
+	if (code->type != type_list || lisp_nil_p(code) ||
+	    lisp_is_bad_list((lisp_list*) code))
+		return 0;
+
+	l = (lisp_list *) code;
+	if (param_index(params, l->left) >= 0 ||
+	    !(v = resolve(an, l->left)))
+		return 0;
+	op = (lisp_builtin *) v;
+	if (v->type == type_lambda) {
+		if (((lisp_lambda*)v)->lambda_type != TP_LAMBDA)
+			return 0;
+	} else if (v->type != type_builtin) {
+		return 0;
+	} else if (op->call_v == lisp_builtin_quote) {
+		return 1;
+	} else if (op->call_v == lisp_builtin_cond) {
+		l = (lisp_list *) l->right;
+		lisp_for_each(l) {
+			clause = (lisp_list *) l->left;
+			if (clause->type != type_list || lisp_is_bad_list(clause) ||
+			    lisp_list_length(clause) != 2 ||
+			    !inlinable(an, clause->left, params, self, size) ||
+			    !inlinable(an, ((lisp_list*) clause->right)->left,
+			               params, self, size))
+				return 0;
+		}
+		return 1;
+	} else if (!op->evald && op->call_v != lisp_builtin_if &&
+	           op->call != lisp_builtin_progn) {
+		return 0;
+	}
+
+	lisp_for_each(l) {
+		if (!inlinable(an, l->left, params, self, size))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Inline a call to lambda, when it is small and can't tell the difference.
+ * The operator must be a global variable, so that a cheap check at runtime can
+ * tell whether it is still the same lambda (see exec_inline()). Returns NULL
+ * if the call can't be inlined.
+ */
+static lisp_value *analyze_inline(struct analysis *an, lisp_list *form,
+                                  lisp_lambda *lambda)
+{
+	lisp_list *params = lambda->args, *saved;
+	lisp_value *op, *body;
+	lisp_node *node;
+	struct frame *f;
+	int size = 0;
+
+	if (an->inline_depth >= INLINE_MAX_DEPTH ||
+	    lambda->closure != an->scope || !an->scope->global ||
+	    lisp_list_length(lambda->code) != 1 ||
+	    lisp_list_length(params) != lisp_list_length((lisp_list*) form->right))
+		return NULL;
+	for (f = an->frame; f; f = f->up)
+		if (f->opaque)
+			return NULL;
+
+	/* the lambda's code is already analyzed, so start from the original */
+	body = lambda->code->left;
+	if (body->type == type_node)
+		body = ((lisp_node *) body)->form;
+	if (!inlinable(an, body, params, (lisp_symbol*) form->left, &size))
+		return NULL;
+
+	op = analyze_symbol(an, (lisp_symbol*) form->left);
+	if (op->type != type_node || ((lisp_node*) op)->exec != exec_global)
+		return NULL;
+
+	node = new_node(an, exec_inline, form);
+	node->a = op;
+	node->b = analyze_call(an, form, op);
+	node->c = (lisp_value *) lambda;
+
+	saved = an->inline_params;
+	an->inline_params = params;
+	an->inline_depth++;
+	node->body = lisp_list_new(an->rt, analyze_form(an, body),
+	                           lisp_nil_new(an->rt));
+	an->inline_params = saved;
+	an->inline_depth--;
+	return (lisp_value *) node;
+}
+
+/*
+ * Replace the special forms, variables and calls within form with nodes.
+ * Operators which are known to be macros or builtins that don't evaluate their
+ * arguments are left alone, since they expect to receive plain lists. A call
+ * to an operator we can't know keeps its original arguments in case it turns
+ * out to be one of these.
+ */
+/*
+ * Return the type form always evaluates to, or NULL if we can't tell: that of
+ * a constant, a quoted value, or a call to a builtin which always returns the
+ * same type.
+ */
+static lisp_type *static_type(struct analysis *an, lisp_value *form)
+{
+	lisp_list *list;
+	lisp_builtin *op;
+
+	if (lisp_is_number(form) || form->type == type_string)
+		return form->type;
+	if (form->type != type_list || lisp_nil_p(form) ||
+	    lisp_is_bad_list((lisp_list*) form))
+		return NULL;
+
+	list = (lisp_list *) form;
+	op = resolve_builtin(an, list->left);
+	if (!op)
+		return NULL;
+	if (op->call_v == lisp_builtin_quote)
+		return lisp_list_length(list) == 2 ?
+			((lisp_list*) list->right)->left->type : NULL;
+	return lisp_builtin_returns(op);
+}
+
+/*
+ * When checking is enabled, find calls which would certainly fail: those which
+ * pass the wrong number of arguments to a known lambda, or arguments a known
+ * builtin doesn't accept (see lisp_builtin_check()). The first error is set,
+ * with the line of the call, and analysis fails. Returns true if the call is
+ * to a lambda and passes the right number of arguments.
+ */
+static int check_call(struct analysis *an, lisp_list *form, lisp_value *op)
+{
+	lisp_type *types[CHECK_MAX_ARGS];
+	lisp_list *args = (lisp_list *) form->right;
+	lisp_lambda *lambda = (lisp_lambda *) op;
+	struct frame *f;
+	int argc = lisp_list_length(args), params, i = 0;
+
+	/* an inlined body was checked when its lambda was created */
+	if (!an->rt->check || an->failed || !op || an->inline_params)
+		return 0;
+	for (f = an->frame; f; f = f->up)
+		if (f->opaque)
+			return 0;
+
+	if (op->type == type_lambda && lambda->lambda_type == TP_LAMBDA) {
+		params = lisp_list_length(lambda->args);
+		if (argc == params)
+			return 1;
+		lisp_error(an->rt, argc < params ? LE_2FEW : LE_2MANY,
+		           argc < params ? "not enough arguments to lambda call"
+		                         : "too many arguments to lambda call");
+	} else if (op->type == type_builtin && argc <= CHECK_MAX_ARGS) {
+		lisp_for_each(args)
+			types[i++] = static_type(an, args->left);
+		if (lisp_builtin_check(an->rt, (lisp_builtin *) op, argc, types))
+			return 0;
+	} else {
+		return 0;
+	}
+
+	an->failed = 1;
+	an->rt->error_line = form->line;
+	return 0;
+}
+
+/*
+ * Analyze a special form, whose operator is the builtin op which implements it.
+ */
+static lisp_value *analyze_syntax(struct analysis *an, lisp_list *list,
+                                  lisp_builtin *op)
+{
+	if (op->call_v == lisp_builtin_quote)
+		return analyze_quote(an, list);
+	else if (op->call_v == lisp_builtin_quasiquote)
+		return analyze_quasiquote(an, list);
+	else if (op->call_v == lisp_builtin_unquote)
+		return analyze_unquote(an, list);
+	else if (op->call_v == lisp_builtin_if)
+		return analyze_if(an, list);
+	else if (op->call_v == lisp_builtin_cond)
+		return analyze_cond(an, list);
+	else if (op->call == lisp_builtin_lambda)
+		return analyze_lambda(an, list, exec_lambda);
+	else if (op->call == lisp_builtin_macro)
+		return analyze_lambda(an, list, exec_macro);
+	else if (op->call == lisp_builtin_let)
+		return analyze_let(an, list);
+	else if (op->call == lisp_builtin_let_values)
+		return analyze_let_values(an, list);
+	else if (op->call_v == lisp_builtin_define)
+		return analyze_define(an, list);
+	else if (op->call == lisp_builtin_progn)
+		return analyze_progn(an, list);
+	else if (op->call_v == lisp_builtin_set)
+		return analyze_set(an, list);
+	else if (op->call == lisp_builtin_while)
+		return analyze_while(an, list);
+	else if (op->call == lisp_builtin_dotimes)
+		return analyze_loop(an, list, exec_dotimes);
+	else if (op->call == lisp_builtin_for_each)
+		return analyze_loop(an, list, exec_for_each);
+	else if (op->call == lisp_builtin_try)
+		return analyze_try(an, list);
+	return (lisp_value *) list; /* some other syntax we don't understand */
+}
+
+static lisp_value *analyze_form(struct analysis *an, lisp_value *form)
+{
+	lisp_list *list;
+	lisp_builtin *op;
+	lisp_value *v, *inlined;
+	lisp_node *node;
+	int verified;
+
+	if (form->type == type_symbol)
+		return analyze_symbol(an, (lisp_symbol*) form);
+	if (form->type != type_list || lisp_nil_p(form) ||
+	    lisp_is_bad_list((lisp_list*) form))
+		return form;
+
+	list = (lisp_list *) form;
+	if (list->left->type == type_list)
+		return analyze_call(an, list, analyze_form(an, list->left));
+	if (list->left->type != type_symbol)
+		return form;
+
+	v = resolve(an, list->left);
+	verified = check_call(an, list, v);
+	if (v && v->type == type_lambda &&
+	    ((lisp_lambda*)v)->lambda_type == TP_LAMBDA &&
+	    (inlined = analyze_inline(an, list, (lisp_lambda*) v)))
+		return inlined;
+	if (!v || (v->type == type_lambda &&
+	           ((lisp_lambda*)v)->lambda_type == TP_LAMBDA)) {
+		node = (lisp_node *) analyze_call(an, list, analyze_symbol(an,
+			(lisp_symbol*) list->left));
+		if (verified) {
+			node->exec = exec_call_verified;
+			node->c = v;
+		}
+		return (lisp_value *) node;
+	}
+	if (v->type != type_builtin)
+		return form;
+
+	op = (lisp_builtin *) v;
+	if (op->evald)
+		return analyze_builtin_call(an, list, op);
+	return guard(an, list, op, analyze_syntax(an, list, op));
+}
+
+enum lisp_node_kind lisp_node_kind(lisp_node *node)
+{
+	if (node->exec == exec_quote)
+		return NODE_QUOTE;
+	else if (node->exec == exec_if)
+		return NODE_IF;
+	else if (node->exec == exec_cond)
+		return NODE_COND;
+	else if (node->exec == exec_progn)
+		return NODE_PROGN;
+	else if (node->exec == exec_local)
+		return NODE_LOCAL;
+	else if (node->exec == exec_global)
+		return NODE_GLOBAL;
+	else if (node->exec == exec_guard)
+		return NODE_GUARD;
+	else if (node->exec == exec_call || node->exec == exec_call_generic ||
+	         node->exec == exec_call_lambda ||
+	         node->exec == exec_call_builtin ||
+	         node->exec == exec_call_verified)
+		return NODE_CALL;
+	return NODE_OTHER;
+}
+
+lisp_list *lisp_analyze(lisp_runtime *rt, lisp_scope *scope, lisp_list *params,
+                        lisp_list *code)
+{
+	struct analysis an;
+	struct frame frame;
+
+	if (!rt->fold && !rt->analyze && !rt->check)
+		return code;
+
+	an.rt = rt;
+	an.scope = scope;
+	an.frame = NULL;
+	an.inline_params = NULL;
+	an.inline_depth = 0;
+	an.failed = 0;
+	push_lambda_frame(&an, &frame, params, code);
+
+	if (rt->fold)
+		code = fold_list(&an, code);
+	/* Calls are checked as they are analyzed, so without analysis the
+	 * walk still runs for its errors, and its result is thrown away. */
+	if (rt->analyze)
+		code = analyze_list(&an, code);
+	else if (rt->check)
+		analyze_list(&an, code);
+
+	pop_frame(&an);
+	return an.failed ? NULL : code;
+}
+
+void lisp_enable_folding(lisp_runtime *rt)
+{
+	rt->fold = 1;
+}
+
+void lisp_disable_folding(lisp_runtime *rt)
+{
+	rt->fold = 0;
+}
+
+void lisp_get_quicken_stats(lisp_runtime *rt,
+                            struct lisp_quicken_stats *stats)
+{
+	*stats = rt->quicken;
+}
+
+void lisp_enable_checking(lisp_runtime *rt)
+{
+	rt->check = 1;
+}
+
+void lisp_disable_checking(lisp_runtime *rt)
+{
+	rt->check = 0;
+}
+
+void lisp_enable_analysis(lisp_runtime *rt)
+{
+	rt->analyze = 1;
+}
+
+void lisp_disable_analysis(lisp_runtime *rt)
+{
+	rt->analyze = 0;
+}
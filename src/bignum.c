@@ -0,0 +1,472 @@
+/*
+ * bignum.c: integers which don't fit in a long
+ *
+ * Integers are usually a lisp_integer. When arithmetic on them would overflow,
+ * the builtins call the functions here instead, which work on the magnitude of
+ * each operand as an array of limbs (see struct lisp_bignum). Results which fit
+ * in a long are always returned as a lisp_integer, so that the common case
+ * stays fast and each number has only one representation.
+ *
+ * Addition, subtraction and comparison take linear time. Multiplication and
+ * division are the schoolbook algorithms, division being Knuth's Algorithm D
+ * (The Art of Computer Programming, Vol. 2, 4.3.1).
+ *
+ * Stephen Brennan <stephen@brennan.io>
+ */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "funlisp_internal.h"
+
+/* Limbs needed to hold the magnitude of any long */
+#define LONG_LIMBS ((sizeof(long) * CHAR_BIT + LISP_LIMB_BITS - 1) / \
+                    LISP_LIMB_BITS)
+
+/* The largest power of ten which fits in a limb, for converting to decimal */
+#if LISP_LIMB_BITS == 32
+#define DECIMAL_DIGITS 9
+#define DECIMAL_BASE 1000000000UL
+#else
+#define DECIMAL_DIGITS 4
+#define DECIMAL_BASE 10000UL
+#endif
+
+/*
+ * The sign and magnitude of an operand. For a lisp_integer, the magnitude is
+ * kept in buf; for a bignum, limbs points at its own.
+ */
+struct num {
+	int negative;
+	int len;
+	lisp_limb *limbs;
+	lisp_limb buf[LONG_LIMBS];
+};
+
+static void num_of(struct num *n, lisp_value *v)
+{
+	unsigned long mag;
+	long x;
+
+	if (v->type == type_bignum) {
+		n->negative = ((lisp_bignum *) v)->negative;
+		n->len = ((lisp_bignum *) v)->len;
+		n->limbs = ((lisp_bignum *) v)->limbs;
+		return;
+	}
+
+	x = ((lisp_integer *) v)->x;
+	n->negative = x < 0;
+	/* negating as unsigned works for LONG_MIN too */
+	mag = x < 0 ? 0UL - (unsigned long) x : (unsigned long) x;
+	n->limbs = n->buf;
+	for (n->len = 0; mag; n->len++) {
+		n->buf[n->len] = (lisp_limb) mag;
+		mag >>= LISP_LIMB_BITS;
+	}
+}
+
+/*
+ * Return the number with the given sign and magnitude, which has len limbs
+ * (some of the most significant may be zero). The limbs must be allocated with
+ * malloc(), and are either kept by the bignum or freed.
+ */
+static lisp_value *result(lisp_runtime *rt, int negative, lisp_limb *limbs,
+                          int len)
+{
+	lisp_bignum *bignum;
+	unsigned long mag = 0;
+	int i;
+
+	while (len > 0 && limbs[len - 1] == 0)
+		len--;
+
+	if (len <= (int) LONG_LIMBS) {
+		for (i = len - 1; i >= 0; i--)
+			mag = (mag << LISP_LIMB_BITS) | limbs[i];
+		if (mag <= (unsigned long) LONG_MAX) {
+			free(limbs);
+			return (lisp_value *) lisp_integer_new(
+				rt, negative ? - (long) mag : (long) mag);
+		} else if (negative && mag == (unsigned long) LONG_MAX + 1) {
+			free(limbs);
+			return (lisp_value *) lisp_integer_new(rt, LONG_MIN);
+		}
+	}
+
+	bignum = (lisp_bignum *) lisp_new(rt, type_bignum);
+	bignum->negative = (char) negative;
+	bignum->len = len;
+	bignum->limbs = limbs;
+	return (lisp_value *) bignum;
+}
+
+static lisp_limb *alloc_limbs(int len)
+{
+	/* there is always at least one, so that malloc(0) never happens */
+	return calloc(len + 1, sizeof(lisp_limb));
+}
+
+static int mag_cmp(struct num *a, struct num *b)
+{
+	int i;
+
+	if (a->len != b->len)
+		return a->len < b->len ? -1 : 1;
+	for (i = a->len - 1; i >= 0; i--)
+		if (a->limbs[i] != b->limbs[i])
+			return a->limbs[i] < b->limbs[i] ? -1 : 1;
+	return 0;
+}
+
+/* |a| + |b|, setting len to the length of the result */
+static lisp_limb *mag_add(struct num *a, struct num *b, int *len)
+{
+	struct num *t;
+	lisp_limb *r;
+	lisp_dlimb carry = 0;
+	int i;
+
+	if (a->len < b->len) {
+		t = a;
+		a = b;
+		b = t;
+	}
+
+	r = alloc_limbs(a->len + 1);
+	for (i = 0; i < a->len; i++) {
+		carry += a->limbs[i];
+		if (i < b->len)
+			carry += b->limbs[i];
+		r[i] = (lisp_limb) carry;
+		carry >>= LISP_LIMB_BITS;
+	}
+	r[i] = (lisp_limb) carry;
+	*len = a->len + 1;
+	return r;
+}
+
+/* |a| - |b|, where |a| >= |b| */
+static lisp_limb *mag_sub(struct num *a, struct num *b, int *len)
+{
+	lisp_limb *r;
+	lisp_dlimb borrow = 0, d;
+	int i;
+
+	r = alloc_limbs(a->len);
+	for (i = 0; i < a->len; i++) {
+		d = (lisp_dlimb) a->limbs[i] - borrow;
+		if (i < b->len)
+			d -= b->limbs[i];
+		r[i] = (lisp_limb) d;
+		/* the subtraction wrapped around if any high bits are set */
+		borrow = (d >> LISP_LIMB_BITS) ? 1 : 0;
+	}
+	*len = a->len;
+	return r;
+}
+
+static lisp_value *add(lisp_runtime *rt, lisp_value *lhs, lisp_value *rhs,
+                       int subtract)
+{
+	struct num a, b;
+	lisp_limb *r;
+	int len, b_negative;
+
+	num_of(&a, lhs);
+	num_of(&b, rhs);
+	b_negative = b.negative ^ subtract;
+
+	if (a.negative == b_negative) {
+		r = mag_add(&a, &b, &len);
+		return result(rt, a.negative, r, len);
+	} else if (mag_cmp(&a, &b) >= 0) {
+		r = mag_sub(&a, &b, &len);
+		return result(rt, a.negative, r, len);
+	} else {
+		r = mag_sub(&b, &a, &len);
+		return result(rt, b_negative, r, len);
+	}
+}
+
+lisp_value *lisp_bignum_add(lisp_runtime *rt, lisp_value *lhs, lisp_value *rhs)
+{
+	return add(rt, lhs, rhs, 0);
+}
+
+lisp_value *lisp_bignum_sub(lisp_runtime *rt, lisp_value *lhs, lisp_value *rhs)
+{
+	return add(rt, lhs, rhs, 1);
+}
+
+lisp_value *lisp_bignum_neg(lisp_runtime *rt, lisp_value *v)
+{
+	struct num a;
+	lisp_limb *r;
+
+	num_of(&a, v);
+	r = alloc_limbs(a.len);
+	memcpy(r, a.limbs, a.len * sizeof(lisp_limb));
+	return result(rt, !a.negative, r, a.len);
+}
+
+lisp_value *lisp_bignum_mul(lisp_runtime *rt, lisp_value *lhs, lisp_value *rhs)
+{
+	struct num a, b;
+	lisp_limb *r;
+	lisp_dlimb carry;
+	int i, j;
+
+	num_of(&a, lhs);
+	num_of(&b, rhs);
+
+	r = alloc_limbs(a.len + b.len);
+	for (i = 0; i < a.len; i++) {
+		carry = 0;
+		for (j = 0; j < b.len; j++) {
+			/* at most (B-1)^2 + 2(B-1), which fits */
+			carry += (lisp_dlimb) a.limbs[i] * b.limbs[j] + r[i + j];
+			r[i + j] = (lisp_limb) carry;
+			carry >>= LISP_LIMB_BITS;
+		}
+		r[i + b.len] = (lisp_limb) carry;
+	}
+	return result(rt, a.negative != b.negative, r, a.len + b.len);
+}
+
+/*
+ * Divide the len limbs of u by d, storing the quotient in q (which may be u),
+ * and returning the remainder.
+ */
+static lisp_limb div_small(lisp_limb *q, lisp_limb *u, int len, lisp_limb d)
+{
+	lisp_dlimb rem = 0;
+	int i;
+
+	for (i = len - 1; i >= 0; i--) {
+		rem = (rem << LISP_LIMB_BITS) | u[i];
+		q[i] = (lisp_limb) (rem / d);
+		rem %= d;
+	}
+	return (lisp_limb) rem;
+}
+
+/* Shift the len limbs of u left by s bits into r, which has len + 1 limbs */
+static void shift_left(lisp_limb *r, lisp_limb *u, int len, int s)
+{
+	lisp_dlimb carry = 0, t;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		t = ((lisp_dlimb) u[i] << s) | carry;
+		r[i] = (lisp_limb) t;
+		carry = t >> LISP_LIMB_BITS;
+	}
+	r[len] = (lisp_limb) carry;
+}
+
+/*
+ * Knuth's Algorithm D: the quotient of |a| / |b|, where b has at least two
+ * limbs and |a| >= |b|. Both are shifted left so that the top bit of b is set,
+ * which makes each estimated quotient limb at most two too large.
+ */
+static lisp_limb *mag_div(struct num *a, struct num *b, int *len)
+{
+	const lisp_dlimb base = (lisp_dlimb) 1 << LISP_LIMB_BITS;
+	lisp_limb *q, *un, *vn;
+	lisp_dlimb qhat, rhat, p, t, carry, borrow;
+	int n = b->len, m = a->len - b->len, s = 0, i, j;
+
+	while (!((b->limbs[n - 1] << s) &
+	         ((lisp_dlimb) 1 << (LISP_LIMB_BITS - 1))))
+		s++;
+	vn = alloc_limbs(n + 1);
+	un = alloc_limbs(a->len + 1);
+	shift_left(vn, b->limbs, n, s);
+	shift_left(un, a->limbs, a->len, s);
+	q = alloc_limbs(m + 1);
+
+	for (j = m; j >= 0; j--) {
+		t = ((lisp_dlimb) un[j + n] << LISP_LIMB_BITS) | un[j + n - 1];
+		qhat = t / vn[n - 1];
+		rhat = t % vn[n - 1];
+		while (qhat >= base || qhat * vn[n - 2] >
+		       ((rhat << LISP_LIMB_BITS) | un[j + n - 2])) {
+			qhat--;
+			rhat += vn[n - 1];
+			if (rhat >= base)
+				break;
+		}
+
+		/* un[j..j+n] -= qhat * vn */
+		carry = borrow = 0;
+		for (i = 0; i < n; i++) {
+			p = qhat * vn[i] + carry;
+			carry = p >> LISP_LIMB_BITS;
+			t = (lisp_dlimb) un[i + j] - (lisp_limb) p - borrow;
+			un[i + j] = (lisp_limb) t;
+			borrow = (t >> LISP_LIMB_BITS) ? 1 : 0;
+		}
+		t = (lisp_dlimb) un[j + n] - carry - borrow;
+		un[j + n] = (lisp_limb) t;
+		q[j] = (lisp_limb) qhat;
+
+		/* qhat was one too large (rarely), so add vn back */
+		if (t >> LISP_LIMB_BITS) {
+			q[j]--;
+			carry = 0;
+			for (i = 0; i < n; i++) {
+				t = (lisp_dlimb) un[i + j] + vn[i] + carry;
+				un[i + j] = (lisp_limb) t;
+				carry = t >> LISP_LIMB_BITS;
+			}
+			un[j + n] = (lisp_limb) (un[j + n] + carry);
+		}
+	}
+
+	free(un);
+	free(vn);
+	*len = m + 1;
+	return q;
+}
+
+lisp_value *lisp_bignum_div(lisp_runtime *rt, lisp_value *lhs, lisp_value *rhs)
+{
+	struct num a, b;
+	lisp_limb *q;
+	int len;
+
+	num_of(&a, lhs);
+	num_of(&b, rhs);
+
+	if (mag_cmp(&a, &b) < 0)
+		return (lisp_value *) lisp_integer_new(rt, 0);
+
+	if (b.len == 1) {
+		q = alloc_limbs(a.len);
+		div_small(q, a.limbs, a.len, b.limbs[0]);
+		len = a.len;
+	} else {
+		q = mag_div(&a, &b, &len);
+	}
+	return result(rt, a.negative != b.negative, q, len);
+}
+
+int lisp_bignum_cmp(lisp_value *lhs, lisp_value *rhs)
+{
+	struct num a, b;
+	int c;
+
+	num_of(&a, lhs);
+	num_of(&b, rhs);
+	if (a.negative != b.negative)
+		return a.negative ? -1 : 1;
+	c = mag_cmp(&a, &b);
+	return a.negative ? -c : c;
+}
+
+double lisp_bignum_to_double(lisp_value *v)
+{
+	struct num a;
+	double x = 0;
+	int i;
+
+	num_of(&a, v);
+	for (i = a.len - 1; i >= 0; i--)
+		x = x * (double) ((lisp_dlimb) 1 << LISP_LIMB_BITS) + a.limbs[i];
+	return a.negative ? -x : x;
+}
+
+lisp_value *lisp_bignum_parse(lisp_runtime *rt, char *digits, int len,
+                              int negative)
+{
+	unsigned long mag = 0, d;
+	lisp_limb *r;
+	lisp_dlimb chunk, scale, carry;
+	int i, j, k, n;
+
+	/* most literals fit in a long, so try that first */
+	for (i = 0; i < len; i++) {
+		d = digits[i] - '0';
+		if (mag > ((unsigned long) LONG_MAX - d) / 10)
+			break;
+		mag = mag * 10 + d;
+	}
+	if (i == len)
+		return (lisp_value *) lisp_integer_new(
+			rt, negative ? - (long) mag : (long) mag);
+
+	/* each digit is less than 4 bits */
+	r = alloc_limbs(len * 4 / LISP_LIMB_BITS + 1);
+	n = 0;
+	for (i = 0; i < len; i += k) {
+		chunk = 0;
+		scale = 1;
+		for (k = 0; k < DECIMAL_DIGITS && i + k < len; k++) {
+			chunk = chunk * 10 + (digits[i + k] - '0');
+			scale *= 10;
+		}
+		/* r = r * scale + chunk */
+		carry = chunk;
+		for (j = 0; j < n; j++) {
+			carry += (lisp_dlimb) r[j] * scale;
+			r[j] = (lisp_limb) carry;
+			carry >>= LISP_LIMB_BITS;
+		}
+		if (carry)
+			r[n++] = (lisp_limb) carry;
+	}
+	return result(rt, negative, r, n);
+}
+
+lisp_value *lisp_integer_from_string(lisp_runtime *rt, char *s)
+{
+	int negative = 0, len = 0;
+
+	if (*s == '-') {
+		negative = 1;
+		s++;
+	}
+	while (isdigit((unsigned char) s[len]))
+		len++;
+	return lisp_bignum_parse(rt, s, len, negative);
+}
+
+void lisp_bignum_format(struct charbuf *cb, lisp_bignum *bignum)
+{
+	lisp_limb *u, *chunks;
+	int len = bignum->len, n = 0;
+	char buf[32];
+
+	/* each limb holds fewer than LISP_LIMB_BITS / 3 decimal digits */
+	u = alloc_limbs(len);
+	memcpy(u, bignum->limbs, len * sizeof(lisp_limb));
+	chunks = alloc_limbs(len * LISP_LIMB_BITS / 3 / DECIMAL_DIGITS + 1);
+	while (len > 0) {
+		chunks[n++] = div_small(u, u, len, (lisp_limb) DECIMAL_BASE);
+		while (len > 0 && u[len - 1] == 0)
+			len--;
+	}
+
+	if (bignum->negative)
+		cb_append(cb, '-');
+	sprintf(buf, "%lu", (unsigned long) chunks[--n]);
+	cb_concat(cb, buf);
+	while (n > 0) {
+		sprintf(buf, "%0*lu", DECIMAL_DIGITS, (unsigned long) chunks[--n]);
+		cb_concat(cb, buf);
+	}
+	free(chunks);
+	free(u);
+}
+
+void lisp_bignum_print(FILE *f, lisp_bignum *bignum)
+{
+	struct charbuf cb;
+
+	cb_init(&cb, 32);
+	lisp_bignum_format(&cb, bignum);
+	fputs(cb.buf, f);
+	cb_destroy(&cb);
+}
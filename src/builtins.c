@@ -11,22 +11,26 @@
 #include "funlisp_internal.h"
 
 static lisp_value *lisp_builtin_eval(lisp_runtime *rt, lisp_scope *scope,
-                                     lisp_list *arguments, void *user)
+                                     int argc, lisp_value **argv, void *user)
 {
 	/* args are evaluated */
+	lisp_value *code;
 	(void) user; /* unused */
-	return lisp_eval(rt, scope, arguments->left);
+
+	if (!lisp_get_args_v(rt, argc, argv, "*", &code))
+		return NULL;
+	return lisp_eval(rt, scope, code);
 }
 
 static lisp_value *lisp_builtin_car(lisp_runtime *rt, lisp_scope *scope,
-                                    lisp_list *arglist, void *user)
+                                    int argc, lisp_value **argv, void *user)
 {
 	/* args are evaluated */
 	lisp_list *firstarg;
 	(void) user; /* unused */
 	(void) scope;
 
-	if (!lisp_get_args(rt, arglist, "l", &firstarg)) {
+	if (!lisp_get_args_v(rt, argc, argv, "l", &firstarg)) {
 		return NULL;
 	}
 	if (lisp_nil_p((lisp_value*) firstarg)) {
@@ -36,14 +40,14 @@ static lisp_value *lisp_builtin_car(lisp_runtime *rt, lisp_scope *scope,
 }
 
 static lisp_value *lisp_builtin_cdr(lisp_runtime *rt, lisp_scope *scope,
-                                    lisp_list *arglist, void *user)
+                                    int argc, lisp_value **argv, void *user)
 {
 	/* args are evaluated */
 	lisp_list *firstarg;
 	(void) user; /* unused */
 	(void) scope;
 
-	if (!lisp_get_args(rt, arglist, "l", &firstarg)) {
+	if (!lisp_get_args_v(rt, argc, argv, "l", &firstarg)) {
 		return NULL;
 	}
 	if (lisp_nil_p((lisp_value*) firstarg)) {
@@ -52,22 +56,22 @@ static lisp_value *lisp_builtin_cdr(lisp_runtime *rt, lisp_scope *scope,
 	return firstarg->right;
 }
 
-static lisp_value *lisp_builtin_quote(lisp_runtime *rt, lisp_scope *scope,
-                                      lisp_list *arglist, void *user)
+lisp_value *lisp_builtin_quote(lisp_runtime *rt, lisp_scope *scope,
+                               int argc, lisp_value **argv, void *user)
 {
 	/* args NOT evaluated */
 	lisp_value *firstarg;
 	(void) user; /* unused */
 	(void) scope;
 
-	if (!lisp_get_args(rt, arglist, "*", &firstarg)) {
+	if (!lisp_get_args_v(rt, argc, argv, "*", &firstarg)) {
 		return NULL;
 	}
-	return arglist->left;
+	return firstarg;
 }
 
 static lisp_value *lisp_builtin_cons(lisp_runtime *rt, lisp_scope *scope,
-                                     lisp_list *arglist, void *user)
+                                     int argc, lisp_value **argv, void *user)
 {
 	/* args are evaluated */
 	lisp_value *a1, *l;
@@ -75,7 +79,7 @@ static lisp_value *lisp_builtin_cons(lisp_runtime *rt, lisp_scope *scope,
 	(void) user; /* unused */
 	(void) scope;
 
-	if (!lisp_get_args(rt, arglist, "**", &a1, &l)) {
+	if (!lisp_get_args_v(rt, argc, argv, "**", &a1, &l)) {
 		return NULL;
 	}
 	new = (lisp_list*)lisp_new(rt, type_list);
@@ -84,8 +88,8 @@ static lisp_value *lisp_builtin_cons(lisp_runtime *rt, lisp_scope *scope,
 	return (lisp_value*)new;
 }
 
-static lisp_value *lisp_builtin_lambda(lisp_runtime *rt, lisp_scope *scope,
-                                       lisp_list *arguments, void *user)
+lisp_value *lisp_builtin_lambda(lisp_runtime *rt, lisp_scope *scope,
+                                lisp_list *arguments, void *user)
 {
 	/* args NOT evaluated */
 	lisp_list *argnames, *code, *it;
@@ -104,6 +108,9 @@ static lisp_value *lisp_builtin_lambda(lisp_runtime *rt, lisp_scope *scope,
 		}
 	}
 
+	code = lisp_analyze(rt, scope, argnames, code);
+	lisp_error_check(code);
+
 	lambda = (lisp_lambda*)lisp_new(rt, type_lambda);
 	lambda->args = argnames;
 	lambda->code = code;
@@ -112,8 +119,8 @@ static lisp_value *lisp_builtin_lambda(lisp_runtime *rt, lisp_scope *scope,
 	return (lisp_value*) lambda;
 }
 
-static lisp_value *lisp_builtin_macro(lisp_runtime *rt, lisp_scope *scope,
-                                       lisp_list *arguments, void *user)
+lisp_value *lisp_builtin_macro(lisp_runtime *rt, lisp_scope *scope,
+                                lisp_list *arguments, void *user)
 {
 	/* args NOT evaluated */
 	lisp_list *argnames, *code, *it;
@@ -132,6 +139,9 @@ static lisp_value *lisp_builtin_macro(lisp_runtime *rt, lisp_scope *scope,
 		}
 	}
 
+	code = lisp_analyze(rt, scope, argnames, code);
+	lisp_error_check(code);
+
 	lambda = (lisp_lambda*)lisp_new(rt, type_lambda);
 	lambda->args = argnames;
 	lambda->code = code;
@@ -140,15 +150,15 @@ static lisp_value *lisp_builtin_macro(lisp_runtime *rt, lisp_scope *scope,
 	return (lisp_value*) lambda;
 }
 
-static lisp_value *lisp_builtin_define(lisp_runtime *rt, lisp_scope *scope,
-                                       lisp_list *a, void *user)
+lisp_value *lisp_builtin_define(lisp_runtime *rt, lisp_scope *scope,
+                                int argc, lisp_value **argv, void *user)
 {
 	/* args NOT evaluated */
 	lisp_symbol *s;
 	lisp_value *expr;
 	(void) user; /* unused */
 
-	if (!lisp_get_args(rt, a, "s*", &s, &expr)) {
+	if (!lisp_get_args_v(rt, argc, argv, "s*", &s, &expr)) {
 		return NULL;
 	}
 
@@ -158,118 +168,209 @@ static lisp_value *lisp_builtin_define(lisp_runtime *rt, lisp_scope *scope,
 	return expr;
 }
 
-static lisp_value *lisp_builtin_plus(lisp_runtime *rt, lisp_scope *scope,
-                                     lisp_list *args, void *user)
+/*
+ * Arithmetic on longs which returns true when the result overflows, rather than
+ * wrapping around, so that it can be computed with bignums instead.
+ */
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+#define add_overflow(a, b, r) __builtin_add_overflow(a, b, r)
+#define sub_overflow(a, b, r) __builtin_sub_overflow(a, b, r)
+#define mul_overflow(a, b, r) __builtin_mul_overflow(a, b, r)
+#else
+static int add_overflow(long a, long b, long *r)
 {
-	/* args are evaluated */
-	lisp_integer *i;
-	int sum = 0;
-	(void) user; /* unused */
-	(void) scope;
+	if ((b > 0 && a > LONG_MAX - b) || (b < 0 && a < LONG_MIN - b))
+		return 1;
+	*r = a + b;
+	return 0;
+}
+
+static int sub_overflow(long a, long b, long *r)
+{
+	if ((b < 0 && a > LONG_MAX + b) || (b > 0 && a < LONG_MIN + b))
+		return 1;
+	*r = a - b;
+	return 0;
+}
+
+static int mul_overflow(long a, long b, long *r)
+{
+	if (a > 0 ? (b > 0 ? a > LONG_MAX / b : b < LONG_MIN / a)
+	          : (b > 0 ? a < LONG_MIN / b : a != 0 && b < LONG_MAX / a))
+		return 1;
+	*r = a * b;
+	return 0;
+}
+#endif
+
+enum arith_op { ARITH_ADD, ARITH_SUB, ARITH_MUL, ARITH_DIV };
+
+/*
+ * Compute l op r into x. Returns false if the result doesn't fit in a long, or
+ * for division by zero.
+ */
+static int fixnum_arith(enum arith_op op, long l, long r, long *x)
+{
+	switch (op) {
+	case ARITH_ADD:
+		return !add_overflow(l, r, x);
+	case ARITH_SUB:
+		return !sub_overflow(l, r, x);
+	case ARITH_MUL:
+		return !mul_overflow(l, r, x);
+	default:
+		/* LONG_MIN / -1 is the only quotient which overflows */
+		if (r == 0 || (r == -1 && l == LONG_MIN))
+			return 0;
+		*x = l / r;
+		return 1;
+	}
+}
+
+/* The value of a number of any kind as a double */
+static double to_double(lisp_value *v)
+{
+	if (v->type == type_float)
+		return ((lisp_float*)v)->x;
+	else if (v->type == type_integer)
+		return (double) ((lisp_integer*)v)->x;
+	return lisp_bignum_to_double(v);
+}
+
+static lisp_value *float_arith(lisp_runtime *rt, enum arith_op op, double l,
+                               double r)
+{
+	switch (op) {
+	case ARITH_ADD:
+		return (lisp_value*) lisp_float_new(rt, l + r);
+	case ARITH_SUB:
+		return (lisp_value*) lisp_float_new(rt, l - r);
+	case ARITH_MUL:
+		return (lisp_value*) lisp_float_new(rt, l * r);
+	default:
+		if (r == 0)
+			return lisp_error(rt, LE_VALUE, "divide by zero");
+		return (lisp_value*) lisp_float_new(rt, l / r);
+	}
+}
+
+/*
+ * Compute lhs op rhs for numbers of any kind. Two fixnums are combined
+ * directly, unless the result would overflow, in which case the bignum
+ * functions compute it. If either is a float, so is the result.
+ */
+static lisp_value *arith(lisp_runtime *rt, enum arith_op op, lisp_value *lhs,
+                         lisp_value *rhs)
+{
+	long x;
+
+	if (lhs->type == type_integer && rhs->type == type_integer &&
+	    fixnum_arith(op, ((lisp_integer*)lhs)->x, ((lisp_integer*)rhs)->x, &x))
+		return (lisp_value*) lisp_integer_new(rt, x);
+	if (lhs->type == type_float || rhs->type == type_float)
+		return float_arith(rt, op, to_double(lhs), to_double(rhs));
+
+	switch (op) {
+	case ARITH_ADD:
+		return lisp_bignum_add(rt, lhs, rhs);
+	case ARITH_SUB:
+		return lisp_bignum_sub(rt, lhs, rhs);
+	case ARITH_MUL:
+		return lisp_bignum_mul(rt, lhs, rhs);
+	default:
+		if (rhs->type == type_integer && ((lisp_integer*)rhs)->x == 0)
+			return lisp_error(rt, LE_VALUE, "divide by zero");
+		return lisp_bignum_div(rt, lhs, rhs);
+	}
+}
 
-	lisp_for_each(args) {
-		if (args->left->type != type_integer) {
-			return lisp_error(rt, LE_TYPE, "expect integers for addition");
+/*
+ * Combine acc (or value, if it isn't NULL) with each argument in turn. The
+ * running result is kept in a long for as long as it fits, so that usually only
+ * the result is allocated.
+ */
+static lisp_value *arith_args(lisp_runtime *rt, enum arith_op op, long acc,
+                              lisp_value *value, int argc, lisp_value **argv,
+                              char *message)
+{
+	long x;
+	int n;
+
+	for (n = 0; n < argc; n++) {
+		if (!lisp_is_number(argv[n]))
+			return lisp_error(rt, LE_TYPE, message);
+		if (!value && argv[n]->type == type_integer &&
+		    fixnum_arith(op, acc, ((lisp_integer*)argv[n])->x, &x)) {
+			acc = x;
+			continue;
 		}
-		i = (lisp_integer*) args->left;
-		sum += i->x;
+		if (!value)
+			value = (lisp_value*) lisp_integer_new(rt, acc);
+		value = arith(rt, op, value, argv[n]);
+		lisp_error_check(value);
 	}
 
-	i = (lisp_integer*)lisp_new(rt, type_integer);
-	i->x = sum;
-	return (lisp_value*)i;
+	return value ? value : (lisp_value*) lisp_integer_new(rt, acc);
 }
 
-static lisp_value *lisp_builtin_minus(lisp_runtime *rt, lisp_scope *scope,
-                                      lisp_list *args, void *user)
+/* The same, starting with the first argument */
+static lisp_value *arith_first(lisp_runtime *rt, enum arith_op op, int argc,
+                               lisp_value **argv, char *message)
+{
+	if (argc < 1)
+		return lisp_error(rt, LE_2FEW, "expected at least one arg");
+	if (!lisp_is_number(argv[0]))
+		return lisp_error(rt, LE_TYPE, message);
+	if (argv[0]->type != type_integer)
+		return arith_args(rt, op, 0, argv[0], argc - 1, argv + 1,
+		                  message);
+	return arith_args(rt, op, ((lisp_integer*)argv[0])->x, NULL, argc - 1,
+	                  argv + 1, message);
+}
+
+static lisp_value *lisp_builtin_plus(lisp_runtime *rt, lisp_scope *scope,
+                                     int argc, lisp_value **argv, void *user)
 {
 	/* args are evaluated */
-	lisp_integer *i;
-	int val = 0, len;
 	(void) user; /* unused */
 	(void) scope;
 
-	len = lisp_list_length(args);
+	return arith_args(rt, ARITH_ADD, 0, NULL, argc, argv,
+	                  "expect integers for addition");
+}
 
-	if (len < 1) {
-		return lisp_error(rt, LE_2FEW, "expected at least one arg");
-	} else if (len == 1) {
-		i = (lisp_integer*) args->left;
-		val = - i->x;
-	} else {
-		if (args->left->type != type_integer) {
-			return lisp_error(rt, LE_TYPE, "expected integer");
-		}
-		i = (lisp_integer*) args->left;
-		val = i->x;
-		args = (lisp_list*)args->right;
-		lisp_for_each(args) {
-			if (args->left->type != type_integer) {
-				return lisp_error(rt, LE_TYPE, "expected integer");
-			}
-			i = (lisp_integer*) args->left;
-			val -= i->x;
-		}
-	}
+static lisp_value *lisp_builtin_minus(lisp_runtime *rt, lisp_scope *scope,
+                                      int argc, lisp_value **argv, void *user)
+{
+	/* args are evaluated */
+	(void) user; /* unused */
+	(void) scope;
 
-	i = (lisp_integer*)lisp_new(rt, type_integer);
-	i->x = val;
-	return (lisp_value*)i;
+	if (argc == 1)
+		return arith_args(rt, ARITH_SUB, 0, NULL, argc, argv,
+		                  "expected integer");
+	return arith_first(rt, ARITH_SUB, argc, argv, "expected integer");
 }
 
 static lisp_value *lisp_builtin_multiply(lisp_runtime *rt, lisp_scope *scope,
-                                         lisp_list *args, void *user)
+                                         int argc, lisp_value **argv, void *user)
 {
 	/* args are evaluated */
-	lisp_integer *i;
-	int product = 1;
 	(void) user; /* unused */
 	(void) scope;
 
-	lisp_for_each(args) {
-		if (args->left->type != type_integer) {
-			return lisp_error(rt, LE_TYPE, "expect integers for multiplication");
-		}
-		i = (lisp_integer*) args->left;
-		product *= i->x;
-	}
-
-	i = (lisp_integer*)lisp_new(rt, type_integer);
-	i->x = product;
-	return (lisp_value*)i;
+	return arith_args(rt, ARITH_MUL, 1, NULL, argc, argv,
+	                  "expect integers for multiplication");
 }
 
 static lisp_value *lisp_builtin_divide(lisp_runtime *rt, lisp_scope *scope,
-                                       lisp_list *args, void *user)
+                                       int argc, lisp_value **argv, void *user)
 {
 	/* args are evaluated */
-	lisp_integer *i;
-	int val = 0, len;
 	(void) user; /* unused */
 	(void) scope;
 
-	len = lisp_list_length(args);
-
-	if (len < 1) {
-		return lisp_error(rt, LE_2FEW, "expected at least one arg");
-	}
-	i = (lisp_integer*) args->left;
-	val = i->x;
-	args = (lisp_list*)args->right;
-	lisp_for_each(args) {
-		if (args->left->type != type_integer) {
-			return lisp_error(rt, LE_TYPE, "expected integer");
-		}
-		i = (lisp_integer*) args->left;
-		if (i->x == 0) {
-			return lisp_error(rt, LE_VALUE, "divide by zero");
-		}
-		val /= i->x;
-	}
-
-	i = (lisp_integer*)lisp_new(rt, type_integer);
-	i->x = val;
-	return (lisp_value*)i;
+	return arith_first(rt, ARITH_DIV, argc, argv, "expected integer");
 }
 
 #define CMP_EQ (void*) 1
@@ -279,43 +380,76 @@ static lisp_value *lisp_builtin_divide(lisp_runtime *rt, lisp_scope *scope,
 #define CMP_GT (void*) 5
 #define CMP_GE (void*) 6
 
+/* A comparison which is false for every op but CMP_NE, i.e. with NaN */
+#define UNORDERED 2
+
+/*
+ * Compare numbers of any kind, returning -1, 0, 1 or UNORDERED. Floats are
+ * compared with anything else as doubles.
+ */
+static int compare_numbers(lisp_value *lhs, lisp_value *rhs)
+{
+	long l, r;
+	double fl, fr;
+
+	if (lhs->type == type_integer && rhs->type == type_integer) {
+		l = ((lisp_integer*)lhs)->x;
+		r = ((lisp_integer*)rhs)->x;
+		return l < r ? -1 : l > r;
+	} else if (lhs->type == type_float || rhs->type == type_float) {
+		fl = to_double(lhs);
+		fr = to_double(rhs);
+		if (fl < fr)
+			return -1;
+		else if (fl > fr)
+			return 1;
+		return fl == fr ? 0 : UNORDERED;
+	}
+	return lisp_bignum_cmp(lhs, rhs);
+}
+
+static int compare_result(void *op, int c)
+{
+	if (op == CMP_EQ)
+		return c == 0;
+	else if (op == CMP_NE)
+		return c != 0;
+	else if (op == CMP_LT)
+		return c == -1;
+	else if (op == CMP_LE)
+		return c == -1 || c == 0;
+	else if (op == CMP_GT)
+		return c == 1;
+	else
+		return c == 1 || c == 0;
+}
+
 static lisp_value *lisp_builtin_cmp(lisp_runtime *rt, lisp_scope *scope,
-                                    lisp_list *args, void *op)
+                                    int argc, lisp_value **argv, void *op)
 {
 	/* args are evaluated */
-	lisp_integer *first, *second, *result;
+	lisp_value *first, *second;
 	(void) scope; /* unused */
 
-	if (!lisp_get_args(rt, args, "dd", &first, &second)) {
+	if (!lisp_get_args_v(rt, argc, argv, "**", &first, &second)) {
 		return NULL;
 	}
+	if (!lisp_is_number(first) || !lisp_is_number(second))
+		return lisp_error(rt, LE_TYPE, "incorrect argument type");
 
-	result = (lisp_integer*)lisp_new(rt, type_integer);
-	if (op == CMP_EQ) {
-		result->x = first->x == second->x;
-	} else if (op == CMP_NE) {
-		result->x = first->x != second->x;
-	} else if (op == CMP_LT) {
-		result->x = first->x < second->x;
-	} else if (op == CMP_LE) {
-		result->x = first->x <= second->x;
-	} else if (op == CMP_GT) {
-		result->x = first->x > second->x;
-	} else {
-		result->x = first->x >= second->x;
-	}
-
-	return (lisp_value*)result;
+	return lisp_boolean(rt, compare_result(op,
+	                                       compare_numbers(first, second)));
 }
 
-static lisp_value *lisp_builtin_if(lisp_runtime *rt, lisp_scope *scope,
-                                   lisp_list *a, void *user)
+lisp_value *lisp_builtin_if(lisp_runtime *rt, lisp_scope *scope,
+                            int argc, lisp_value **argv, void *user)
 {
 	/* args NOT evaluated */
 	lisp_value *condition, *body_true, *body_false;
 	(void) user; /* unused */
 
-	if (!lisp_get_args(rt, a, "***", &condition, &body_true, &body_false)) {
+	if (!lisp_get_args_v(rt, argc, argv, "***", &condition, &body_true,
+	                     &body_false)) {
 		return NULL;
 	}
 
@@ -329,7 +463,7 @@ static lisp_value *lisp_builtin_if(lisp_runtime *rt, lisp_scope *scope,
 }
 
 static lisp_value *lisp_builtin_null_p(lisp_runtime *rt, lisp_scope *scope,
-                                       lisp_list *args, void *user)
+                                       int argc, lisp_value **argv, void *user)
 {
 	/* args are evaluated */
 	lisp_integer *result;
@@ -337,7 +471,7 @@ static lisp_value *lisp_builtin_null_p(lisp_runtime *rt, lisp_scope *scope,
 	(void) user; /* unused */
 	(void) scope;
 
-	if (!lisp_get_args(rt, args, "*", &v)) {
+	if (!lisp_get_args_v(rt, argc, argv, "*", &v)) {
 		return NULL;
 	}
 
@@ -346,150 +480,162 @@ static lisp_value *lisp_builtin_null_p(lisp_runtime *rt, lisp_scope *scope,
 	return (lisp_value*)result;
 }
 
-static lisp_list *get_quoted_left_items(lisp_runtime *rt, lisp_list *list_of_lists)
-{
-	lisp_list *left_items = NULL, *rv, *l;
-
-	lisp_for_each(list_of_lists) {
-		/* Create or advance left_items to the next list. */
-		if (left_items == NULL) {
-			left_items = (lisp_list*) lisp_new(rt, type_list);
-			rv = left_items;
-		} else {
-			left_items->right = lisp_new(rt, type_list);
-			left_items = (lisp_list*) left_items->right;
-		}
-		/* Termination condition: one of the lists of args ends */
-		if (lisp_nil_p(list_of_lists->left)) {
-			return NULL;
-		}
-		/* Get the next node in the list and get the argument. */
-		l = (lisp_list*) list_of_lists->left;
-		left_items->left = (lisp_value*) lisp_quote(rt, l->left);
-	}
-	left_items->right = lisp_nil_new(rt);
-	return rv;
-}
-
-static lisp_list *advance_lists(lisp_runtime *rt, lisp_list *list_of_lists)
+/*
+ * The number of items in a list or vector argument to map or reduce, or -1 if
+ * it is neither.
+ */
+static int sequence_length(lisp_value *v)
 {
-	lisp_list *right_items = NULL, *rv, *l;
-
-	lisp_for_each(list_of_lists) {
-		/* Create or advance left_items to the next list. */
-		if (right_items == NULL) {
-			right_items = (lisp_list*) lisp_new(rt, type_list);
-			rv = right_items;
-		} else {
-			right_items->right = lisp_new(rt, type_list);
-			right_items = (lisp_list*) right_items->right;
-		}
-
-		/* Get the next node in the list and get the argument. */
-		l = (lisp_list*) list_of_lists->left;
-		right_items->left = l->right;
+	lisp_list *l = (lisp_list*) v;
+	int n = 0;
+
+	if (v->type == type_vector)
+		return ((lisp_vector*) v)->len;
+	if (v->type != type_list)
+		return -1;
+	lisp_for_each(l) {
+		n++;
 	}
-	right_items->right = lisp_nil_new(rt);
-	return rv;
+	return l->type == type_list ? n : -1;
 }
 
 static lisp_value *lisp_builtin_map(lisp_runtime *rt, lisp_scope *scope,
-                                    lisp_list *map_args, void *user)
+                                    int argc, lisp_value **argv, void *user)
 {
 	/* args are evaluated */
-	lisp_value *f;
-	lisp_list *ret = NULL, *rv, *args;
+	lisp_list *rv, *tail = NULL, *l;
+	lisp_vector *vec = NULL;
+	lisp_value **args, *result;
+	int i, n, len = -1;
 	(void) user; /* unused */
 
-	/* Get the function from the first argument in the list. */
-	f = map_args->left;
-	if (lisp_nil_p(map_args->right)) {
+	if (argc < 2) {
 		return lisp_error(rt, LE_2FEW, "need at least two arguments");
 	}
-	map_args = (lisp_list*) map_args->right;
 
-	/* Make sure the arguments are well-behaved lists */
-	if (lisp_is_bad_list_of_lists(map_args)) {
-		return lisp_error(rt, LE_VALUE,
-			"arguments after callable must be lists");
-	}
-	while ((args = get_quoted_left_items(rt, map_args)) != NULL) {
-		if (ret == NULL) {
-			ret = (lisp_list*) lisp_new(rt, type_list);
-			rv = ret;
-		} else {
-			ret->right = lisp_new(rt, type_list);
-			ret = (lisp_list*) ret->right;
+	/* Make sure the arguments are well-behaved lists or vectors, and stop
+	 * at the end of the shortest */
+	for (i = 1; i < argc; i++) {
+		n = sequence_length(argv[i]);
+		if (n < 0) {
+			return lisp_error(rt, LE_VALUE,
+				"arguments after callable must be lists or vectors");
 		}
-		ret->left = lisp_call(rt, scope, f, args);
-		lisp_error_check(ret->left);
-		map_args = advance_lists(rt, map_args);
+		if (len < 0 || n < len)
+			len = n;
 	}
-	ret->right = lisp_nil_new(rt);
-	return (lisp_value*) rv;
-}
 
-static lisp_list *lisp_new_pair_list(lisp_runtime *rt, lisp_value *one, lisp_value *two)
-{
-	lisp_list *first_node = (lisp_list*) lisp_new(rt, type_list);
-	lisp_list *second_node = (lisp_list*) lisp_new(rt, type_list);
-	first_node->left = one;
-	first_node->right = (lisp_value*) second_node;
-	second_node->left = two;
-	second_node->right = lisp_nil_new(rt);
-	return first_node;
+	/* Each list in argv is advanced as we go, and vectors are indexed. The
+	 * items are passed to the callable without quoting them again. The
+	 * result is a vector when the first argument is. */
+	rv = (lisp_list*) lisp_nil_new(rt);
+	if (argv[1]->type == type_vector)
+		vec = lisp_vector_new(rt, len, (lisp_value*) rv);
+	args = lisp_vstack_push(rt, argc - 1);
+	for (n = 0; n < len; n++) {
+		for (i = 1; i < argc; i++) {
+			if (argv[i]->type == type_vector) {
+				args[i - 1] = ((lisp_vector*) argv[i])->items[n];
+			} else {
+				l = (lisp_list*) argv[i];
+				args[i - 1] = l->left;
+				argv[i] = l->right;
+			}
+		}
+		result = lisp_call_v(rt, scope, argv[0], argc - 1, args);
+		if (!result) {
+			lisp_vstack_pop(rt, argc - 1);
+			return NULL;
+		}
+		if (vec)
+			vec->items[n] = result;
+		else
+			lisp_list_append(rt, &rv, &tail, result);
+	}
+	lisp_vstack_pop(rt, argc - 1);
+	return vec ? (lisp_value*) vec : (lisp_value*) rv;
 }
 
 static lisp_value *lisp_builtin_reduce(lisp_runtime *rt, lisp_scope *scope,
-                                       lisp_list *args, void *user)
+                                       int argc, lisp_value **argv, void *user)
 {
 	/* args are evaluated */
-	lisp_list *list;
-	lisp_value *callable, *initializer;
-	int length;
+	lisp_list *list = NULL;
+	lisp_vector *vec = NULL;
+	lisp_value *callable, *initializer, *seq, **pair;
+	int len, i = 0;
 	(void) user; /* unused */
 
-	length = lisp_list_length(args);
-
-	if (length == 2) {
-		if (!lisp_get_args(rt, args, "*l", &callable, &list)) {
+	if (argc == 2) {
+		if (!lisp_get_args_v(rt, argc, argv, "**", &callable, &seq)) {
 			return NULL;
 		}
-		if (lisp_list_length(list) < 2) {
-			return lisp_error(rt, LE_VALUE, "reduce: list must have at least 2 entries");
-		}
-		initializer = list->left;
-		list = (lisp_list*)list->right;
-	} else if (length == 3) {
-		if (!lisp_get_args(rt, args, "**l", &callable, &initializer, &list)) {
+	} else if (argc == 3) {
+		if (!lisp_get_args_v(rt, argc, argv, "***", &callable, &initializer, &seq)) {
 			return NULL;
 		}
-		if (lisp_list_length(list) < 1) {
-			return lisp_error(rt, LE_VALUE, "reduce: list must have at least 1 entry");
-		}
-	} else if (length <= 2) {
+	} else if (argc <= 2) {
 		return lisp_error(rt, LE_2FEW, "reduce: 2 or 3 arguments required");
 	} else {
 		return lisp_error(rt, LE_2MANY, "reduce: 2 or 3 arguments required");
 	}
 
-	lisp_for_each(list) {
-		initializer = lisp_call(rt, scope, callable,
-			lisp_new_pair_list(rt, initializer, list->left));
-		lisp_error_check(initializer);
+	if (seq->type == type_vector) {
+		vec = (lisp_vector*) seq;
+		len = vec->len;
+	} else if (seq->type == type_list) {
+		list = (lisp_list*) seq;
+		len = lisp_list_length(list);
+	} else {
+		return lisp_error(rt, LE_TYPE, "reduce: expected a list or vector");
+	}
+
+	if (argc == 2) {
+		if (len < 2) {
+			return lisp_error(rt, LE_VALUE, "reduce: list must have at least 2 entries");
+		}
+		if (vec) {
+			initializer = vec->items[i++];
+		} else {
+			initializer = list->left;
+			list = (lisp_list*)list->right;
+		}
+	} else if (len < 1) {
+		return lisp_error(rt, LE_VALUE, "reduce: list must have at least 1 entry");
+	}
+
+	pair = lisp_vstack_push(rt, 2);
+	if (vec) {
+		for (; i < len; i++) {
+			pair[0] = initializer;
+			pair[1] = vec->items[i];
+			initializer = lisp_call_v(rt, scope, callable, 2, pair);
+			if (!initializer)
+				break;
+		}
+	} else {
+		lisp_for_each(list) {
+			pair[0] = initializer;
+			pair[1] = list->left;
+			initializer = lisp_call_v(rt, scope, callable, 2, pair);
+			if (!initializer)
+				break;
+		}
 	}
+	lisp_vstack_pop(rt, 2);
 	return initializer;
 }
 
 static lisp_value *lisp_builtin_print(lisp_runtime *rt, lisp_scope *scope,
-                                      lisp_list *args, void *user)
+                                      int argc, lisp_value **argv, void *user)
 {
 	/* args are evaluated */
+	int i;
 	(void) user; /* unused */
 	(void) scope;
 
-	lisp_for_each(args) {
-		lisp_print(stdout, args->left);
+	for (i = 0; i < argc; i++) {
+		lisp_print(stdout, argv[i]);
 	}
 
 	printf("\n");
@@ -497,33 +643,35 @@ static lisp_value *lisp_builtin_print(lisp_runtime *rt, lisp_scope *scope,
 }
 
 static lisp_value *lisp_builtin_dump_stack(lisp_runtime *rt, lisp_scope *scope,
-                                           lisp_list *a, void *user)
+                                           int argc, lisp_value **argv,
+                                           void *user)
 {
 	/* args are evaluated (but unused) */
 	(void) scope; /* unused args */
-	(void) a;
+	(void) argc;
+	(void) argv;
 	(void) user;
 	lisp_dump_stack(rt, NULL, stderr);
 	return lisp_nil_new(rt);
 }
 
-static lisp_value *lisp_builtin_progn(lisp_runtime *rt, lisp_scope *scope,
-                                      lisp_list *a, void *user)
+lisp_value *lisp_builtin_progn(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_list *a, void *user)
 {
 	/* args NOT evaluated */
 	(void) user; /* unused */
 	return lisp_progn(rt, scope, a);
 }
 
-static lisp_value *lisp_builtin_unquote(lisp_runtime *rt, lisp_scope *scope,
-                                        lisp_list *arglist, void *user)
+lisp_value *lisp_builtin_unquote(lisp_runtime *rt, lisp_scope *scope,
+                                 int argc, lisp_value **argv, void *user)
 {
 	/* args NOT evaluated */
 	lisp_value *firstarg;
 	(void) user; /* unused */
 	(void) scope;
 
-	if (!lisp_get_args(rt, arglist, "*", &firstarg)) {
+	if (!lisp_get_args_v(rt, argc, argv, "*", &firstarg)) {
 		return NULL;
 	}
 	return lisp_eval(rt, scope, firstarg);
@@ -551,29 +699,29 @@ static lisp_value *lisp_quasiquote(lisp_runtime *rt, lisp_scope *scope,
 	return (lisp_value*) lisp_map(rt, scope, NULL, lisp_quasiquote, vl);
 }
 
-static lisp_value *lisp_builtin_quasiquote(lisp_runtime *rt, lisp_scope *scope,
-                                           lisp_list *arglist, void *user)
+lisp_value *lisp_builtin_quasiquote(lisp_runtime *rt, lisp_scope *scope,
+                                    int argc, lisp_value **argv, void *user)
 {
 	/* args NOT evaluated */
 	lisp_value *firstarg;
 	(void) user; /* unused */
 	(void) scope;
 
-	if (!lisp_get_args(rt, arglist, "*", &firstarg)) {
+	if (!lisp_get_args_v(rt, argc, argv, "*", &firstarg)) {
 		return NULL;
 	}
 	return lisp_quasiquote(rt, scope, NULL, firstarg);
 }
 
 static lisp_value *lisp_builtin_eq(lisp_runtime *rt, lisp_scope *scope,
-                                   lisp_list *arglist, void *user)
+                                   int argc, lisp_value **argv, void *user)
 {
 	/* args are evaluated */
 	lisp_value *lhs, *rhs;
 	(void) user;
 	(void) scope;
 
-	if (!lisp_get_args(rt, arglist, "**", &lhs, &rhs)) {
+	if (!lisp_get_args_v(rt, argc, argv, "**", &lhs, &rhs)) {
 		return NULL;
 	}
 
@@ -581,14 +729,14 @@ static lisp_value *lisp_builtin_eq(lisp_runtime *rt, lisp_scope *scope,
 }
 
 static lisp_value *lisp_builtin_equal(lisp_runtime *rt, lisp_scope *scope,
-                                      lisp_list *arglist, void *user)
+                                      int argc, lisp_value **argv, void *user)
 {
 	/* args are evaluated */
 	lisp_value *lhs, *rhs;
 	(void) user;
 	(void) scope;
 
-	if (!lisp_get_args(rt, arglist, "**", &lhs, &rhs)) {
+	if (!lisp_get_args_v(rt, argc, argv, "**", &lhs, &rhs)) {
 		return NULL;
 	}
 
@@ -596,14 +744,14 @@ static lisp_value *lisp_builtin_equal(lisp_runtime *rt, lisp_scope *scope,
 }
 
 static lisp_value *lisp_builtin_assert(lisp_runtime *rt, lisp_scope *scope,
-                                       lisp_list *arglist, void *user)
+                                       int argc, lisp_value **argv, void *user)
 {
 	/* args are evaluated */
 	lisp_integer *expr;
 	(void) user;
 	(void) scope;
 
-	if (!lisp_get_args(rt, arglist, "d", &expr))
+	if (!lisp_get_args_v(rt, argc, argv, "d", &expr))
 		return NULL;
 
 	if (expr->x == 0)
@@ -613,7 +761,7 @@ static lisp_value *lisp_builtin_assert(lisp_runtime *rt, lisp_scope *scope,
 }
 
 static lisp_value *lisp_builtin_assert_error(
-		lisp_runtime *rt, lisp_scope *scope, lisp_list *arglist,
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
 		void *user)
 {
 	/* args are NOT evaluated, to avoid error handling short circuit */
@@ -622,7 +770,7 @@ static lisp_value *lisp_builtin_assert_error(
 	enum lisp_errno err_num;
 	(void) user;
 
-	if (!lisp_get_args(rt, arglist, "**", &sym, &expr))
+	if (!lisp_get_args_v(rt, argc, argv, "**", &sym, &expr))
 		return NULL;
 
 	sym_evald = (lisp_symbol*) lisp_eval(rt, scope, sym);
@@ -636,6 +784,10 @@ static lisp_value *lisp_builtin_assert_error(
 	lisp_eval(rt, scope, expr); /* we don't care, cause we expect error */
 	/* NO ERROR CHECK HERE */
 
+	/* an escape continuation is not an error, let it reach its call/ec */
+	if (lisp_get_errno(rt) == LE_ESCAPE)
+		return NULL;
+
 	if (err_num == lisp_get_errno(rt)) {
 		lisp_clear_error(rt);
 		return (lisp_value*) sym_evald;
@@ -656,21 +808,23 @@ static lisp_value *lisp_builtin_assert_error(
  *   [(TEST2 VALUE2) ...]
  * )
  */
-static lisp_value *lisp_builtin_cond(
-		lisp_runtime *rt, lisp_scope *scope, lisp_list *arglist, void *user)
+lisp_value *lisp_builtin_cond(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
 {
 	/* args NOT evaluated */
 	lisp_list *clause, *node;
 	lisp_value *expr, *value;
+	int i;
 	(void) user; /* unused */
 
-	if (lisp_nil_p((lisp_value*)arglist))
+	if (argc == 0)
 		return lisp_error(rt, LE_SYNTAX, "bad syntax for cond");
 
-	lisp_for_each(arglist) {
-		if (arglist->left->type != type_list)
+	for (i = 0; i < argc; i++) {
+		if (argv[i]->type != type_list)
 			return lisp_error(rt, LE_SYNTAX, "bad syntax for cond");
-		clause = (lisp_list*) arglist->left;
+		clause = (lisp_list*) argv[i];
 
 		if (lisp_is_bad_list(clause) || lisp_list_length(clause) != 2)
 			return lisp_error(rt, LE_SYNTAX, "bad syntax for cond");
@@ -689,134 +843,1636 @@ static lisp_value *lisp_builtin_cond(
 }
 
 static lisp_value *lisp_builtin_list(
-		lisp_runtime *rt, lisp_scope *scope, lisp_list *arglist, void *user)
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
 {
 	/* args are evaluated */
-	(void) rt;
+	lisp_list *rv = (lisp_list*) lisp_nil_new(rt);
+	int i;
 	(void) scope;
 	(void) user;
-	return (lisp_value*)arglist;
+
+	for (i = argc - 1; i >= 0; i--)
+		rv = lisp_list_new(rt, argv[i], (lisp_value*) rv);
+	return (lisp_value*) rv;
 }
 
-static lisp_value *lisp_builtin_let(
-		lisp_runtime *rt, lisp_scope *scope, lisp_list *arglist, void *user)
+/*
+ * (make-vector n [fill])
+ * A vector of n items, each of which is fill, or nil.
+ */
+static lisp_value *lisp_builtin_make_vector(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
 {
-	/*
-	 * args are NOT evaluated.
-	 * (let ((symbol binding)
-	 *       (symbol binding) ...)
-	 *   expression ...)
-	 *
-	 * This would be roughly equivalent to letrec* from, say, racket.
-	 */
-	lisp_list *binding_list, *expressions;
-	lisp_list *it;
-	lisp_symbol *sym;
-	lisp_value *binding;
-	lisp_scope *new_scope;
-
+	/* args are evaluated */
+	lisp_integer *n;
+	lisp_value *fill = lisp_nil_new(rt);
+	(void) scope;
 	(void) user;
 
-	if (!lisp_get_args(rt, arglist, "lR", &binding_list, &expressions))
+	if (argc == 2) {
+		if (!lisp_get_args_v(rt, argc, argv, "d*", &n, &fill))
+			return NULL;
+	} else if (!lisp_get_args_v(rt, argc, argv, "d", &n)) {
 		return NULL;
+	}
+	if (n->x < 0 || n->x > INT_MAX / (long) sizeof(lisp_value*))
+		return lisp_error(rt, LE_VALUE, "bad vector length");
+	return (lisp_value*) lisp_vector_new(rt, (int) n->x, fill);
+}
 
-	/*
-	 * It feels dirty to just create a scope and never clean it up, but rest
-	 * assured it will be garbage collected.
-	 */
-	new_scope = lisp_new_empty_scope(rt);
-	new_scope->up = scope;
+static lisp_value *lisp_builtin_vector(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	/* args are evaluated */
+	lisp_vector *vec = lisp_vector_new(rt, argc, NULL);
+	int i;
+	(void) scope;
+	(void) user;
 
-	it = binding_list;
-	lisp_for_each(it) {
-		if (!lisp_is(it->left, type_list))
-			return lisp_error(rt, LE_TYPE, "expected binding list");
-		if (!lisp_get_args(rt, (lisp_list*)it->left, "s*", &sym, &binding))
-			return NULL;
-		binding = lisp_eval(rt, new_scope, binding);
-		if (!binding)
-			return NULL;
-		lisp_scope_bind(new_scope, sym, binding);
+	for (i = 0; i < argc; i++)
+		vec->items[i] = argv[i];
+	return (lisp_value*) vec;
+}
+
+/* Check that index is within vec, for vector-ref and vector-set! */
+static int vector_index(lisp_runtime *rt, lisp_vector *vec, lisp_integer *index)
+{
+	if (index->x < 0 || index->x >= vec->len) {
+		lisp_error(rt, LE_VALUE, "vector index out of range");
+		return 0;
 	}
+	return 1;
+}
 
-	return lisp_progn(rt, new_scope, expressions);
+static lisp_value *lisp_builtin_vector_ref(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	/* args are evaluated */
+	lisp_vector *vec;
+	lisp_integer *index;
+	(void) scope;
+	(void) user;
+
+	if (!lisp_get_args_v(rt, argc, argv, "vd", &vec, &index))
+		return NULL;
+	if (!vector_index(rt, vec, index))
+		return NULL;
+	return vec->items[index->x];
 }
 
-static lisp_value *lisp_builtin_import(
-		lisp_runtime *rt, lisp_scope *scope, lisp_list *arglist, void *user)
+static lisp_value *lisp_builtin_vector_set(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
 {
-	/*
-	 * args are NOT evaluated
-	 * (import symbol)  ->  looks up module "symbol" and inserts it into
-	 * current scope
-	 */
-	lisp_symbol *sym;
-	lisp_module *mod;
+	/* args are evaluated */
+	lisp_vector *vec;
+	lisp_integer *index;
+	lisp_value *item;
+	(void) scope;
+	(void) user;
 
-	(void) user; /* unused */
+	if (!lisp_get_args_v(rt, argc, argv, "vd*", &vec, &index, &item))
+		return NULL;
+	if (!vector_index(rt, vec, index))
+		return NULL;
+	vec->items[index->x] = item;
+	return item;
+}
+
+static lisp_value *lisp_builtin_vector_length(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	/* args are evaluated */
+	lisp_vector *vec;
+	(void) scope;
+	(void) user;
 
-	if (!lisp_get_args(rt, arglist, "s", &sym))
+	if (!lisp_get_args_v(rt, argc, argv, "v", &vec))
 		return NULL;
+	return (lisp_value*) lisp_integer_new(rt, vec->len);
+}
 
-	mod = lisp_do_import(rt, sym);
-	lisp_error_check(mod);
+static lisp_value *lisp_builtin_list_to_vector(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	/* args are evaluated */
+	lisp_list *list;
+	lisp_vector *vec;
+	int i = 0;
+	(void) scope;
+	(void) user;
 
-	lisp_scope_bind(scope, sym, (lisp_value*)mod);
-	return (lisp_value*)mod;
+	if (!lisp_get_args_v(rt, argc, argv, "l", &list))
+		return NULL;
+	if (lisp_is_bad_list(list))
+		return lisp_error(rt, LE_VALUE, "list->vector: not a proper list");
+	vec = lisp_vector_new(rt, lisp_list_length(list), NULL);
+	lisp_for_each(list) {
+		vec->items[i++] = list->left;
+	}
+	return (lisp_value*) vec;
 }
 
-static lisp_value *lisp_builtin_getattr(
-		lisp_runtime *rt, lisp_scope *scope, lisp_list *arglist, void *user)
+static lisp_value *lisp_builtin_vector_to_list(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
 {
-	lisp_module *mod;
-	lisp_symbol *sym;
+	/* args are evaluated */
+	lisp_list *rv = (lisp_list*) lisp_nil_new(rt);
+	lisp_vector *vec;
+	int i;
+	(void) scope;
+	(void) user;
+
+	if (!lisp_get_args_v(rt, argc, argv, "v", &vec))
+		return NULL;
+	for (i = vec->len - 1; i >= 0; i--)
+		rv = lisp_list_new(rt, vec->items[i], (lisp_value*) rv);
+	return (lisp_value*) rv;
+}
 
+static lisp_value *lisp_builtin_make_hash(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	/* args are evaluated */
+	(void) scope;
 	(void) user;
-	(void) scope; /* unused */
 
-	if (!lisp_get_args(rt, arglist, "*s", &mod, &sym))
+	if (!lisp_get_args_v(rt, argc, argv, ""))
 		return NULL;
+	return (lisp_value*) lisp_hashmap_new(rt);
+}
 
-	return lisp_scope_lookup(rt, mod->contents, sym);
+/*
+ * (hash-ref map key [default])
+ * The value of key in map. When key is missing, default is returned if it is
+ * given, and otherwise it's an error.
+ */
+static lisp_value *lisp_builtin_hash_ref(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	/* args are evaluated */
+	lisp_hashmap *map;
+	lisp_value *key, *value, *dflt = NULL;
+	(void) scope;
+	(void) user;
+
+	if (argc == 3) {
+		if (!lisp_get_args_v(rt, argc, argv, "h**", &map, &key, &dflt))
+			return NULL;
+	} else if (!lisp_get_args_v(rt, argc, argv, "h*", &map, &key)) {
+		return NULL;
+	}
+	value = lisp_hashmap_get(map, key);
+	if (value)
+		return value;
+	if (dflt)
+		return dflt;
+	return lisp_error(rt, LE_NOTFOUND, "key not found in hash map");
+}
+
+static lisp_value *lisp_builtin_hash_set(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	/* args are evaluated */
+	lisp_hashmap *map;
+	lisp_value *key, *value;
+	(void) scope;
+	(void) user;
+
+	if (!lisp_get_args_v(rt, argc, argv, "h**", &map, &key, &value))
+		return NULL;
+	lisp_hashmap_set(map, key, value);
+	return value;
+}
+
+static lisp_value *lisp_builtin_hash_remove(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	/* args are evaluated */
+	lisp_hashmap *map;
+	lisp_value *key;
+	(void) scope;
+	(void) user;
+
+	if (!lisp_get_args_v(rt, argc, argv, "h*", &map, &key))
+		return NULL;
+	return lisp_boolean(rt, lisp_hashmap_remove(map, key));
+}
+
+static lisp_value *lisp_builtin_hash_count(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	/* args are evaluated */
+	lisp_hashmap *map;
+	(void) scope;
+	(void) user;
+
+	if (!lisp_get_args_v(rt, argc, argv, "h", &map))
+		return NULL;
+	return (lisp_value*) lisp_integer_new(rt, lisp_hashmap_length(map));
+}
+
+/*
+ * hash-keys, hash-values and hash->list share this, with user selecting what
+ * each item of the result is.
+ */
+#define HASH_KEYS (void*) 1
+#define HASH_VALUES (void*) 2
+#define HASH_PAIRS (void*) 3
+
+static lisp_value *lisp_builtin_hash_items(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	/* args are evaluated */
+	lisp_hashmap *map;
+	lisp_list *rv, *tail = NULL;
+	lisp_value *key, *value;
+	struct iterator keys, values;
+	(void) scope;
+
+	if (!lisp_get_args_v(rt, argc, argv, "h", &map))
+		return NULL;
+
+	/* both iterators visit the entries in the same order */
+	rv = (lisp_list*) lisp_nil_new(rt);
+	keys = ht_iter_keys_ptr(&map->table);
+	values = ht_iter_values_ptr(&map->table);
+	while (keys.has_next(&keys)) {
+		key = keys.next(&keys);
+		value = values.next(&values);
+		if (user == HASH_KEYS)
+			lisp_list_append(rt, &rv, &tail, key);
+		else if (user == HASH_VALUES)
+			lisp_list_append(rt, &rv, &tail, value);
+		else
+			lisp_list_append(rt, &rv, &tail,
+				(lisp_value*) lisp_list_new(rt, key, value));
+	}
+	keys.close(&keys);
+	values.close(&values);
+	return (lisp_value*) rv;
+}
+
+static lisp_value *lisp_builtin_make_string_builder(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	/* args are evaluated */
+	(void) scope;
+	(void) user;
+
+	if (!lisp_get_args_v(rt, argc, argv, ""))
+		return NULL;
+	return lisp_new(rt, type_strbuf);
+}
+
+/*
+ * (string-builder-append! builder item...)
+ * Append the text of each string, rope or symbol, or the digits of each
+ * number, to builder. Returns builder.
+ */
+static lisp_value *lisp_builtin_string_builder_append(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	/* args are evaluated */
+	struct charbuf *cb;
+	lisp_type *type;
+	char buf[LISP_FLOAT_BUFSIZE];
+	int i;
+	(void) scope;
+	(void) user;
+
+	if (argc < 1)
+		return lisp_error(rt, LE_2FEW, "not enough arguments");
+	if (argv[0]->type != type_strbuf)
+		return lisp_error(rt, LE_TYPE, "expected a string builder");
+
+	/* check everything first, so that nothing is appended on error */
+	for (i = 1; i < argc; i++) {
+		type = argv[i]->type;
+		if (type != type_string && type != type_symbol &&
+		    type != type_rope && !lisp_is_number(argv[i]))
+			return lisp_error(rt, LE_TYPE,
+				"can only append strings, symbols and numbers");
+	}
+
+	cb = &((lisp_strbuf*) argv[0])->cb;
+	for (i = 1; i < argc; i++) {
+		type = argv[i]->type;
+		if (type == type_string || type == type_symbol) {
+			cb_concat(cb, ((lisp_string*) argv[i])->s);
+		} else if (type == type_rope) {
+			lisp_rope_flatten(cb, argv[i]);
+		} else if (type == type_integer) {
+			sprintf(buf, "%ld", ((lisp_integer*) argv[i])->x);
+			cb_concat(cb, buf);
+		} else if (type == type_bignum) {
+			lisp_bignum_format(cb, (lisp_bignum*) argv[i]);
+		} else {
+			lisp_float_format(buf, ((lisp_float*) argv[i])->x);
+			cb_concat(cb, buf);
+		}
+	}
+	return argv[0];
+}
+
+static lisp_value *lisp_builtin_string_builder_to_string(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	/* args are evaluated */
+	lisp_strbuf *sb;
+	(void) scope;
+	(void) user;
+
+	if (!lisp_get_args_v(rt, argc, argv, "*", &sb))
+		return NULL;
+	if (sb->type != type_strbuf)
+		return lisp_error(rt, LE_TYPE, "expected a string builder");
+	return (lisp_value*) lisp_string_new(rt, sb->cb.buf, LS_CPY | LS_OWN);
+}
+
+/*
+ * Results of string-append at least this long are ropes, rather than a copy of
+ * their arguments.
+ */
+#define ROPE_MIN 64
+
+static int is_text(lisp_value *v)
+{
+	return v->type == type_string || v->type == type_rope;
+}
+
+static int text_length(lisp_value *v)
+{
+	if (v->type == type_rope)
+		return ((lisp_rope*) v)->length;
+	return strlen(((lisp_string*) v)->s);
+}
+
+static lisp_value *string_concat(lisp_runtime *rt, lisp_value *left,
+                                 lisp_value *right)
+{
+	int llen = text_length(left), rlen = text_length(right);
+	struct charbuf cb;
+	lisp_rope *rope;
+
+	if (rlen == 0)
+		return left;
+	if (llen == 0)
+		return right;
+	if (llen + rlen < ROPE_MIN) {
+		cb_init(&cb, llen + rlen + 1);
+		lisp_rope_flatten(&cb, left);
+		lisp_rope_flatten(&cb, right);
+		return (lisp_value*) lisp_string_new(rt, cb.buf, LS_OWN);
+	}
+	rope = (lisp_rope*) lisp_new(rt, type_rope);
+	rope->left = left;
+	rope->right = right;
+	rope->length = llen + rlen;
+	return (lisp_value*) rope;
+}
+
+/*
+ * (string-append text...)
+ * Concatenate strings and ropes. Short results are strings, and long ones are
+ * ropes, which share their pieces rather than copying them.
+ */
+static lisp_value *lisp_builtin_string_append(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	/* args are evaluated */
+	lisp_value *result;
+	int i;
+	(void) scope;
+	(void) user;
+
+	for (i = 0; i < argc; i++)
+		if (!is_text(argv[i]))
+			return lisp_error(rt, LE_TYPE, "expected strings");
+	if (argc == 0)
+		return (lisp_value*) lisp_string_new(rt, "", 0);
+
+	result = argv[0];
+	for (i = 1; i < argc; i++)
+		result = string_concat(rt, result, argv[i]);
+	return result;
+}
+
+static lisp_value *lisp_builtin_string_length(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	/* args are evaluated */
+	lisp_value *text;
+	(void) scope;
+	(void) user;
+
+	if (!lisp_get_args_v(rt, argc, argv, "*", &text))
+		return NULL;
+	if (!is_text(text))
+		return lisp_error(rt, LE_TYPE, "expected a string");
+	return (lisp_value*) lisp_integer_new(rt, text_length(text));
+}
+
+/* (rope->string text) returns the text of a rope as one string */
+static lisp_value *lisp_builtin_rope_to_string(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	/* args are evaluated */
+	lisp_value *text;
+	struct charbuf cb;
+	(void) scope;
+	(void) user;
+
+	if (!lisp_get_args_v(rt, argc, argv, "*", &text))
+		return NULL;
+	if (!is_text(text))
+		return lisp_error(rt, LE_TYPE, "expected a string or rope");
+	if (text->type == type_string)
+		return text;
+	cb_init(&cb, text_length(text) + 1);
+	lisp_rope_flatten(&cb, text);
+	return (lisp_value*) lisp_string_new(rt, cb.buf, LS_OWN);
+}
+
+lisp_value *lisp_builtin_let(
+		lisp_runtime *rt, lisp_scope *scope, lisp_list *arglist, void *user)
+{
+	/*
+	 * args are NOT evaluated.
+	 * (let ((symbol binding)
+	 *       (symbol binding) ...)
+	 *   expression ...)
+	 *
+	 * This would be roughly equivalent to letrec* from, say, racket.
+	 *
+	 * (let name ((symbol binding) ...)
+	 *   expression ...)
+	 *
+	 * A named let is a loop: within the expressions, (name value ...) rebinds
+	 * each symbol and starts the expressions again. See
+	 * lisp_loop_named_let().
+	 */
+	lisp_list *binding_list, *expressions;
+	lisp_list *it;
+	lisp_symbol *sym;
+	lisp_value *binding;
+	lisp_scope *new_scope;
+
+	(void) user;
+
+	if (arglist->type == type_list && !lisp_nil_p((lisp_value*) arglist) &&
+	    arglist->left->type == type_symbol) {
+		if (!lisp_get_args(rt, arglist, "slR", &sym, &binding_list,
+		                   &expressions))
+			return NULL;
+		if (!lisp_named_let_tail_calls(scope, sym, expressions))
+			return lisp_error(rt, LE_SYNTAX,
+				"named let must be called in tail position");
+		return lisp_loop_named_let(rt, scope, sym, binding_list,
+		                           expressions);
+	}
+
+	if (!lisp_get_args(rt, arglist, "lR", &binding_list, &expressions))
+		return NULL;
+
+	/*
+	 * It feels dirty to just create a scope and never clean it up, but rest
+	 * assured it will be garbage collected.
+	 */
+	new_scope = lisp_new_empty_scope(rt);
+	new_scope->up = scope;
+
+	it = binding_list;
+	lisp_for_each(it) {
+		if (!lisp_is(it->left, type_list))
+			return lisp_error(rt, LE_TYPE, "expected binding list");
+		if (!lisp_get_args(rt, (lisp_list*)it->left, "s*", &sym, &binding))
+			return NULL;
+		binding = lisp_eval(rt, new_scope, binding);
+		if (!binding)
+			return NULL;
+		lisp_scope_bind(new_scope, sym, binding);
+	}
+
+	return lisp_progn(rt, new_scope, expressions);
+}
+
+/*
+ * (set! symbol expression)
+ * Unlike define, this changes an existing binding (wherever it is), rather
+ * than creating one in the current scope.
+ */
+lisp_value *lisp_builtin_set(lisp_runtime *rt, lisp_scope *scope,
+                             int argc, lisp_value **argv, void *user)
+{
+	/* args NOT evaluated */
+	lisp_symbol *sym;
+	lisp_value *value;
+	(void) user; /* unused */
+
+	if (!lisp_get_args_v(rt, argc, argv, "s*", &sym, &value))
+		return NULL;
+
+	value = lisp_eval(rt, scope, value);
+	lisp_error_check(value);
+	return lisp_scope_set(rt, scope, sym, value);
+}
+
+lisp_value *lisp_loop_while(lisp_runtime *rt, lisp_scope *scope,
+                            lisp_value *condition, lisp_list *body)
+{
+	lisp_value *v;
+
+	for (;;) {
+		v = lisp_eval(rt, scope, condition);
+		lisp_error_check(v);
+		if (!lisp_truthy(v))
+			return lisp_nil_new(rt);
+		v = lisp_progn(rt, scope, body);
+		lisp_error_check(v);
+	}
+}
+
+/*
+ * (while condition
+ *   expression ...)
+ * Returns nil.
+ */
+lisp_value *lisp_builtin_while(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_list *arglist, void *user)
+{
+	/* args NOT evaluated */
+	lisp_value *condition;
+	lisp_list *body;
+	(void) user; /* unused */
+
+	if (!lisp_get_args(rt, arglist, "*R", &condition, &body))
+		return NULL;
+	return lisp_loop_while(rt, scope, condition, body);
+}
+
+lisp_value *lisp_loop_dotimes(lisp_runtime *rt, lisp_scope *scope,
+                              lisp_symbol *var, lisp_value *count,
+                              lisp_list *body)
+{
+	lisp_scope *loop;
+	lisp_value *v;
+	long i, n;
+
+	count = lisp_eval(rt, scope, count);
+	lisp_error_check(count);
+	if (count->type != type_integer)
+		return lisp_error(rt, LE_TYPE, "dotimes expects an integer count");
+	n = ((lisp_integer *) count)->x;
+
+	loop = lisp_new_empty_scope(rt);
+	loop->up = scope;
+	for (i = 0; i < n; i++) {
+		lisp_scope_bind(loop, var, (lisp_value *) lisp_integer_new(rt, i));
+		v = lisp_progn(rt, loop, body);
+		lisp_error_check(v);
+	}
+	return lisp_nil_new(rt);
+}
+
+/*
+ * (dotimes (symbol count)
+ *   expression ...)
+ * Binds symbol to 0 through count - 1. Returns nil.
+ */
+lisp_value *lisp_builtin_dotimes(lisp_runtime *rt, lisp_scope *scope,
+                                 lisp_list *arglist, void *user)
+{
+	/* args NOT evaluated */
+	lisp_list *spec, *body;
+	lisp_symbol *var;
+	lisp_value *count;
+	(void) user; /* unused */
+
+	if (!lisp_get_args(rt, arglist, "lR", &spec, &body) ||
+	    !lisp_get_args(rt, spec, "s*", &var, &count))
+		return NULL;
+	return lisp_loop_dotimes(rt, scope, var, count, body);
+}
+
+lisp_value *lisp_loop_for_each(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_symbol *var, lisp_value *list,
+                               lisp_list *body)
+{
+	lisp_scope *loop;
+	lisp_list *it;
+	lisp_value *v;
+
+	list = lisp_eval(rt, scope, list);
+	lisp_error_check(list);
+	if (list->type != type_list || lisp_is_bad_list((lisp_list *) list))
+		return lisp_error(rt, LE_TYPE, "for-each expects a list");
+
+	loop = lisp_new_empty_scope(rt);
+	loop->up = scope;
+	it = (lisp_list *) list;
+	lisp_for_each(it) {
+		lisp_scope_bind(loop, var, it->left);
+		v = lisp_progn(rt, loop, body);
+		lisp_error_check(v);
+	}
+	return lisp_nil_new(rt);
+}
+
+/*
+ * (for-each (symbol list)
+ *   expression ...)
+ * Binds symbol to each item of list in turn. Returns nil.
+ */
+lisp_value *lisp_builtin_for_each(lisp_runtime *rt, lisp_scope *scope,
+                                  lisp_list *arglist, void *user)
+{
+	/* args NOT evaluated */
+	lisp_list *spec, *body;
+	lisp_symbol *var;
+	lisp_value *list;
+	(void) user; /* unused */
+
+	if (!lisp_get_args(rt, arglist, "lR", &spec, &body) ||
+	    !lisp_get_args(rt, spec, "s*", &var, &list))
+		return NULL;
+	return lisp_loop_for_each(rt, scope, var, list, body);
+}
+
+/*
+ * Within a named let, the name is bound to a builtin which refers to this.
+ * Calling it rebinds the loop variables and returns the builtin itself, which
+ * tells the loop to run again. So it only works as the last thing the loop
+ * does (in tail position), possibly from within an inner loop. Anywhere else,
+ * the builtin would be used as a value, so lisp_named_let_tail_calls() rejects
+ * the loop before it starts.
+ */
+struct named_let {
+	lisp_builtin *self;
+	lisp_scope *scope;
+	lisp_list *bindings;
+	int called;
+};
+
+static lisp_value *named_let_again(lisp_runtime *rt, lisp_scope *scope,
+                                   int argc, lisp_value **argv, void *user)
+{
+	struct named_let *loop = user;
+	lisp_list *it;
+	int i = 0;
+	(void) scope; /* unused */
+
+	if (!loop)
+		return lisp_error(rt, LE_ERROR, "named let called after it ended");
+	if (argc < lisp_list_length(loop->bindings))
+		return lisp_error(rt, LE_2FEW, "not enough arguments to named let");
+	if (argc > lisp_list_length(loop->bindings))
+		return lisp_error(rt, LE_2MANY, "too many arguments to named let");
+
+	it = loop->bindings;
+	lisp_for_each(it) {
+		lisp_scope_bind(loop->scope,
+			(lisp_symbol *) ((lisp_list *) it->left)->left, argv[i++]);
+	}
+	loop->called = 1;
+	return (lisp_value *) loop->self;
+}
+
+static int is_name(lisp_value *v, lisp_symbol *name)
+{
+	return v->type == type_symbol &&
+		strcmp(((lisp_symbol*) v)->s, name->s) == 0;
+}
+
+/* Return true if names (a symbol or list of symbols) includes name */
+static int binds_name(lisp_value *names, lisp_symbol *name)
+{
+	lisp_list *l = (lisp_list *) names;
+
+	if (is_name(names, name))
+		return 1;
+	lisp_for_each(l) {
+		if (is_name(l->left, name))
+			return 1;
+	}
+	return 0;
+}
+
+static int tail_calls(lisp_scope *scope, lisp_symbol *name, lisp_value *code,
+                      int tail);
+
+/* Check each expression in list, which are all in tail position or not */
+static int tail_calls_each(lisp_scope *scope, lisp_symbol *name,
+                           lisp_value *list, int tail)
+{
+	lisp_list *l = (lisp_list *) list;
+
+	lisp_for_each(l) {
+		if (!tail_calls(scope, name, l->left, tail))
+			return 0;
+	}
+	return 1;
+}
+
+/* Check a body of expressions, where only the last may be in tail position */
+static int tail_calls_body(lisp_scope *scope, lisp_symbol *name,
+                           lisp_value *body, int tail)
+{
+	lisp_list *l = (lisp_list *) body;
+
+	lisp_for_each(l) {
+		if (!tail_calls(scope, name, l->left,
+		                tail && lisp_nil_p(l->right)))
+			return 0;
+	}
+	return 1;
+}
+
+/* Only the unquoted parts of a quasiquote template are code */
+static int tail_calls_template(lisp_scope *scope, lisp_symbol *name,
+                               lisp_value *template)
+{
+	lisp_list *l = (lisp_list *) template;
+
+	if (template->type != type_list || lisp_nil_p(template))
+		return 1;
+	if (l->left->type == type_symbol &&
+	    strcmp(((lisp_symbol*) l->left)->s, "unquote") == 0)
+		return tail_calls_each(scope, name, l->right, 0);
+	lisp_for_each(l) {
+		if (!tail_calls_template(scope, name, l->left))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Check bindings of a let or loop, each (names value ...), then the body. Once
+ * a binding re-binds name, the rest of the form can't refer to the loop.
+ */
+static int tail_calls_let(lisp_scope *scope, lisp_symbol *name,
+                          lisp_value *bindings, lisp_value *body, int tail)
+{
+	lisp_list *l = (lisp_list *) bindings, *binding;
+
+	lisp_for_each(l) {
+		binding = (lisp_list *) l->left;
+		if (binding->type != type_list || lisp_nil_p(l->left))
+			continue;
+		if (!tail_calls_each(scope, name, binding->right, 0))
+			return 0;
+		if (binds_name(binding->left, name))
+			return 1;
+	}
+	return tail_calls_body(scope, name, body, tail);
+}
+
+/*
+ * Return true if code only refers to the loop called name by calling it in
+ * tail position (when tail is true), which is all that named_let_again()
+ * supports. Special forms are recognized by looking up their names in scope,
+ * as lisp_analyze() does. Anything else, including lambdas and the other
+ * loops, runs its arguments in some other context. Calls to macros are
+ * allowed, since we can't see their expansion.
+ */
+static int tail_calls(lisp_scope *scope, lisp_symbol *name, lisp_value *code,
+                      int tail)
+{
+	lisp_list *l = (lisp_list *) code, *args, *clause;
+	lisp_builtin *op = NULL;
+	lisp_value *v = NULL;
+
+	if (is_name(code, name))
+		return 0; /* the loop would escape as a value */
+	if (code->type != type_list || lisp_nil_p(code))
+		return 1;
+
+	args = (lisp_list *) l->right;
+	if (is_name(l->left, name))
+		return tail &&
+			tail_calls_each(scope, name, (lisp_value*) args, 0);
+	if (l->left->type == type_symbol)
+		v = lisp_scope_find(scope, (lisp_symbol*) l->left);
+	if (v && v->type == type_lambda &&
+	    ((lisp_lambda*) v)->lambda_type == TP_MACRO)
+		return 1;
+	if (v && v->type == type_builtin && !((lisp_builtin*) v)->evald)
+		op = (lisp_builtin *) v;
+	if (!op || args->type != type_list || lisp_nil_p((lisp_value*) args))
+		return tail_calls_each(scope, name, code, 0);
+
+	if (op->call_v == lisp_builtin_quote) {
+		return 1;
+	} else if (op->call_v == lisp_builtin_quasiquote) {
+		return tail_calls_template(scope, name, (lisp_value*) args);
+	} else if (op->call_v == lisp_builtin_if) {
+		return tail_calls(scope, name, args->left, 0) &&
+			tail_calls_each(scope, name, args->right, tail);
+	} else if (op->call_v == lisp_builtin_cond) {
+		lisp_for_each(args) {
+			if (!tail_calls_body(scope, name, args->left, tail))
+				return 0;
+		}
+		return 1;
+	} else if (op->call == lisp_builtin_progn) {
+		return tail_calls_body(scope, name, (lisp_value*) args, tail);
+	} else if (op->call == lisp_builtin_let ||
+	           op->call == lisp_builtin_let_values) {
+		if (op->call == lisp_builtin_let &&
+		    args->left->type == type_symbol) {
+			/* a named let, whose name may shadow ours */
+			if (is_name(args->left, name) ||
+			    args->right->type != type_list ||
+			    lisp_nil_p(args->right))
+				return 1;
+			args = (lisp_list *) args->right;
+		}
+		return tail_calls_let(scope, name, args->left, args->right,
+		                      tail);
+	} else if (op->call == lisp_builtin_lambda ||
+	           op->call == lisp_builtin_macro) {
+		return binds_name(args->left, name) ||
+			tail_calls_each(scope, name, args->right, 0);
+	} else if (op->call == lisp_builtin_dotimes ||
+	           op->call == lisp_builtin_for_each) {
+		clause = (lisp_list *) args->left;
+		if (clause->type != type_list || lisp_nil_p(args->left))
+			return tail_calls_each(scope, name, args->right, 0);
+		return tail_calls_each(scope, name, clause->right, 0) &&
+			(binds_name(clause->left, name) ||
+			 tail_calls_each(scope, name, args->right, 0));
+	} else if (op->call == lisp_builtin_try) {
+		clause = lisp_try_catch_clause(args);
+		lisp_for_each(args) {
+			if (args->left == (lisp_value*) clause)
+				break;
+			if (!tail_calls(scope, name, args->left, 0))
+				return 0;
+		}
+		if (!clause)
+			return 1;
+		clause = (lisp_list *) clause->right;
+		return binds_name(clause->left, name) ||
+			tail_calls_each(scope, name, clause->right, 0);
+	}
+	return tail_calls_each(scope, name, (lisp_value*) args, 0);
+}
+
+int lisp_named_let_tail_calls(lisp_scope *scope, lisp_symbol *name,
+                              lisp_list *body)
+{
+	return tail_calls_body(scope, name, (lisp_value*) body, 1);
+}
+
+lisp_value *lisp_loop_named_let(lisp_runtime *rt, lisp_scope *scope,
+                                lisp_symbol *name, lisp_list *bindings,
+                                lisp_list *body)
+{
+	struct named_let loop;
+	lisp_list *it;
+	lisp_symbol *sym;
+	lisp_value *v;
+
+	loop.self = lisp_builtin_new_v(rt, "named let", named_let_again,
+	                               &loop, 1);
+	loop.scope = lisp_new_empty_scope(rt);
+	loop.scope->up = scope;
+	loop.bindings = bindings;
+	lisp_scope_bind(loop.scope, name, (lisp_value *) loop.self);
+
+	it = bindings;
+	v = (lisp_value *) loop.self;
+	lisp_for_each(it) {
+		if (!lisp_is(it->left, type_list)) {
+			v = lisp_error(rt, LE_TYPE, "expected binding list");
+			break;
+		}
+		if (!lisp_get_args(rt, (lisp_list*)it->left, "s*", &sym, &v)) {
+			v = NULL;
+			break;
+		}
+		v = lisp_eval(rt, loop.scope, v);
+		if (!v)
+			break;
+		lisp_scope_bind(loop.scope, sym, v);
+	}
+
+	while (v) {
+		loop.called = 0;
+		v = lisp_progn(rt, loop.scope, body);
+		if (v == (lisp_value *) loop.self && loop.called)
+			continue;
+		if (v && loop.called)
+			v = lisp_error(rt, LE_SYNTAX,
+			               "named let must be called in tail position");
+		break;
+	}
+
+	loop.self->user = NULL;
+	return v;
+}
+
+static lisp_value *lisp_builtin_values(lisp_runtime *rt, lisp_scope *scope,
+                                       int argc, lisp_value **argv,
+                                       void *user)
+{
+	(void) scope; /* unused */
+	(void) user;
+	return lisp_values_new(rt, argc, argv);
+}
+
+/*
+ * (call-with-values producer consumer)
+ * Calls producer with no arguments, and then consumer with each of the values
+ * it returns as an argument.
+ */
+static lisp_value *lisp_builtin_call_with_values(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	lisp_value *producer, *consumer, *result, **values;
+	int i, n;
+	(void) user; /* unused */
+
+	if (!lisp_get_args_v(rt, argc, argv, "**", &producer, &consumer))
+		return NULL;
+
+	result = lisp_call_v(rt, scope, producer, 0, NULL);
+	lisp_error_check(result);
+
+	/* the values may be replaced during the call, so copy them */
+	n = lisp_values_count(result);
+	values = lisp_vstack_push(rt, n);
+	for (i = 0; i < n; i++)
+		values[i] = lisp_values_get(result, i);
+	result = lisp_call_v(rt, scope, consumer, n, values);
+	lisp_vstack_pop(rt, n);
+	return result;
+}
+
+/*
+ * An escape continuation, created by call/ec. Calling it stores its arguments
+ * and returns NULL with LE_ESCAPE set, so that each caller returns just as it
+ * would for an error, cleaning up its stack frame on the way. The call/ec
+ * which created it recognizes its own escape (the value is set) and returns
+ * the value instead.
+ */
+struct escape {
+	lisp_builtin *self;
+	lisp_value *value;
+};
+
+static lisp_value *escape_call(lisp_runtime *rt, lisp_scope *scope,
+                               int argc, lisp_value **argv, void *user)
+{
+	struct escape *escape = user;
+	(void) scope; /* unused */
+
+	if (!escape)
+		return lisp_error(rt, LE_ERROR, "escape called after call/ec returned");
+
+	escape->value = lisp_values_new(rt, argc, argv);
+	return lisp_error(rt, LE_ESCAPE, "escape continuation called");
+}
+
+/*
+ * (call/ec function)
+ * Calls function with an escape continuation. Calling the continuation returns
+ * its arguments from call/ec right away, like values does. It may only be
+ * called until call/ec returns.
+ */
+static lisp_value *lisp_builtin_call_ec(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv,
+		void *user)
+{
+	struct escape escape;
+	lisp_value *function, *k, *result;
+	(void) user; /* unused */
+
+	if (!lisp_get_args_v(rt, argc, argv, "*", &function))
+		return NULL;
+
+	escape.self = lisp_builtin_new_v(rt, "escape", escape_call, &escape, 1);
+	escape.value = NULL;
+	k = (lisp_value *) escape.self;
+	result = lisp_call_v(rt, scope, function, 1, &k);
+	escape.self->user = NULL;
+
+	if (!result && escape.value && lisp_get_errno(rt) == LE_ESCAPE) {
+		lisp_clear_error(rt);
+		result = escape.value;
+	}
+	return result;
+}
+
+/*
+ * (raise 'LE_... "message" [payload])
+ * Raise an error with the given error code and message, and optionally any
+ * value as its payload, which try passes to its catch clause. LE_ESCAPE is
+ * reserved for call/ec, so it can't be raised.
+ */
+static lisp_value *lisp_builtin_raise(lisp_runtime *rt, lisp_scope *scope,
+                                      int argc, lisp_value **argv, void *user)
+{
+	lisp_symbol *name;
+	lisp_string *message;
+	lisp_value *payload = lisp_nil_new(rt);
+	enum lisp_errno err_num;
+	(void) scope; /* unused */
+	(void) user;
+
+	if (argc == 3) {
+		if (!lisp_get_args_v(rt, argc, argv, "sS*", &name, &message,
+		                     &payload))
+			return NULL;
+	} else if (!lisp_get_args_v(rt, argc, argv, "sS", &name, &message)) {
+		return NULL;
+	}
+
+	err_num = lisp_sym_to_errno(name);
+	if (err_num == LE_MAX_ERR || err_num == 0 || err_num == LE_ESCAPE)
+		return lisp_error(rt, LE_VALUE, "unrecognized error type");
+
+	lisp_error(rt, err_num, message->s);
+	rt->error_value = (lisp_value *) lisp_list_new(rt, (lisp_value *) name,
+		(lisp_value *) lisp_list_new(rt, (lisp_value *) message,
+			(lisp_value *) lisp_list_new(rt, payload,
+			                             lisp_nil_new(rt))));
+	return NULL;
+}
+
+lisp_list *lisp_try_catch_clause(lisp_list *args)
+{
+	lisp_list *clause, *params;
+
+	if (lisp_is_bad_list(args) || lisp_list_length(args) < 2)
+		return NULL;
+	while (!lisp_nil_p(args->right))
+		args = (lisp_list *) args->right;
+
+	clause = (lisp_list *) args->left;
+	if (clause->type != type_list || lisp_is_bad_list(clause) ||
+	    lisp_list_length(clause) < 2 ||
+	    clause->left->type != type_symbol ||
+	    strcmp(((lisp_symbol *) clause->left)->s, "catch") != 0)
+		return NULL;
+
+	params = (lisp_list *) ((lisp_list *) clause->right)->left;
+	if (params->type != type_list || lisp_list_length(params) != 1 ||
+	    params->left->type != type_symbol)
+		return NULL;
+	return clause;
+}
+
+lisp_value *lisp_try(lisp_runtime *rt, lisp_scope *scope, lisp_list *body,
+                     lisp_symbol *var, lisp_list *handler)
+{
+	lisp_value *result, *error;
+	lisp_scope *handler_scope;
+
+	result = lisp_progn(rt, scope, body);
+	if (result || rt->err_num == LE_ESCAPE || rt->err_num == LE_EXIT)
+		return result;
+
+	error = lisp_error_value(rt);
+	lisp_clear_error(rt);
+	handler_scope = lisp_new_empty_scope(rt);
+	handler_scope->up = scope;
+	lisp_scope_bind(handler_scope, var, error);
+	return lisp_progn(rt, handler_scope, handler);
+}
+
+/*
+ * (try expression ...
+ *   (catch (symbol) expression ...))
+ * Evaluates the expressions before the catch clause, and returns the last
+ * one. If any of them fails, the error is bound to symbol as a list of its
+ * code, message and payload (see raise), and the catch clause is evaluated
+ * instead. Escapes (see call/ec) are not caught.
+ */
+lisp_value *lisp_builtin_try(lisp_runtime *rt, lisp_scope *scope,
+                             lisp_list *arglist, void *user)
+{
+	/* args NOT evaluated */
+	lisp_list *clause, *body, *tail = NULL, *params;
+	(void) user; /* unused */
+
+	clause = lisp_try_catch_clause(arglist);
+	if (!clause)
+		return lisp_error(rt, LE_SYNTAX,
+		                  "try must end with (catch (symbol) ...)");
+
+	body = (lisp_list *) lisp_nil_new(rt);
+	for (; !lisp_nil_p(arglist->right); arglist = (lisp_list *) arglist->right)
+		lisp_list_append(rt, &body, &tail, arglist->left);
+
+	clause = (lisp_list *) clause->right;
+	params = (lisp_list *) clause->left;
+	return lisp_try(rt, scope, body, (lisp_symbol *) params->left,
+	                (lisp_list *) clause->right);
+}
+
+lisp_value *lisp_bind_values(lisp_runtime *rt, lisp_scope *scope,
+                             lisp_list *names, lisp_value *result)
+{
+	int count = lisp_values_count(result), i = 0;
+
+	if (count < lisp_list_length(names))
+		return lisp_error(rt, LE_2FEW, "not enough values to bind");
+	if (count > lisp_list_length(names))
+		return lisp_error(rt, LE_2MANY, "too many values to bind");
+
+	lisp_for_each(names) {
+		lisp_scope_bind(scope, (lisp_symbol *) names->left,
+		                lisp_values_get(result, i++));
+	}
+	return result;
+}
+
+/*
+ * (let-values (((symbol ...) expression)
+ *              ((symbol ...) expression) ...)
+ *   expression ...)
+ *
+ * Like let, but each expression may return multiple values (see values),
+ * which are bound to the symbols in order.
+ */
+lisp_value *lisp_builtin_let_values(lisp_runtime *rt, lisp_scope *scope,
+                                    lisp_list *arglist, void *user)
+{
+	/* args NOT evaluated */
+	lisp_list *binding_list, *expressions, *names, *it;
+	lisp_value *value;
+	lisp_scope *new_scope;
+	(void) user; /* unused */
+
+	if (!lisp_get_args(rt, arglist, "lR", &binding_list, &expressions))
+		return NULL;
+
+	new_scope = lisp_new_empty_scope(rt);
+	new_scope->up = scope;
+
+	lisp_for_each(binding_list) {
+		if (!lisp_is(binding_list->left, type_list))
+			return lisp_error(rt, LE_TYPE, "expected binding list");
+		if (!lisp_get_args(rt, (lisp_list*)binding_list->left, "l*",
+		                   &names, &value))
+			return NULL;
+		it = names;
+		lisp_for_each(it) {
+			if (!lisp_is(it->left, type_symbol))
+				return lisp_error(rt, LE_TYPE, "expected symbols to bind");
+		}
+		value = lisp_eval(rt, new_scope, value);
+		lisp_error_check(value);
+		if (!lisp_bind_values(rt, new_scope, names, value))
+			return NULL;
+	}
+
+	return lisp_progn(rt, new_scope, expressions);
+}
+
+static lisp_value *lisp_builtin_import(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv, void *user)
+{
+	/*
+	 * args are NOT evaluated
+	 * (import symbol)  ->  looks up module "symbol" and inserts it into
+	 * current scope
+	 */
+	lisp_symbol *sym;
+	lisp_module *mod;
+
+	(void) user; /* unused */
+
+	if (!lisp_get_args_v(rt, argc, argv, "s", &sym))
+		return NULL;
+
+	mod = lisp_do_import(rt, sym);
+	lisp_error_check(mod);
+
+	lisp_scope_bind(scope, sym, (lisp_value*)mod);
+	return (lisp_value*)mod;
+}
+
+static lisp_value *lisp_builtin_getattr(
+		lisp_runtime *rt, lisp_scope *scope, int argc, lisp_value **argv, void *user)
+{
+	lisp_module *mod;
+	lisp_symbol *sym;
+
+	(void) user;
+	(void) scope; /* unused */
+
+	if (!lisp_get_args_v(rt, argc, argv, "*s", &mod, &sym))
+		return NULL;
+
+	return lisp_scope_lookup(rt, mod->contents, sym);
+}
+
+/*
+ * Fast paths for arithmetic and comparison with one or two arguments. When
+ * lisp_analyze() finds a call to one of these builtins with the right number
+ * of arguments, it creates a node which evaluates the arguments (a and b) and
+ * computes the result directly. These must behave just like the builtins.
+ * They don't push a stack frame, so if they fail, fast_error() adds the frame
+ * the builtin (c) would have had to the error's stack trace.
+ */
+
+#define FAST_ENTER(rt) \
+	unsigned int depth = (rt)->stack_depth, inlined = (rt)->inlined_depth
+
+static lisp_value *fast_error(lisp_runtime *rt, lisp_scope *scope,
+                              lisp_node *node, unsigned int depth,
+                              unsigned int inlined)
+{
+	lisp_list *args = (lisp_list*) ((lisp_list*) node->form)->right;
+	lisp_error_frame(rt, node->c, args, scope, depth, inlined);
+	return NULL;
+}
+
+#define FAST_ERROR() fast_error(rt, scope, node, depth, inlined)
+#define FAST_RESULT(v) ((rv = (v)) ? rv : FAST_ERROR())
+
+static int eval_numbers(lisp_runtime *rt, lisp_scope *scope, lisp_node *node,
+                         lisp_value **lhs, lisp_value **rhs, char *message)
+{
+	*lhs = lisp_eval(rt, scope, node->a);
+	if (!*lhs)
+		return 0;
+	*rhs = lisp_eval(rt, scope, node->b);
+	if (!*rhs)
+		return 0;
+	if (!lisp_is_number(*lhs) || !lisp_is_number(*rhs)) {
+		lisp_error(rt, LE_TYPE, message);
+		return 0;
+	}
+	return 1;
+}
+
+#define FIXNUMS(lhs, rhs) \
+	((lhs)->type == type_integer && (rhs)->type == type_integer)
+#define FIXNUM(v) (((lisp_integer*)(v))->x)
+
+static lisp_value *fast_plus(lisp_runtime *rt, lisp_scope *scope,
+                             lisp_node *node)
+{
+	FAST_ENTER(rt);
+	lisp_value *lhs, *rhs, *rv;
+	long x;
+	if (!eval_numbers(rt, scope, node, &lhs, &rhs,
+	                   "expect integers for addition"))
+		return FAST_ERROR();
+	if (FIXNUMS(lhs, rhs) && !add_overflow(FIXNUM(lhs), FIXNUM(rhs), &x))
+		return (lisp_value*) lisp_integer_new(rt, x);
+	return FAST_RESULT(arith(rt, ARITH_ADD, lhs, rhs));
+}
+
+static lisp_value *fast_minus(lisp_runtime *rt, lisp_scope *scope,
+                              lisp_node *node)
+{
+	FAST_ENTER(rt);
+	lisp_value *lhs, *rhs, *rv;
+	long x;
+	if (!eval_numbers(rt, scope, node, &lhs, &rhs, "expected integer"))
+		return FAST_ERROR();
+	if (FIXNUMS(lhs, rhs) && !sub_overflow(FIXNUM(lhs), FIXNUM(rhs), &x))
+		return (lisp_value*) lisp_integer_new(rt, x);
+	return FAST_RESULT(arith(rt, ARITH_SUB, lhs, rhs));
+}
+
+static lisp_value *fast_negate(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_node *node)
+{
+	FAST_ENTER(rt);
+	lisp_value *v = lisp_eval(rt, scope, node->a), *rv;
+	long x;
+	if (!v)
+		return FAST_ERROR();
+	if (!lisp_is_number(v)) {
+		lisp_error(rt, LE_TYPE, "expected integer");
+		return FAST_ERROR();
+	}
+	if (v->type == type_integer && !sub_overflow(0, FIXNUM(v), &x))
+		return (lisp_value*) lisp_integer_new(rt, x);
+	if (v->type == type_float)
+		return (lisp_value*) lisp_float_new(rt, - ((lisp_float*)v)->x);
+	return FAST_RESULT(lisp_bignum_neg(rt, v));
+}
+
+static lisp_value *fast_multiply(lisp_runtime *rt, lisp_scope *scope,
+                                 lisp_node *node)
+{
+	FAST_ENTER(rt);
+	lisp_value *lhs, *rhs, *rv;
+	long x;
+	if (!eval_numbers(rt, scope, node, &lhs, &rhs,
+	                   "expect integers for multiplication"))
+		return FAST_ERROR();
+	if (FIXNUMS(lhs, rhs) && !mul_overflow(FIXNUM(lhs), FIXNUM(rhs), &x))
+		return (lisp_value*) lisp_integer_new(rt, x);
+	return FAST_RESULT(arith(rt, ARITH_MUL, lhs, rhs));
+}
+
+static lisp_value *fast_divide(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_node *node)
+{
+	FAST_ENTER(rt);
+	lisp_value *lhs, *rhs, *rv;
+	if (!eval_numbers(rt, scope, node, &lhs, &rhs, "expected integer"))
+		return FAST_ERROR();
+	return FAST_RESULT(arith(rt, ARITH_DIV, lhs, rhs));
+}
+
+static lisp_value *fast_cmp(lisp_runtime *rt, lisp_scope *scope,
+                            lisp_node *node)
+{
+	FAST_ENTER(rt);
+	void *op = ((lisp_builtin*) node->c)->user;
+	lisp_value *lhs, *rhs;
+
+	if (!eval_numbers(rt, scope, node, &lhs, &rhs,
+	                   "incorrect argument type"))
+		return FAST_ERROR();
+	return lisp_boolean(rt, compare_result(op, compare_numbers(lhs, rhs)));
+}
+
+lisp_node_exec lisp_builtin_fast_path(lisp_builtin *builtin, int argc)
+{
+	if (argc == 1 && builtin->call_v == lisp_builtin_minus)
+		return fast_negate;
+	if (argc != 2)
+		return NULL;
+
+	if (builtin->call_v == lisp_builtin_plus)
+		return fast_plus;
+	else if (builtin->call_v == lisp_builtin_minus)
+		return fast_minus;
+	else if (builtin->call_v == lisp_builtin_multiply)
+		return fast_multiply;
+	else if (builtin->call_v == lisp_builtin_divide)
+		return fast_divide;
+	else if (builtin->call_v == lisp_builtin_cmp)
+		return fast_cmp;
+	return NULL;
+}
+
+enum lisp_fast_op lisp_builtin_fast_op(lisp_node *node)
+{
+	void *op;
+
+	if (node->exec == fast_plus)
+		return FAST_ADD;
+	else if (node->exec == fast_minus)
+		return FAST_SUB;
+	else if (node->exec == fast_negate)
+		return FAST_NEG;
+	else if (node->exec == fast_multiply)
+		return FAST_MUL;
+	else if (node->exec == fast_divide)
+		return FAST_DIV;
+	else if (node->exec != fast_cmp)
+		return FAST_NONE;
+
+	op = ((lisp_builtin*) node->c)->user;
+	if (op == CMP_EQ)
+		return FAST_EQ;
+	else if (op == CMP_NE)
+		return FAST_NE;
+	else if (op == CMP_LT)
+		return FAST_LT;
+	else if (op == CMP_LE)
+		return FAST_LE;
+	else if (op == CMP_GT)
+		return FAST_GT;
+	return FAST_GE;
+}
+
+/*
+ * Builtins which always return the same result for the same arguments, and
+ * have no other effects. lisp_analyze() may call these ahead of time when
+ * their arguments are constant.
+ */
+static lisp_builtin_func_v pure_builtins[] = {
+	lisp_builtin_car,
+	lisp_builtin_cdr,
+	lisp_builtin_plus,
+	lisp_builtin_minus,
+	lisp_builtin_multiply,
+	lisp_builtin_divide,
+	lisp_builtin_cmp,
+	lisp_builtin_null_p,
+	lisp_builtin_equal,
+};
+
+int lisp_builtin_pure(lisp_builtin *builtin)
+{
+	size_t i;
+	for (i = 0; i < sizeof(pure_builtins) / sizeof(pure_builtins[0]); i++)
+		if (builtin->call_v == pure_builtins[i])
+			return 1;
+	return 0;
+}
+
+/*
+ * What some builtins accept and return, for checking calls as lambdas are
+ * created (see lisp_analyze()). Types are in the notation of lisp_get_args(),
+ * plus n for any number, and when max is -1, the last argument type repeats.
+ * Arithmetic may return a float rather than an integer, but it's only passed
+ * on to other arithmetic (which accepts either) or to checks which are lenient
+ * anyway.
+ */
+static struct {
+	lisp_builtin_func_v call_v;
+	int min;
+	int max;
+	char *args;
+	char returns;
+} signatures[] = {
+	{lisp_builtin_eval, 1, 1, "*", '*'},
+	{lisp_builtin_car, 1, 1, "l", '*'},
+	{lisp_builtin_cdr, 1, 1, "l", '*'},
+	{lisp_builtin_cons, 2, 2, "**", 'l'},
+	{lisp_builtin_plus, 0, -1, "n", 'd'},
+	{lisp_builtin_minus, 1, -1, "n", 'd'},
+	{lisp_builtin_multiply, 0, -1, "n", 'd'},
+	{lisp_builtin_divide, 1, -1, "n", 'd'},
+	{lisp_builtin_cmp, 2, 2, "nn", 'd'},
+	{lisp_builtin_null_p, 1, 1, "*", 'd'},
+	{lisp_builtin_map, 2, -1, "**", 'l'},
+	{lisp_builtin_reduce, 2, 3, "***", '*'},
+	{lisp_builtin_print, 0, -1, "*", 'l'},
+	{lisp_builtin_eq, 2, 2, "**", 'd'},
+	{lisp_builtin_equal, 2, 2, "**", 'd'},
+	{lisp_builtin_assert, 1, 1, "d", 'd'},
+	{lisp_builtin_list, 0, -1, "*", 'l'},
+	{lisp_builtin_make_vector, 1, 2, "d*", 'v'},
+	{lisp_builtin_vector, 0, -1, "*", 'v'},
+	{lisp_builtin_vector_ref, 2, 2, "vd", '*'},
+	{lisp_builtin_vector_set, 3, 3, "vd*", '*'},
+	{lisp_builtin_vector_length, 1, 1, "v", 'd'},
+	{lisp_builtin_list_to_vector, 1, 1, "l", 'v'},
+	{lisp_builtin_vector_to_list, 1, 1, "v", 'l'},
+	{lisp_builtin_make_hash, 0, 0, "", 'h'},
+	{lisp_builtin_hash_ref, 2, 3, "h**", '*'},
+	{lisp_builtin_hash_set, 3, 3, "h**", '*'},
+	{lisp_builtin_hash_remove, 2, 2, "h*", 'd'},
+	{lisp_builtin_hash_count, 1, 1, "h", 'd'},
+	{lisp_builtin_hash_items, 1, 1, "h", 'l'},
+	{lisp_builtin_make_string_builder, 0, 0, "", '*'},
+	{lisp_builtin_string_builder_append, 1, -1, "*", '*'},
+	{lisp_builtin_string_builder_to_string, 1, 1, "*", 'S'},
+	{lisp_builtin_string_append, 0, -1, "*", '*'},
+	{lisp_builtin_string_length, 1, 1, "*", 'd'},
+	{lisp_builtin_rope_to_string, 1, 1, "*", 'S'},
+	{lisp_builtin_call_with_values, 2, 2, "**", '*'},
+	{lisp_builtin_call_ec, 1, 1, "*", '*'},
+	{lisp_builtin_raise, 2, 3, "sS*", '*'},
+};
+
+/* Whether a value of type may be passed where a signature has c */
+static int accepts(char c, lisp_type *type)
+{
+	lisp_type *expected;
+
+	if (c == 'n')
+		return type == type_integer || type == type_bignum ||
+			type == type_float;
+	expected = lisp_format_type(c);
+	return !expected || expected == type;
+}
+
+static int signature_of(lisp_builtin *builtin)
+{
+	int i;
+	for (i = 0; i < (int) (sizeof(signatures) / sizeof(signatures[0])); i++)
+		if (builtin->evald && builtin->call_v == signatures[i].call_v)
+			return i;
+	return -1;
+}
+
+int lisp_builtin_check(lisp_runtime *rt, lisp_builtin *builtin, int argc,
+                       lisp_type **types)
+{
+	int sig = signature_of(builtin), i, len;
+
+	if (sig < 0)
+		return 1;
+	if (argc < signatures[sig].min) {
+		lisp_error(rt, LE_2FEW, "not enough arguments");
+		return 0;
+	}
+	if (signatures[sig].max >= 0 && argc > signatures[sig].max) {
+		lisp_error(rt, LE_2MANY, "too many arguments");
+		return 0;
+	}
+
+	len = strlen(signatures[sig].args);
+	for (i = 0; i < argc; i++) {
+		if (types[i] && !accepts(signatures[sig].args[i < len ? i : len - 1],
+		                         types[i])) {
+			lisp_error(rt, LE_TYPE, "incorrect argument type");
+			return 0;
+		}
+	}
+	return 1;
+}
+
+lisp_type *lisp_builtin_returns(lisp_builtin *builtin)
+{
+	int sig = signature_of(builtin);
+	if (sig < 0)
+		return NULL;
+	return lisp_format_type(signatures[sig].returns);
 }
 
 void lisp_scope_populate_builtins(lisp_runtime *rt, lisp_scope *scope)
 {
-	lisp_scope_add_builtin(rt, scope, "eval", lisp_builtin_eval, NULL, 1);
-	lisp_scope_add_builtin(rt, scope, "car", lisp_builtin_car, NULL, 1);
-	lisp_scope_add_builtin(rt, scope, "cdr", lisp_builtin_cdr, NULL, 1);
-	lisp_scope_add_builtin(rt, scope, "quote", lisp_builtin_quote, NULL, 0);
-	lisp_scope_add_builtin(rt, scope, "cons", lisp_builtin_cons, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "eval", lisp_builtin_eval, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "car", lisp_builtin_car, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "cdr", lisp_builtin_cdr, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "quote", lisp_builtin_quote, NULL, 0);
+	lisp_scope_add_builtin_v(rt, scope, "cons", lisp_builtin_cons, NULL, 1);
 	lisp_scope_add_builtin(rt, scope, "lambda", lisp_builtin_lambda, NULL, 0);
 	lisp_scope_add_builtin(rt, scope, "macro", lisp_builtin_macro, NULL, 0);
-	lisp_scope_add_builtin(rt, scope, "define", lisp_builtin_define, NULL, 0);
-	lisp_scope_add_builtin(rt, scope, "+", lisp_builtin_plus, NULL, 1);
-	lisp_scope_add_builtin(rt, scope, "-", lisp_builtin_minus, NULL, 1);
-	lisp_scope_add_builtin(rt, scope, "*", lisp_builtin_multiply, NULL, 1);
-	lisp_scope_add_builtin(rt, scope, "/", lisp_builtin_divide, NULL, 1);
-	lisp_scope_add_builtin(rt, scope, "==", lisp_builtin_cmp, CMP_EQ, 1);
-	lisp_scope_add_builtin(rt, scope, "=", lisp_builtin_cmp, CMP_EQ, 1);
-	lisp_scope_add_builtin(rt, scope, "!=", lisp_builtin_cmp, CMP_NE, 1);
-	lisp_scope_add_builtin(rt, scope, ">", lisp_builtin_cmp, CMP_GT, 1);
-	lisp_scope_add_builtin(rt, scope, ">=", lisp_builtin_cmp, CMP_GE, 1);
-	lisp_scope_add_builtin(rt, scope, "<", lisp_builtin_cmp, CMP_LT, 1);
-	lisp_scope_add_builtin(rt, scope, "<=", lisp_builtin_cmp, CMP_LE, 1);
-	lisp_scope_add_builtin(rt, scope, "if", lisp_builtin_if, NULL, 0);
-	lisp_scope_add_builtin(rt, scope, "null?", lisp_builtin_null_p, NULL, 1);
-	lisp_scope_add_builtin(rt, scope, "map", lisp_builtin_map, NULL, 1);
-	lisp_scope_add_builtin(rt, scope, "reduce", lisp_builtin_reduce, NULL, 1);
-	lisp_scope_add_builtin(rt, scope, "print", lisp_builtin_print, NULL, 1);
-	lisp_scope_add_builtin(rt, scope, "dump-stack", lisp_builtin_dump_stack, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "define", lisp_builtin_define, NULL, 0);
+	lisp_scope_add_builtin_v(rt, scope, "+", lisp_builtin_plus, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "-", lisp_builtin_minus, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "*", lisp_builtin_multiply, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "/", lisp_builtin_divide, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "==", lisp_builtin_cmp, CMP_EQ, 1);
+	lisp_scope_add_builtin_v(rt, scope, "=", lisp_builtin_cmp, CMP_EQ, 1);
+	lisp_scope_add_builtin_v(rt, scope, "!=", lisp_builtin_cmp, CMP_NE, 1);
+	lisp_scope_add_builtin_v(rt, scope, ">", lisp_builtin_cmp, CMP_GT, 1);
+	lisp_scope_add_builtin_v(rt, scope, ">=", lisp_builtin_cmp, CMP_GE, 1);
+	lisp_scope_add_builtin_v(rt, scope, "<", lisp_builtin_cmp, CMP_LT, 1);
+	lisp_scope_add_builtin_v(rt, scope, "<=", lisp_builtin_cmp, CMP_LE, 1);
+	lisp_scope_add_builtin_v(rt, scope, "if", lisp_builtin_if, NULL, 0);
+	lisp_scope_add_builtin_v(rt, scope, "null?", lisp_builtin_null_p, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "map", lisp_builtin_map, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "reduce", lisp_builtin_reduce, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "print", lisp_builtin_print, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "dump-stack", lisp_builtin_dump_stack, NULL, 1);
 	lisp_scope_add_builtin(rt, scope, "progn", lisp_builtin_progn, NULL, 0);
-	lisp_scope_add_builtin(rt, scope, "unquote", lisp_builtin_unquote, NULL, 0);
-	lisp_scope_add_builtin(rt, scope, "quasiquote", lisp_builtin_quasiquote, NULL, 0);
-	lisp_scope_add_builtin(rt, scope, "eq?", lisp_builtin_eq, NULL, 1);
-	lisp_scope_add_builtin(rt, scope, "equal?", lisp_builtin_equal, NULL, 1);
-	lisp_scope_add_builtin(rt, scope, "assert", lisp_builtin_assert, NULL, 1);
-	lisp_scope_add_builtin(rt, scope, "assert-error", lisp_builtin_assert_error, NULL, 0);
-	lisp_scope_add_builtin(rt, scope, "cond", lisp_builtin_cond, NULL, 0);
-	lisp_scope_add_builtin(rt, scope, "list", lisp_builtin_list, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "unquote", lisp_builtin_unquote, NULL, 0);
+	lisp_scope_add_builtin_v(rt, scope, "quasiquote", lisp_builtin_quasiquote, NULL, 0);
+	lisp_scope_add_builtin_v(rt, scope, "eq?", lisp_builtin_eq, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "equal?", lisp_builtin_equal, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "assert", lisp_builtin_assert, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "assert-error", lisp_builtin_assert_error, NULL, 0);
+	lisp_scope_add_builtin_v(rt, scope, "cond", lisp_builtin_cond, NULL, 0);
+	lisp_scope_add_builtin_v(rt, scope, "list", lisp_builtin_list, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "make-vector", lisp_builtin_make_vector, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "vector", lisp_builtin_vector, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "vector-ref", lisp_builtin_vector_ref, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "vector-set!", lisp_builtin_vector_set, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "vector-length", lisp_builtin_vector_length, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "list->vector", lisp_builtin_list_to_vector, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "vector->list", lisp_builtin_vector_to_list, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "make-hash", lisp_builtin_make_hash, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "hash-ref", lisp_builtin_hash_ref, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "hash-set!", lisp_builtin_hash_set, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "hash-remove!", lisp_builtin_hash_remove, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "hash-count", lisp_builtin_hash_count, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "hash-keys", lisp_builtin_hash_items, HASH_KEYS, 1);
+	lisp_scope_add_builtin_v(rt, scope, "hash-values", lisp_builtin_hash_items, HASH_VALUES, 1);
+	lisp_scope_add_builtin_v(rt, scope, "hash->list", lisp_builtin_hash_items, HASH_PAIRS, 1);
+	lisp_scope_add_builtin_v(rt, scope, "make-string-builder", lisp_builtin_make_string_builder, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "string-builder-append!", lisp_builtin_string_builder_append, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "string-builder->string", lisp_builtin_string_builder_to_string, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "string-append", lisp_builtin_string_append, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "string-length", lisp_builtin_string_length, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "rope->string", lisp_builtin_rope_to_string, NULL, 1);
 	lisp_scope_add_builtin(rt, scope, "let", lisp_builtin_let, NULL, 0);
-	lisp_scope_add_builtin(rt, scope, "import", lisp_builtin_import, NULL, 0);
-	lisp_scope_add_builtin(rt, scope, "getattr", lisp_builtin_getattr, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "set!", lisp_builtin_set, NULL, 0);
+	lisp_scope_add_builtin(rt, scope, "while", lisp_builtin_while, NULL, 0);
+	lisp_scope_add_builtin(rt, scope, "dotimes", lisp_builtin_dotimes, NULL, 0);
+	lisp_scope_add_builtin(rt, scope, "for-each", lisp_builtin_for_each, NULL, 0);
+	lisp_scope_add_builtin_v(rt, scope, "values", lisp_builtin_values, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "call-with-values", lisp_builtin_call_with_values, NULL, 1);
+	lisp_scope_add_builtin(rt, scope, "let-values", lisp_builtin_let_values, NULL, 0);
+	lisp_scope_add_builtin_v(rt, scope, "call/ec", lisp_builtin_call_ec, NULL, 1);
+	lisp_scope_add_builtin_v(rt, scope, "raise", lisp_builtin_raise, NULL, 1);
+	lisp_scope_add_builtin(rt, scope, "try", lisp_builtin_try, NULL, 0);
+	lisp_scope_add_builtin_v(rt, scope, "import", lisp_builtin_import, NULL, 0);
+	lisp_scope_add_builtin_v(rt, scope, "getattr", lisp_builtin_getattr, NULL, 1);
 }
@@ -7,10 +7,12 @@
 #ifndef _FUNLISP_INTERNAL_H
 #define _FUNLISP_INTERNAL_H
 
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 
 #include "funlisp.h"
+#include "charbuf.h"
 #include "iter.h"
 #include "ringbuf.h"
 #include "hashtable.h"
@@ -39,6 +41,41 @@ struct lisp_value {
 	LISP_VALUE_HEAD;
 };
 
+/*
+ * A call in progress, see lisp_call(). Kept only for stack traces.
+ */
+struct lisp_frame {
+	lisp_value *callable;
+	lisp_list *args; /* as given at the call site */
+	lisp_scope *scope; /* the scope of the caller */
+};
+
+/*
+ * A call which lisp_analyze() inlined into its caller, see exec_inline(). It
+ * has no frame of its own on the stack, so it is recorded here, along with the
+ * stack depth it was called at, for stack traces. Its arguments (argv) are set
+ * once they are evaluated.
+ */
+struct lisp_inlined {
+	lisp_value *callable;
+	lisp_value **argv;
+	unsigned int depth;
+};
+
+/*
+ * The value stack holds the arguments of builtins which take an array (see
+ * lisp_builtin_func_v). Values on it are marked by the garbage collector. It
+ * is made of chunks which are never moved, so that an argument array remains
+ * valid while more values are pushed.
+ */
+struct vstack_chunk {
+	struct vstack_chunk *prev;
+	struct vstack_chunk *next;
+	lisp_value **values;
+	int top;
+	int size;
+};
+
 /* A lisp_runtime is NOT a lisp_value! */
 struct lisp_runtime {
 	/* Maintains a list of all lisp values allocated with this runtime, so
@@ -70,15 +107,40 @@ struct lisp_runtime {
 	 * You can use lisp_error() to set error, err_num, and error_stack.
 	 * Parsing functions typically use a macro to set error, err_num, and
 	 * error_line.
+	 *
+	 * lisp_error() doesn't build error_stack right away. The frames stay in
+	 * the stack array as the error returns through them, so it only records
+	 * the depth (error_depth, error_inlined), and error_stack is built once
+	 * it is needed, see lisp_error_trace(). Errors which are caught never
+	 * pay for it. The value of an error raised by Lisp code is kept in
+	 * error_value, see lisp_error_value().
 	 */
 	char *error;
 	enum lisp_errno err_num;
 	unsigned int error_line;
 	lisp_list *error_stack;
-
-	/* Maintain a stack as we go, can dump it at any time if we want. */
-	lisp_list *stack;
+	int error_needs_trace;
+	unsigned int error_depth;
+	unsigned int error_inlined;
+	lisp_value *error_value;
+
+	/* Maintain a stack as we go, can dump it at any time if we want. The
+	 * frames are kept in an array which only grows, so that calls don't need
+	 * to allocate. lisp_error() takes a snapshot as a list. */
+	struct lisp_frame *stack;
 	unsigned int stack_depth;
+	unsigned int stack_alloc;
+
+	/* Inlined calls in progress, a side table to the stack above */
+	struct lisp_inlined *inlined;
+	unsigned int inlined_depth;
+	unsigned int inlined_alloc;
+
+	/* Current chunk of the value stack */
+	struct vstack_chunk *vstack;
+
+	/* Shared results of comparisons, see lisp_boolean() */
+	lisp_value *booleans[2];
 
 	/* Maintain cache of lisp_symbol */
 	struct hashtable *symcache;
@@ -86,6 +148,26 @@ struct lisp_runtime {
 	struct hashtable *strcache;
 	/* Maintain builtin module list */
 	lisp_scope *modules;
+
+	/* Macro expansions, keyed by the argument list at each call site. See
+	 * struct macro_expansion below. */
+	struct hashtable macro_cache;
+
+	/* Settings for lisp_analyze() */
+	int fold;
+	int analyze;
+	int check;
+
+	/* Where the parser last counted lines up to, see line_at() in parse.c */
+	char *parse_input;
+	int parse_index;
+	unsigned int parse_line;
+
+	/* Counts of call sites specialized as they run, see analyze.c */
+	struct lisp_quicken_stats quicken;
+
+	/* Compile lambdas to machine code once they are hot, see jit.c */
+	int jit;
 };
 
 /* The below ARE lisp_values! */
@@ -93,10 +175,36 @@ struct lisp_scope {
 	LISP_VALUE_HEAD;
 	struct hashtable scope;
 	struct lisp_scope *up;
+	int global;
+};
+
+/*
+ * In a global scope (one made by lisp_new_default_scope(), or the contents of
+ * a module), each name is bound to a cell holding its value, rather than to
+ * the value itself. Binding the name again updates the cell, so code may keep
+ * a pointer to the cell instead of looking the name up each time (see
+ * exec_global() in analyze.c). A cell is marked shadowed when the same name is
+ * later bound by a global scope below it, since lookups from there no longer
+ * reach the cell. Cells belong to their scope, and are freed along with it.
+ */
+struct lisp_cell {
+	lisp_value *value;
+	int shadowed;
 };
 
+/* Return the value scope itself binds to symbol, or NULL */
+lisp_value *lisp_scope_get(lisp_scope *scope, lisp_symbol *symbol);
+
+/*
+ * Change the innermost existing binding of symbol, in scope or its parents
+ * (set!). Returns value, or NULL with LE_NOTFOUND if symbol isn't bound.
+ */
+lisp_value *lisp_scope_set(lisp_runtime *rt, lisp_scope *scope,
+                           lisp_symbol *symbol, lisp_value *value);
+
 struct lisp_list {
 	LISP_VALUE_HEAD;
+	unsigned int line; /* where the parser found it, or 0 */
 	lisp_value *left;
 	lisp_value *right;
 };
@@ -125,17 +233,111 @@ struct lisp_text {
 
 struct lisp_integer {
 	LISP_VALUE_HEAD;
-	int x;
+	long x;
 };
 
+struct lisp_float {
+	LISP_VALUE_HEAD;
+	double x;
+};
+
+/*
+ * Bignums are stored as limbs (base 2^LISP_LIMB_BITS digits), and a dlimb holds
+ * the product of two limbs. Where unsigned long is 64 bits, limbs are 32 bits;
+ * otherwise they're 16 bits, which C89 guarantees works.
+ */
+#if ULONG_MAX >> 31 >> 31 >= 3 && UINT_MAX >= 0xFFFFFFFFUL
+typedef unsigned int lisp_limb;
+#define LISP_LIMB_BITS 32
+#else
+typedef unsigned short lisp_limb;
+#define LISP_LIMB_BITS 16
+#endif
+typedef unsigned long lisp_dlimb;
+
+/*
+ * An integer which doesn't fit in a long. The magnitude is in limbs, least
+ * significant first, and the most significant is never zero. Arithmetic always
+ * returns a lisp_integer when the result fits, so the two never overlap.
+ */
+struct lisp_bignum {
+	LISP_VALUE_HEAD;
+	char negative;
+	int len;
+	lisp_limb *limbs;
+};
+
+/*
+ * The result of values. A few values are kept within the object itself (and
+ * values points to them), so that the usual case is a single allocation.
+ */
+#define LISP_VALUES_INLINE 4
+struct lisp_values {
+	LISP_VALUE_HEAD;
+	lisp_value **values;
+	int count;
+	lisp_value *inline_values[LISP_VALUES_INLINE];
+};
+
+/*
+ * A fixed number of items, stored contiguously. Every item is a value (nil
+ * when not yet set), so the garbage collector just scans the array.
+ */
+struct lisp_vector {
+	LISP_VALUE_HEAD;
+	lisp_value **items;
+	int len;
+};
+
+/*
+ * Keys and values are lisp_value pointers, hashed with lisp_value_hash(), so
+ * keys which are equal? find the same entry.
+ */
+struct lisp_hashmap {
+	LISP_VALUE_HEAD;
+	struct hashtable table;
+};
+
+/*
+ * A mutable string which grows as it is appended to, see string-builder-append!
+ */
+struct lisp_strbuf {
+	LISP_VALUE_HEAD;
+	struct charbuf cb;
+};
+
+/*
+ * An immutable concatenation of left and right, each of which is a string or
+ * another rope. Ropes are made by string-append once the result is long enough
+ * that copying it each time would cost more than the node does, and are only
+ * flattened when their contents are needed, see lisp_rope_flatten().
+ */
+struct lisp_rope {
+	LISP_VALUE_HEAD;
+	lisp_value *left;
+	lisp_value *right;
+	int length;
+};
+
+/* Append the text of a string or rope to cb */
+void lisp_rope_flatten(struct charbuf *cb, lisp_value *v);
+
 struct lisp_builtin {
 	LISP_VALUE_HEAD;
+	/* exactly one of these is non-NULL */
 	lisp_builtin_func call;
+	lisp_builtin_func_v call_v;
 	char *name;
 	void *user;
 	int evald;
 };
 
+/*
+ * Machine code for the body of a lambda, see lisp_jit_compile(). Called with
+ * the scope containing the lambda's arguments.
+ */
+typedef lisp_value *(*lisp_jit_func)(lisp_runtime *rt, lisp_scope *scope);
+
 struct lisp_lambda {
 	LISP_VALUE_HEAD;
 	lisp_list *args;
@@ -143,8 +345,14 @@ struct lisp_lambda {
 	lisp_scope *closure;
 	lisp_symbol *first_binding;
 	int lambda_type;
+	unsigned int calls;
+	lisp_jit_func jit;
+	size_t jit_size;
 };
 
+/* Number of calls before a lambda is compiled, when the JIT is enabled */
+#define LISP_JIT_THRESHOLD 100
+
 struct lisp_module {
 	LISP_VALUE_HEAD;
 	lisp_scope *contents;
@@ -152,6 +360,43 @@ struct lisp_module {
 	lisp_string *file;
 };
 
+/*
+ * A node is a special form, variable reference or call which has been parsed
+ * ahead of time by lisp_analyze(). When evaluated, it calls exec() rather than
+ * looking up and calling a builtin. The meaning of a, b, c, n and body depends
+ * on exec. Form is the original code, which is used for printing and
+ * comparison.
+ */
+typedef struct lisp_node lisp_node;
+typedef lisp_value *(*lisp_node_exec)(lisp_runtime *rt, lisp_scope *scope,
+                                      lisp_node *node);
+
+struct lisp_node {
+	LISP_VALUE_HEAD;
+	lisp_node_exec exec;
+	lisp_value *form;
+	lisp_value *a;
+	lisp_value *b;
+	lisp_value *c;
+	lisp_list *body;
+	int n;
+	void *cache; /* not a lisp_value, so it is never marked or freed */
+};
+
+extern lisp_type *type_node;
+
+/*
+ * A cached macro expansion. The key (in rt->macro_cache) is the unevaluated
+ * argument list of a call site, so a macro is only expanded once per site. The
+ * cache is only valid while the call site still calls the same macro object,
+ * so redefining a macro invalidates every expansion it produced. Entries are
+ * weak: when the call site is garbage collected, the entry goes with it.
+ */
+struct macro_expansion {
+	lisp_lambda *macro;
+	lisp_value *code;
+};
+
 /**
  * A function which consumes a single ::lisp_value and produces a new one as a
  * result.
@@ -176,8 +421,37 @@ lisp_list *lisp_map(lisp_runtime *rt, lisp_scope *scope, void *user, lisp_mapper
 
 /* Interpreter stuff */
 void lisp_init(lisp_runtime *rt);
+
+/* Return the current stack as a list of callables, most recent first */
+lisp_list *lisp_stack_list(lisp_runtime *rt);
+
+/* Build error_stack for the current error, if lisp_error() left it to us */
+void lisp_error_trace(lisp_runtime *rt);
+
+/*
+ * Add a frame to the stack trace of the current error, as if it had been
+ * pushed at depth (with inlined calls at that point) when the error occurred.
+ * This is for calls which don't push a frame as they run, see the fast paths
+ * in builtins.c, so they only pay for one when an error returns through them.
+ */
+void lisp_error_frame(lisp_runtime *rt, lisp_value *callable, lisp_list *args,
+                      lisp_scope *scope, unsigned int depth,
+                      unsigned int inlined);
+
+/*
+ * Return the current error as a list (errno-symbol message payload), which is
+ * what try binds in its catch clause.
+ */
+lisp_value *lisp_error_value(lisp_runtime *rt);
 void lisp_destroy(lisp_runtime *rt);
 
+/*
+ * Reserve n slots on the value stack, which are initialized to NULL. The
+ * returned array is valid until the matching lisp_vstack_pop().
+ */
+lisp_value **lisp_vstack_push(lisp_runtime *rt, int n);
+void lisp_vstack_pop(lisp_runtime *rt, int n);
+
 /* Shortcuts for type operations. */
 void lisp_free(lisp_runtime *rt, lisp_value *value);
 lisp_value *lisp_new(lisp_runtime *rt, lisp_type *typ);
@@ -191,11 +465,225 @@ int lisp_is_bad_list_of_lists(lisp_list *l);
 
 unsigned int lisp_text_hash(void *t);
 int lisp_text_compare(void *left, void *right);
+unsigned int lisp_ptr_hash(void *p);
+int lisp_ptr_compare(void *left, void *right);
+/* Hash and compare lisp_value* keys by value, as equal? does */
+unsigned int lisp_value_hash(void *p);
+int lisp_value_compare(void *left, void *right);
 
 void lisp_textcache_remove(struct hashtable *cache, struct lisp_text *t);
 
 int lisp_truthy(lisp_value *v);
 
+/* Whether v is an integer, either a lisp_integer or a lisp_bignum */
+#define lisp_is_integer(v) \
+	((v)->type == type_integer || (v)->type == type_bignum)
+
+/* Whether v is a number: an integer of either kind, or a float */
+#define lisp_is_number(v) (lisp_is_integer(v) || (v)->type == type_float)
+
+/*
+ * Arithmetic on integers of either kind, for when the result may not fit in a
+ * long. The result is a lisp_integer if it does fit, and a bignum otherwise.
+ * The divisor must not be zero, and division truncates towards zero.
+ */
+lisp_value *lisp_bignum_add(lisp_runtime *rt, lisp_value *lhs, lisp_value *rhs);
+lisp_value *lisp_bignum_sub(lisp_runtime *rt, lisp_value *lhs, lisp_value *rhs);
+lisp_value *lisp_bignum_mul(lisp_runtime *rt, lisp_value *lhs, lisp_value *rhs);
+lisp_value *lisp_bignum_div(lisp_runtime *rt, lisp_value *lhs, lisp_value *rhs);
+lisp_value *lisp_bignum_neg(lisp_runtime *rt, lisp_value *v);
+
+/* Compare integers of either kind, returning <0, 0 or >0 like strcmp() */
+int lisp_bignum_cmp(lisp_value *lhs, lisp_value *rhs);
+
+/* Create an integer of either kind from len decimal digits */
+lisp_value *lisp_bignum_parse(lisp_runtime *rt, char *digits, int len,
+                              int negative);
+
+void lisp_bignum_print(FILE *f, lisp_bignum *bignum);
+/* Append the decimal digits of a bignum to cb */
+void lisp_bignum_format(struct charbuf *cb, lisp_bignum *bignum);
+
+/* Write x to buf (of at least LISP_FLOAT_BUFSIZE), as a float is printed */
+#define LISP_FLOAT_BUFSIZE 32
+void lisp_float_format(char *buf, double x);
+
+/* An integer of either kind as a double, which may be rounded */
+double lisp_bignum_to_double(lisp_value *v);
+
+/*
+ * Return the integer 1 if value is true, or 0 otherwise. These are shared, so
+ * comparisons don't need to allocate their result.
+ */
+lisp_value *lisp_boolean(lisp_runtime *rt, int value);
+
+/*
+ * Return the value bound to symbol in scope (or its parents), or NULL if it is
+ * not bound. Unlike lisp_scope_lookup(), this does not set an error.
+ */
+lisp_value *lisp_scope_find(lisp_scope *scope, lisp_symbol *symbol);
+
+/*
+ * Analyze the body of a lambda or macro as it is created (with arguments named
+ * params), within the scope it is defined in. Returns an equivalent body, which
+ * may be the original code, or NULL with an error if checking is enabled and
+ * finds a call which would fail.
+ */
+lisp_list *lisp_analyze(lisp_runtime *rt, lisp_scope *scope, lisp_list *params,
+                        lisp_list *code);
+
+/* Return true if builtin has no side effects, see lisp_analyze() */
+int lisp_builtin_pure(lisp_builtin *builtin);
+
+/*
+ * Check a call to builtin with argc arguments against what it accepts, given
+ * the types of the arguments (NULL where they aren't known). Returns false and
+ * sets an error if the call would certainly fail. Builtins it doesn't know
+ * about pass.
+ */
+int lisp_builtin_check(lisp_runtime *rt, lisp_builtin *builtin, int argc,
+                       lisp_type **types);
+
+/* Return the type of value builtin always returns, or NULL if it varies */
+lisp_type *lisp_builtin_returns(lisp_builtin *builtin);
+
+/* Return the type a lisp_get_args() format character stands for, or NULL */
+lisp_type *lisp_format_type(char c);
+
+/*
+ * Return a node exec function which computes the result of calling builtin with
+ * argc arguments, or NULL if there isn't one. The node's a and b are the
+ * argument expressions, and c is the builtin.
+ */
+lisp_node_exec lisp_builtin_fast_path(lisp_builtin *builtin, int argc);
+
+/* The operation computed by a node returned from lisp_builtin_fast_path() */
+enum lisp_fast_op {
+	FAST_NONE, /* not a fast path node */
+	FAST_ADD, FAST_SUB, FAST_NEG, FAST_MUL, FAST_DIV,
+	FAST_EQ, FAST_NE, FAST_LT, FAST_LE, FAST_GT, FAST_GE
+};
+enum lisp_fast_op lisp_builtin_fast_op(lisp_node *node);
+
+/* The forms which lisp_analyze() creates nodes for */
+enum lisp_node_kind {
+	NODE_OTHER, NODE_QUOTE, NODE_IF, NODE_COND, NODE_PROGN, NODE_LOCAL,
+	NODE_GLOBAL, NODE_CALL, NODE_GUARD
+};
+enum lisp_node_kind lisp_node_kind(lisp_node *node);
+
+/*
+ * Compile the body of a lambda to machine code. Scope is the scope of a call
+ * to the lambda, used to find which builtins the code calls. Returns NULL when
+ * the platform isn't supported. The size is needed by lisp_jit_free().
+ */
+lisp_jit_func lisp_jit_compile(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_list *code, size_t *size);
+void lisp_jit_free(lisp_jit_func func, size_t size);
+
+/* Push a frame onto the call stack, see lisp_call() */
+void lisp_stack_push(lisp_runtime *rt, lisp_value *callable, lisp_list *args,
+                     lisp_scope *scope);
+
+/* Record an inlined call, see struct lisp_inlined. Pop with inlined_depth. */
+void lisp_inline_push(lisp_runtime *rt, lisp_value *callable);
+
+/*
+ * Call a lambda (not a macro) with arguments which are already evaluated. The
+ * caller is responsible for the stack frame.
+ */
+lisp_value *lisp_lambda_call_v(lisp_runtime *rt, lisp_lambda *lambda,
+                               int argc, lisp_value **argv);
+
+/*
+ * The same, for a call site which is known to pass exactly as many arguments
+ * as the lambda takes, so they aren't counted again.
+ */
+lisp_value *lisp_lambda_call_verified(lisp_runtime *rt, lisp_lambda *lambda,
+                                      lisp_value **argv);
+
+/* Builtins which implement syntax, which lisp_analyze() must understand */
+lisp_value *lisp_builtin_quote(lisp_runtime *rt, lisp_scope *scope,
+                               int argc, lisp_value **argv, void *user);
+lisp_value *lisp_builtin_quasiquote(lisp_runtime *rt, lisp_scope *scope,
+                                    int argc, lisp_value **argv, void *user);
+lisp_value *lisp_builtin_unquote(lisp_runtime *rt, lisp_scope *scope,
+                                 int argc, lisp_value **argv, void *user);
+lisp_value *lisp_builtin_lambda(lisp_runtime *rt, lisp_scope *scope,
+                                lisp_list *arguments, void *user);
+lisp_value *lisp_builtin_macro(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_list *arguments, void *user);
+lisp_value *lisp_builtin_define(lisp_runtime *rt, lisp_scope *scope,
+                                int argc, lisp_value **argv, void *user);
+lisp_value *lisp_builtin_if(lisp_runtime *rt, lisp_scope *scope,
+                            int argc, lisp_value **argv, void *user);
+lisp_value *lisp_builtin_progn(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_list *a, void *user);
+lisp_value *lisp_builtin_cond(lisp_runtime *rt, lisp_scope *scope,
+                              int argc, lisp_value **argv, void *user);
+lisp_value *lisp_builtin_let(lisp_runtime *rt, lisp_scope *scope,
+                             lisp_list *arglist, void *user);
+lisp_value *lisp_builtin_let_values(lisp_runtime *rt, lisp_scope *scope,
+                                    lisp_list *arglist, void *user);
+lisp_value *lisp_builtin_set(lisp_runtime *rt, lisp_scope *scope,
+                             int argc, lisp_value **argv, void *user);
+lisp_value *lisp_builtin_while(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_list *arglist, void *user);
+lisp_value *lisp_builtin_dotimes(lisp_runtime *rt, lisp_scope *scope,
+                                 lisp_list *arglist, void *user);
+lisp_value *lisp_builtin_for_each(lisp_runtime *rt, lisp_scope *scope,
+                                  lisp_list *arglist, void *user);
+lisp_value *lisp_builtin_try(lisp_runtime *rt, lisp_scope *scope,
+                             lisp_list *arglist, void *user);
+
+/*
+ * Bind each of names in scope to one of the values in result (see
+ * lisp_values_new()), for let-values. Returns result, or NULL with an error if
+ * the number of values is wrong.
+ */
+lisp_value *lisp_bind_values(lisp_runtime *rt, lisp_scope *scope,
+                             lisp_list *names, lisp_value *result);
+
+/*
+ * The loops behind while, dotimes, for-each and named let, shared by the
+ * builtins and the nodes lisp_analyze() makes for them. Loop variables live in
+ * a single scope created when the loop starts, which each iteration rebinds.
+ */
+lisp_value *lisp_loop_while(lisp_runtime *rt, lisp_scope *scope,
+                            lisp_value *condition, lisp_list *body);
+lisp_value *lisp_loop_dotimes(lisp_runtime *rt, lisp_scope *scope,
+                              lisp_symbol *var, lisp_value *count,
+                              lisp_list *body);
+lisp_value *lisp_loop_for_each(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_symbol *var, lisp_value *list,
+                               lisp_list *body);
+lisp_value *lisp_loop_named_let(lisp_runtime *rt, lisp_scope *scope,
+                                lisp_symbol *name, lisp_list *bindings,
+                                lisp_list *body);
+
+/*
+ * Return true if body, the expressions of a named let, only refers to its name
+ * by calling it in tail position. The loop can't support anything else, so
+ * the let builtin checks this each time a named let starts, and lisp_analyze()
+ * leaves named lets which fail it to the builtin.
+ */
+int lisp_named_let_tail_calls(lisp_scope *scope, lisp_symbol *name,
+                              lisp_list *body);
+
+/*
+ * Return the (catch (symbol) expression ...) clause which ends the arguments
+ * of try, or NULL if they don't end with a valid one.
+ */
+lisp_list *lisp_try_catch_clause(lisp_list *args);
+
+/*
+ * Evaluate body, and if it fails, evaluate handler in a new scope where var is
+ * bound to the error (see lisp_error_value()), for try. Shared by the builtin
+ * and the node lisp_analyze() makes for it.
+ */
+lisp_value *lisp_try(lisp_runtime *rt, lisp_scope *scope, lisp_list *body,
+                     lisp_symbol *var, lisp_list *handler);
+
 lisp_module *create_os_module(lisp_runtime *rt);
 lisp_module *lisp_lookup_module(lisp_runtime *rt, lisp_symbol *name);
 
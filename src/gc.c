@@ -4,9 +4,85 @@
  * Stephen Brennan <stephen@brennan.io>
  */
 #include <assert.h>
+#include <stdlib.h>
 
 #include "funlisp_internal.h"
 
+#define VSTACK_CHUNK 1024
+
+static struct vstack_chunk *vstack_chunk_new(struct vstack_chunk *prev, int size)
+{
+	struct vstack_chunk *chunk = malloc(sizeof(struct vstack_chunk));
+	chunk->prev = prev;
+	chunk->next = NULL;
+	chunk->values = malloc(sizeof(lisp_value*) * size);
+	chunk->top = 0;
+	chunk->size = size;
+	return chunk;
+}
+
+/* Free chunk and every chunk after it. */
+static void vstack_chunk_free(struct vstack_chunk *chunk)
+{
+	struct vstack_chunk *next;
+
+	for (; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk->values);
+		free(chunk);
+	}
+}
+
+lisp_value **lisp_vstack_push(lisp_runtime *rt, int n)
+{
+	struct vstack_chunk *chunk = rt->vstack;
+	lisp_value **slots;
+	int i;
+
+	if (chunk->top + n > chunk->size) {
+		/* re-use the next chunk if it's big enough, otherwise replace
+		 * it and the chunks after it */
+		if (chunk->next && chunk->next->size < n) {
+			vstack_chunk_free(chunk->next);
+			chunk->next = NULL;
+		}
+		if (!chunk->next)
+			chunk->next = vstack_chunk_new(chunk,
+				n > VSTACK_CHUNK ? n : VSTACK_CHUNK);
+		chunk = chunk->next;
+		rt->vstack = chunk;
+	}
+
+	slots = chunk->values + chunk->top;
+	chunk->top += n;
+	for (i = 0; i < n; i++)
+		slots[i] = NULL;
+	return slots;
+}
+
+void lisp_vstack_pop(lisp_runtime *rt, int n)
+{
+	struct vstack_chunk *chunk = rt->vstack;
+	chunk->top -= n;
+	if (n && chunk->top == 0 && chunk->prev)
+		rt->vstack = chunk->prev;
+}
+
+static void lisp_vstack_reset(lisp_runtime *rt)
+{
+	while (rt->vstack->prev) {
+		rt->vstack->top = 0;
+		rt->vstack = rt->vstack->prev;
+	}
+	rt->vstack->top = 0;
+}
+
+static void lisp_vstack_destroy(lisp_runtime *rt)
+{
+	lisp_vstack_reset(rt);
+	vstack_chunk_free(rt->vstack);
+}
+
 void lisp_init(lisp_runtime *rt)
 {
 	rt->nil = type_list->new(rt);
@@ -20,11 +96,29 @@ void lisp_init(lisp_runtime *rt)
 	rt->error= NULL;
 	rt->error_line = 0;
 	rt->error_stack = NULL;
-	rt->stack = (lisp_list *) rt->nil;
+	rt->error_needs_trace = 0;
+	rt->error_value = NULL;
+	rt->stack_alloc = 16;
+	rt->stack = malloc(sizeof(struct lisp_frame) * rt->stack_alloc);
 	rt->stack_depth = 0;
+	rt->inlined_alloc = 16;
+	rt->inlined = malloc(sizeof(struct lisp_inlined) * rt->inlined_alloc);
+	rt->inlined_depth = 0;
+	rt->vstack = vstack_chunk_new(NULL, VSTACK_CHUNK);
+	rt->booleans[0] = NULL;
+	rt->booleans[1] = NULL;
 	rt->symcache = NULL;
 	rt->strcache = NULL;
+	rt->fold = 0;
+	rt->analyze = 1;
+	rt->check = 0;
+	rt->parse_input = NULL;
+	rt->quicken.specialized = 0;
+	rt->quicken.deoptimized = 0;
+	rt->jit = 0;
 	rt->modules = lisp_new_empty_scope(rt);
+	ht_init(&rt->macro_cache, lisp_ptr_hash, lisp_ptr_compare,
+	        sizeof(lisp_list*), sizeof(struct macro_expansion));
 
 	lisp_register_module(rt, create_os_module(rt));
 }
@@ -34,6 +128,10 @@ void lisp_destroy(lisp_runtime *rt)
 	rt->has_marked = 0; /* ensure we sweep all */
 	lisp_sweep(rt);
 	rb_destroy(&rt->rb);
+	lisp_vstack_destroy(rt);
+	free(rt->stack);
+	free(rt->inlined);
+	ht_destroy(&rt->macro_cache);
 	lisp_free(rt, rt->nil);
 	if (rt->symcache)
 		ht_delete(rt->symcache);
@@ -70,10 +168,78 @@ void lisp_mark(lisp_runtime *rt, lisp_value *v)
  */
 static void lisp_mark_basics(lisp_runtime *rt)
 {
+	struct vstack_chunk *chunk;
+	struct lisp_frame *frame;
+	unsigned int f;
+	int i;
+
+	/* the frames of the error may be gone by the time it is printed */
+	lisp_error_trace(rt);
 	if (rt->error_stack)
 		lisp_mark(rt, (lisp_value *) rt->error_stack);
-	lisp_mark(rt, (lisp_value *) rt->stack);
+	if (rt->error_value)
+		lisp_mark(rt, rt->error_value);
+	for (f = 0; f < rt->stack_depth; f++) {
+		frame = &rt->stack[f];
+		lisp_mark(rt, frame->callable);
+		lisp_mark(rt, (lisp_value *) frame->args);
+		lisp_mark(rt, (lisp_value *) frame->scope);
+	}
 	lisp_mark(rt, (lisp_value *) rt->modules);
+	for (i = 0; i < 2; i++)
+		if (rt->booleans[i])
+			lisp_mark(rt, rt->booleans[i]);
+	for (chunk = rt->vstack; chunk; chunk = chunk->prev)
+		for (i = 0; i < chunk->top; i++)
+			if (chunk->values[i])
+				lisp_mark(rt, chunk->values[i]);
+}
+
+/*
+ * Macro expansions are only kept alive as long as their call site is. Since an
+ * expansion may itself contain call sites which have been expanded, we mark
+ * until nothing changes, and then forget the entries whose call sites are
+ * about to be freed.
+ */
+static void lisp_mark_macro_cache(lisp_runtime *rt)
+{
+	struct iterator it;
+	struct macro_expansion *exp;
+	lisp_list *site, **dead;
+	unsigned long ndead = 0, i;
+	int changed;
+
+	do {
+		changed = 0;
+		it = ht_iter_keys_ptr(&rt->macro_cache);
+		while (it.has_next(&it)) {
+			site = it.next(&it);
+			exp = ht_get(&rt->macro_cache, &site);
+			if (site->mark != GC_MARKED)
+				continue;
+			if (exp->macro->mark != GC_MARKED) {
+				lisp_mark(rt, (lisp_value *) exp->macro);
+				changed = 1;
+			}
+			if (exp->code->mark != GC_MARKED) {
+				lisp_mark(rt, exp->code);
+				changed = 1;
+			}
+		}
+		it.close(&it);
+	} while (changed);
+
+	dead = malloc(sizeof(lisp_list*) * ht_length(&rt->macro_cache));
+	it = ht_iter_keys_ptr(&rt->macro_cache);
+	while (it.has_next(&it)) {
+		site = it.next(&it);
+		if (site->mark != GC_MARKED)
+			dead[ndead++] = site;
+	}
+	it.close(&it);
+	for (i = 0; i < ndead; i++)
+		ht_remove_ptr(&rt->macro_cache, dead[i]);
+	free(dead);
 }
 
 void lisp_sweep(lisp_runtime *rt)
@@ -93,10 +259,17 @@ void lisp_sweep(lisp_runtime *rt)
 	 */
 	if (rt->has_marked) {
 		lisp_mark_basics(rt);
+		lisp_mark_macro_cache(rt);
 	} else {
 		lisp_clear_error(rt);
-		rt->stack = (lisp_list*)rt->nil;
 		rt->stack_depth = 0;
+		rt->inlined_depth = 0;
+		lisp_vstack_reset(rt);
+		rt->booleans[0] = NULL;
+		rt->booleans[1] = NULL;
+		ht_destroy(&rt->macro_cache);
+		ht_init(&rt->macro_cache, lisp_ptr_hash, lisp_ptr_compare,
+		        sizeof(lisp_list*), sizeof(struct macro_expansion));
 	}
 
 	while (curr->next) {
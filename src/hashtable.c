@@ -206,8 +206,11 @@ unsigned int ht_find_retrieve(const struct hashtable *obj, void *key)
 }
 
 /**
- * @brief Expand the hash table, adding increment to the capacity of the table.
+ * @brief Rebuild the hash table, which also clears out gravestones.
  *
+ * The table only grows when its items alone would take it past half of the
+ * maximum load factor, so a table which has had many items removed is rebuilt
+ * at the same size.
  * @param table The table to expand.
  */
 void ht_resize(struct hashtable *table)
@@ -218,8 +221,10 @@ void ht_resize(struct hashtable *table)
 	/* Step one: allocate new space for the table */
 	old_table = table->table;
 	old_allocated = table->allocated;
+	if (table->length > old_allocated * HASH_TABLE_MAX_LOAD_FACTOR / 2)
+		table->allocated = ht_next_size(old_allocated);
 	table->length = 0;
-	table->allocated = ht_next_size(old_allocated);
+	table->graves = 0;
 	table->table = calloc(table->allocated, item_size(table));
 
 	/* Step two, add the old items to the new table. */
@@ -238,12 +243,16 @@ void ht_resize(struct hashtable *table)
 /**
  * @brief Return the load factor of a hash table.
  *
+ * Gravestones count towards the load, since lookups must probe past them. If
+ * they didn't, removing and inserting items could fill every slot, and a
+ * lookup for a missing key would never find an empty one.
  * @param table The table to find the load factor of.
  * @returns The load factor of the hash table.
  */
 double ht_load_factor(struct hashtable *table)
 {
-	return ((double) table->length) / ((double) table->allocated);
+	return ((double) (table->length + table->graves)) /
+		((double) table->allocated);
 }
 
 /*
@@ -255,6 +264,7 @@ void ht_init(struct hashtable *table, hash_t hash_func, comp_t equal,
 {
 	/* Initialize values */
 	table->length = 0;
+	table->graves = 0;
 	table->allocated = HASH_TABLE_INITIAL_SIZE;
 	table->key_size = key_size;
 	table->value_size = value_size;
@@ -312,6 +322,8 @@ void ht_insert(struct hashtable *table, void *key, void *value)
 	 * gravestone.
 	 */
 	index = ht_find_insert(table, key);
+	if (mark_at(table, index) == HT_GRAVE)
+		table->graves--;
 	mark_at(table, index) = HT_FULL;
 	memcpy(key_ptr(table, index), key, table->key_size);
 	memcpy(val_ptr(table, index), value, table->value_size);
@@ -335,6 +347,7 @@ int ht_remove(struct hashtable *table, void *key)
 	/* Mark the slot with a "grave stone", indicating it is deleted. */
 	mark_at(table, index) = HT_GRAVE;
 	table->length--;
+	table->graves++;
 	return 0;
 }
 
@@ -19,6 +19,7 @@ typedef int (*print_t)(FILE *f, void *data);
 struct hashtable
 {
 	unsigned long length;    /* number of items currently in the table */
+	unsigned long graves;    /* number of slots left by removed items */
 	unsigned long allocated; /* number of items allocated */
 
 	unsigned int key_size;
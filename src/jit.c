@@ -0,0 +1,633 @@
+/*
+ * jit.c: compile hot lambdas to x86-64 machine code
+ *
+ * When enabled with lisp_enable_jit(), a lambda which has been called
+ * LISP_JIT_THRESHOLD times has its body compiled by lisp_jit_compile(). This is
+ * a template compiler: each kind of expression becomes a fixed sequence of
+ * instructions, without any register allocation or optimization across them.
+ * Integer arithmetic and comparisons, if, cond, quote, constants and calls to
+ * builtins are compiled inline, after checking that the name of the builtin
+ * still refers to it. Variables are looked up with
+ * lisp_scope_lookup(), other nodes are executed by calling their exec()
+ * function, and anything else is handed to lisp_eval().
+ *
+ * The generated function keeps the runtime in rbx and the scope in r12.
+ * Intermediate values live in stack slots below rbp, and each expression leaves
+ * its result in rax. Errors are always signalled by returning NULL, so a NULL
+ * result jumps straight to the epilogue, which returns it. The epilogue is
+ * placed at the start of the code, so that these jumps have a known target.
+ *
+ * Only x86-64 Linux is supported. Elsewhere, lisp_jit_compile() returns NULL,
+ * and lambdas are always interpreted.
+ *
+ * Stephen Brennan <stephen@brennan.io>
+ */
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_SUPPORTED
+#define _DEFAULT_SOURCE /* MAP_ANONYMOUS */
+#endif
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "funlisp_internal.h"
+
+#ifdef JIT_SUPPORTED
+
+#include <sys/mman.h>
+
+/* Registers, as encoded in instructions */
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RSI 6
+#define RDI 7
+
+/* Condition codes, the second byte of a two byte jcc */
+#define JMP 0
+#define JE  0x84
+#define JNE 0x85
+#define JO  0x80
+
+/* Size of the epilogue, which is also the offset of the entry point */
+#define EPILOGUE 9
+
+typedef void (*jit_helper)(void);
+
+struct jit {
+	lisp_runtime *rt;
+	lisp_scope *scope;
+	unsigned char *code;
+	size_t len;
+	size_t alloc;
+	int temps; /* stack slots in use */
+	int max_temps;
+};
+
+static void compile(struct jit *j, lisp_value *v);
+
+static void emit(struct jit *j, int n, ...)
+{
+	va_list ap;
+	int i;
+
+	if (j->len + n > j->alloc) {
+		j->alloc = 2 * j->alloc + n;
+		j->code = realloc(j->code, j->alloc);
+	}
+	va_start(ap, n);
+	for (i = 0; i < n; i++)
+		j->code[j->len++] = (unsigned char) va_arg(ap, int);
+	va_end(ap);
+}
+
+static void emit_bytes(struct jit *j, const void *p, size_t n)
+{
+	const unsigned char *bytes = p;
+	size_t i;
+	for (i = 0; i < n; i++)
+		emit(j, 1, bytes[i]);
+}
+
+static void emit_imm32(struct jit *j, long x)
+{
+	unsigned long u = (unsigned long) x;
+	emit(j, 4, (int) (u & 0xFF), (int) ((u >> 8) & 0xFF),
+	     (int) ((u >> 16) & 0xFF), (int) ((u >> 24) & 0xFF));
+}
+
+static void patch_imm32(struct jit *j, size_t at, long x)
+{
+	size_t len = j->len;
+	j->len = at;
+	emit_imm32(j, x);
+	j->len = len;
+}
+
+/* Offset from rbp of stack slot k (below the saved rbx and r12) */
+static long slot(int k)
+{
+	return -24 - 8L * k;
+}
+
+static void use_temps(struct jit *j, int temps)
+{
+	j->temps = temps;
+	if (temps > j->max_temps)
+		j->max_temps = temps;
+}
+
+/* mov reg, imm64 */
+static void mov_ptr(struct jit *j, int reg, const void *p)
+{
+	emit(j, 2, 0x48, 0xB8 + reg);
+	emit_bytes(j, &p, sizeof(p));
+}
+
+/* mov [rbp + slot(k)], rax */
+static void store_slot(struct jit *j, int k)
+{
+	emit(j, 3, 0x48, 0x89, 0x85);
+	emit_imm32(j, slot(k));
+}
+
+/* mov reg, [rbp + slot(k)] */
+static void load_slot(struct jit *j, int reg, int k)
+{
+	emit(j, 3, 0x48, 0x8B, 0x85 | (reg << 3));
+	emit_imm32(j, slot(k));
+}
+
+/* mov rdi, rbx; mov rsi, r12 */
+static void load_rt_scope(struct jit *j)
+{
+	emit(j, 6, 0x48, 0x89, 0xDF, 0x4C, 0x89, 0xE6);
+}
+
+/* mov r11, imm64; call r11 */
+static void call(struct jit *j, jit_helper fn)
+{
+	emit(j, 2, 0x49, 0xBB);
+	emit_bytes(j, &fn, sizeof(fn));
+	emit(j, 3, 0x41, 0xFF, 0xD3);
+}
+
+/* Emit a jump (cc is JMP or a condition code), returning where to patch it. */
+static size_t jump(struct jit *j, int cc)
+{
+	if (cc == JMP)
+		emit(j, 1, 0xE9);
+	else
+		emit(j, 2, 0x0F, cc);
+	emit_imm32(j, 0);
+	return j->len - 4;
+}
+
+static void patch(struct jit *j, size_t at, size_t target)
+{
+	patch_imm32(j, at, (long) target - (long) (at + 4));
+}
+
+/* test rax, rax; jz epilogue */
+static void check_error(struct jit *j)
+{
+	emit(j, 3, 0x48, 0x85, 0xC0);
+	patch(j, jump(j, JE), 0);
+}
+
+/*
+ * Jump if the value in rax (or rcx) is not an integer. Clobbers rdx.
+ */
+static size_t jump_not_integer(struct jit *j, int reg)
+{
+	mov_ptr(j, RDX, type_integer);
+	emit(j, 3, 0x48, 0x39, 0x10 | reg); /* cmp [reg], rdx */
+	return jump(j, JNE);
+}
+
+/*
+ * Test whether the value in rax is true, with the same rules as lisp_truthy().
+ * Both jumps must be patched to the false branch.
+ */
+static void jump_false(struct jit *j, size_t falses[2])
+{
+	size_t other, truthy;
+
+	other = jump_not_integer(j, RAX);
+	emit(j, 3, 0x48, 0x8B, 0x80); /* mov rax, [rax + x] */
+	emit_imm32(j, offsetof(lisp_integer, x));
+	emit(j, 3, 0x48, 0x85, 0xC0); /* test rax, rax */
+	falses[0] = jump(j, JE);
+	truthy = jump(j, JMP);
+
+	/* other numbers are rare enough to leave to lisp_truthy() */
+	patch(j, other, j->len);
+	emit(j, 3, 0x48, 0x89, 0xC7); /* mov rdi, rax */
+	call(j, (jit_helper) lisp_truthy);
+	emit(j, 2, 0x85, 0xC0); /* test eax, eax */
+	falses[1] = jump(j, JE);
+	patch(j, truthy, j->len);
+}
+
+static lisp_value *jit_call_builtin(lisp_runtime *rt, lisp_scope *scope,
+                                    lisp_builtin *builtin, lisp_list *args,
+                                    int argc, lisp_value **argv)
+{
+	lisp_value *rv;
+	lisp_stack_push(rt, (lisp_value *) builtin, args, scope);
+	rv = builtin->call_v(rt, scope, argc, argv, builtin->user);
+	rt->stack_depth--;
+	return rv;
+}
+
+/*
+ * Call builtin with the argc values in the slots starting at base. The first
+ * argument is in the highest slot, so that they are in order in memory.
+ */
+static void call_builtin(struct jit *j, lisp_builtin *builtin, lisp_list *args,
+                         int argc, int base)
+{
+	load_rt_scope(j);
+	mov_ptr(j, RDX, builtin);
+	mov_ptr(j, RCX, args);
+	emit(j, 2, 0x41, 0xB8); /* mov r8d, imm32 */
+	emit_imm32(j, argc);
+	emit(j, 3, 0x4C, 0x8D, 0x8D); /* lea r9, [rbp + disp32] */
+	emit_imm32(j, slot(base + argc - 1));
+	call(j, (jit_helper) jit_call_builtin);
+	check_error(j);
+}
+
+static void compile_eval(struct jit *j, lisp_value *v)
+{
+	load_rt_scope(j);
+	mov_ptr(j, RDX, v);
+	call(j, (jit_helper) lisp_eval);
+	check_error(j);
+}
+
+static void compile_lookup(struct jit *j, lisp_symbol *symbol)
+{
+	load_rt_scope(j);
+	mov_ptr(j, RDX, symbol);
+	call(j, (jit_helper) lisp_scope_lookup);
+	check_error(j);
+}
+
+/*
+ * Call sites replace their exec function as they run (see analyze.c), so the
+ * function is loaded from the node each time rather than called directly.
+ */
+static void compile_exec(struct jit *j, lisp_node *node)
+{
+	load_rt_scope(j);
+	mov_ptr(j, RDX, node);
+	emit(j, 2, 0xFF, 0x92); /* call [rdx + disp32] */
+	emit_imm32(j, offsetof(lisp_node, exec));
+	check_error(j);
+}
+
+static void compile_nil(struct jit *j)
+{
+	emit(j, 3, 0x48, 0x89, 0xDF); /* mov rdi, rbx */
+	call(j, (jit_helper) lisp_nil_new);
+}
+
+static void compile_body(struct jit *j, lisp_list *body)
+{
+	if (lisp_nil_p((lisp_value *) body))
+		compile_nil(j);
+	lisp_for_each(body) {
+		compile(j, body->left);
+	}
+}
+
+static void compile_if(struct jit *j, lisp_node *node)
+{
+	size_t falses[2], end;
+
+	compile(j, node->a);
+	jump_false(j, falses);
+	compile(j, node->b);
+	end = jump(j, JMP);
+	patch(j, falses[0], j->len);
+	patch(j, falses[1], j->len);
+	compile(j, node->c);
+	patch(j, end, j->len);
+}
+
+static void compile_clauses(struct jit *j, lisp_list *clauses)
+{
+	lisp_list *clause;
+	size_t falses[2], end;
+
+	if (lisp_nil_p((lisp_value *) clauses)) {
+		compile_nil(j);
+		return;
+	}
+
+	clause = (lisp_list *) clauses->left;
+	compile(j, clause->left);
+	jump_false(j, falses);
+	compile(j, ((lisp_list *) clause->right)->left);
+	end = jump(j, JMP);
+	patch(j, falses[0], j->len);
+	patch(j, falses[1], j->len);
+	compile_clauses(j, (lisp_list *) clauses->right);
+	patch(j, end, j->len);
+}
+
+static const int setcc[] = {
+	/* FAST_EQ */ 0x94, /* FAST_NE */ 0x95, /* FAST_LT */ 0x9C,
+	/* FAST_LE */ 0x9E, /* FAST_GT */ 0x9F, /* FAST_GE */ 0x9D,
+};
+
+/*
+ * Arithmetic and comparison on integers is done inline. Anything else (e.g.
+ * a type error, overflow into a bignum, or division) is left to the builtin.
+ */
+static void compile_fast(struct jit *j, lisp_node *node, enum lisp_fast_op op)
+{
+	lisp_builtin *builtin = (lisp_builtin *) node->c;
+	lisp_list *args = (lisp_list *) ((lisp_list *) node->form)->right;
+	int base = j->temps, argc = op == FAST_NEG ? 1 : 2;
+	size_t slow[3], done;
+	int nslow = 0;
+	jit_helper result;
+
+	use_temps(j, base + argc);
+	compile(j, node->a);
+	store_slot(j, base + argc - 1);
+	if (argc == 2) {
+		compile(j, node->b);
+		store_slot(j, base);
+	}
+
+	if (op == FAST_DIV) {
+		call_builtin(j, builtin, args, argc, base);
+		j->temps = base;
+		return;
+	}
+
+	if (op == FAST_NEG) {
+		slow[nslow++] = jump_not_integer(j, RAX);
+		emit(j, 3, 0x48, 0x8B, 0xB0); /* mov rsi, [rax + x] */
+		emit_imm32(j, offsetof(lisp_integer, x));
+		emit(j, 3, 0x48, 0xF7, 0xDE); /* neg rsi */
+		slow[nslow++] = jump(j, JO);
+	} else {
+		load_slot(j, RCX, base + 1);
+		slow[nslow++] = jump_not_integer(j, RCX);
+		emit(j, 3, 0x48, 0x39, 0x10); /* cmp [rax], rdx */
+		slow[nslow++] = jump(j, JNE);
+		emit(j, 3, 0x48, 0x8B, 0xB1); /* mov rsi, [rcx + x] */
+		emit_imm32(j, offsetof(lisp_integer, x));
+		emit(j, 3, 0x48, 0x8B, 0x80); /* mov rax, [rax + x] */
+		emit_imm32(j, offsetof(lisp_integer, x));
+	}
+
+	result = (jit_helper) lisp_integer_new;
+	switch (op) {
+	case FAST_ADD:
+		emit(j, 3, 0x48, 0x01, 0xC6); /* add rsi, rax */
+		slow[nslow++] = jump(j, JO);
+		break;
+	case FAST_SUB:
+		emit(j, 3, 0x48, 0x29, 0xC6); /* sub rsi, rax */
+		slow[nslow++] = jump(j, JO);
+		break;
+	case FAST_MUL:
+		emit(j, 4, 0x48, 0x0F, 0xAF, 0xF0); /* imul rsi, rax */
+		slow[nslow++] = jump(j, JO);
+		break;
+	case FAST_NEG:
+		break;
+	default:
+		emit(j, 3, 0x48, 0x39, 0xC6); /* cmp rsi, rax */
+		emit(j, 3, 0x0F, setcc[op - FAST_EQ], 0xC0); /* setcc al */
+		emit(j, 3, 0x0F, 0xB6, 0xF0); /* movzx esi, al */
+		result = (jit_helper) lisp_boolean;
+		break;
+	}
+	emit(j, 3, 0x48, 0x89, 0xDF); /* mov rdi, rbx */
+	call(j, result);
+	done = jump(j, JMP);
+
+	while (nslow--)
+		patch(j, slow[nslow], j->len);
+	call_builtin(j, builtin, args, argc, base);
+	patch(j, done, j->len);
+	j->temps = base;
+}
+
+/*
+ * Special forms and fast paths are guarded by a check that their operator is
+ * still the builtin they were analyzed for (see exec_guard() in analyze.c). The
+ * form is compiled behind the same check. Otherwise, the guard node runs,
+ * which evaluates the original form.
+ */
+static void compile_guard(struct jit *j, lisp_node *node)
+{
+	size_t other, done;
+
+	compile(j, node->a);
+	mov_ptr(j, RDX, node->c);
+	emit(j, 3, 0x48, 0x39, 0xD0); /* cmp rax, rdx */
+	other = jump(j, JNE);
+	compile(j, node->b);
+	done = jump(j, JMP);
+	patch(j, other, j->len);
+	compile_exec(j, node);
+	patch(j, done, j->len);
+}
+
+/*
+ * Return the builtin named by symbol, if it is an evaluated builtin using the
+ * argv calling convention.
+ */
+static lisp_builtin *known_builtin(struct jit *j, lisp_value *symbol)
+{
+	lisp_value *v;
+
+	if (symbol->type != type_symbol)
+		return NULL;
+
+	v = lisp_scope_find(j->scope, (lisp_symbol *) symbol);
+	if (!v || v->type != type_builtin)
+		return NULL;
+	if (!((lisp_builtin *) v)->call_v || !((lisp_builtin *) v)->evald)
+		return NULL;
+	return (lisp_builtin *) v;
+}
+
+/*
+ * The operator may be re-bound after we compile, so check that it is still the
+ * builtin we expect before evaluating the arguments inline. Otherwise, call it
+ * just like the interpreter would: by executing the call node, or else by
+ * calling it with the unevaluated arguments.
+ */
+static void compile_call(struct jit *j, lisp_value *op, lisp_list *args,
+                         lisp_list *raw, lisp_builtin *builtin, lisp_node *node)
+{
+	int base = j->temps, argc = lisp_list_length(args), i = 0;
+	size_t other, done;
+
+	compile(j, op);
+	mov_ptr(j, RDX, builtin);
+	emit(j, 3, 0x48, 0x39, 0xD0); /* cmp rax, rdx */
+	other = jump(j, JNE);
+
+	use_temps(j, base + argc);
+	lisp_for_each(args) {
+		compile(j, args->left);
+		store_slot(j, base + argc - 1 - i);
+		i++;
+	}
+	call_builtin(j, builtin, raw, argc, base);
+	done = jump(j, JMP);
+
+	patch(j, other, j->len);
+	if (node) {
+		compile_exec(j, node);
+	} else {
+		load_rt_scope(j);
+		emit(j, 3, 0x48, 0x89, 0xC2); /* mov rdx, rax */
+		mov_ptr(j, RCX, raw);
+		call(j, (jit_helper) lisp_call);
+		check_error(j);
+	}
+
+	patch(j, done, j->len);
+	j->temps = base;
+}
+
+static void compile_node(struct jit *j, lisp_node *node)
+{
+	enum lisp_fast_op op = lisp_builtin_fast_op(node);
+	lisp_builtin *builtin;
+
+	if (op != FAST_NONE) {
+		compile_fast(j, node, op);
+		return;
+	}
+
+	switch (lisp_node_kind(node)) {
+	case NODE_QUOTE:
+		mov_ptr(j, RAX, node->a);
+		break;
+	case NODE_IF:
+		compile_if(j, node);
+		break;
+	case NODE_COND:
+		compile_clauses(j, node->body);
+		break;
+	case NODE_PROGN:
+		compile_body(j, node->body);
+		break;
+	case NODE_GUARD:
+		compile_guard(j, node);
+		break;
+	case NODE_CALL:
+		if (node->a->type == type_node &&
+		    lisp_node_kind((lisp_node *) node->a) == NODE_GLOBAL &&
+		    (builtin = known_builtin(j, ((lisp_node *) node->a)->a)))
+			compile_call(j, node->a, node->body, (lisp_list *) node->b,
+			             builtin, node);
+		else
+			compile_exec(j, node);
+		break;
+	default:
+		compile_exec(j, node);
+		break;
+	}
+}
+
+static void compile(struct jit *j, lisp_value *v)
+{
+	lisp_list *form = (lisp_list *) v;
+	lisp_builtin *builtin;
+
+	if (v->type == type_node) {
+		compile_node(j, (lisp_node *) v);
+	} else if (v->type == type_symbol) {
+		compile_lookup(j, (lisp_symbol *) v);
+	} else if (lisp_is_number(v) || v->type == type_string) {
+		mov_ptr(j, RAX, v);
+	} else if (v->type == type_list && !lisp_nil_p(v) &&
+	           !lisp_is_bad_list(form) &&
+	           (builtin = known_builtin(j, form->left))) {
+		compile_call(j, form->left, (lisp_list *) form->right,
+		             (lisp_list *) form->right, builtin, NULL);
+	} else {
+		compile_eval(j, v);
+	}
+}
+
+lisp_jit_func lisp_jit_compile(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_list *code, size_t *size)
+{
+	struct jit j;
+	size_t frame;
+	unsigned char *mem, *entry;
+	lisp_jit_func func;
+
+	j.rt = rt;
+	j.scope = scope;
+	j.code = NULL;
+	j.len = j.alloc = 0;
+	j.temps = j.max_temps = 0;
+
+	/* epilogue: lea rsp, [rbp - 16]; pop r12; pop rbx; pop rbp; ret */
+	emit(&j, EPILOGUE, 0x48, 0x8D, 0x65, 0xF0, 0x41, 0x5C, 0x5B, 0x5D, 0xC3);
+
+	/* prologue: push rbp; mov rbp, rsp; push rbx; push r12; sub rsp, ... */
+	emit(&j, 9, 0x55, 0x48, 0x89, 0xE5, 0x53, 0x41, 0x54, 0x48, 0x81);
+	emit(&j, 1, 0xEC);
+	frame = j.len;
+	emit_imm32(&j, 0);
+	/* mov rbx, rdi; mov r12, rsi */
+	emit(&j, 6, 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4);
+
+	compile_body(&j, code);
+	patch(&j, jump(&j, JMP), 0);
+
+	/* keep rsp 16-byte aligned for calls */
+	patch_imm32(&j, frame, (j.max_temps * 8 + 15) / 16 * 16);
+
+	mem = mmap(NULL, j.len, PROT_READ | PROT_WRITE,
+	           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) {
+		free(j.code);
+		return NULL;
+	}
+	memcpy(mem, j.code, j.len);
+	free(j.code);
+	if (mprotect(mem, j.len, PROT_READ | PROT_EXEC) != 0) {
+		munmap(mem, j.len);
+		return NULL;
+	}
+
+	*size = j.len;
+	entry = mem + EPILOGUE;
+	memcpy(&func, &entry, sizeof(func));
+	return func;
+}
+
+void lisp_jit_free(lisp_jit_func func, size_t size)
+{
+	unsigned char *entry;
+	memcpy(&entry, &func, sizeof(entry));
+	munmap(entry - EPILOGUE, size);
+}
+
+#else
+
+lisp_jit_func lisp_jit_compile(lisp_runtime *rt, lisp_scope *scope,
+                               lisp_list *code, size_t *size)
+{
+	(void) rt;
+	(void) scope;
+	(void) code;
+	(void) size;
+	return NULL;
+}
+
+void lisp_jit_free(lisp_jit_func func, size_t size)
+{
+	(void) func;
+	(void) size;
+}
+
+#endif
+
+void lisp_enable_jit(lisp_runtime *rt)
+{
+	rt->jit = 1;
+}
+
+void lisp_disable_jit(lisp_runtime *rt)
+{
+	rt->jit = 0;
+}
@@ -7,7 +7,7 @@
 #include "funlisp_internal.h"
 
 static lisp_value *lisp_os_getenv(lisp_runtime *rt, lisp_scope *scope,
-                                  lisp_list *arguments, void *user)
+                                  int argc, lisp_value **argv, void *user)
 {
 	lisp_string *str;
 	char *res;
@@ -16,7 +16,7 @@ static lisp_value *lisp_os_getenv(lisp_runtime *rt, lisp_scope *scope,
 	(void) user;
 	(void) scope;
 
-	if (!lisp_get_args(rt, arguments, "S", &str))
+	if (!lisp_get_args_v(rt, argc, argv, "S", &str))
 		return NULL;
 
 	res = getenv(str->s);
@@ -31,7 +31,7 @@ lisp_module *create_os_module(lisp_runtime *rt)
 
 	lisp_module *m = lisp_new_module(rt, lisp_string_new(rt, "os", 0),
 		lisp_string_new(rt, __FILE__, 0));
-	lisp_scope_add_builtin(rt, m->contents, "getenv", lisp_os_getenv, NULL, 1);
+	lisp_scope_add_builtin_v(rt, m->contents, "getenv", lisp_os_getenv, NULL, 1);
 	return m;
 }
 
@@ -58,6 +58,7 @@ lisp_module *lisp_new_module(lisp_runtime *rt, lisp_string *name, lisp_string *f
 	m->name = name;
 	m->file = file;
 	m->contents = lisp_new_empty_scope(rt);
+	m->contents->global = 1;
 	return m;
 }
 
@@ -74,6 +75,7 @@ lisp_module *lisp_import_file(lisp_runtime *rt, lisp_string *name, lisp_string *
 	lisp_module *module;
 	lisp_value *v;
 	modscope->up = builtins;
+	modscope->global = 1;
 
 	f = fopen(file->s, "r");
 	if (!f) {
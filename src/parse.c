@@ -35,17 +35,45 @@ typedef struct {
 
 static result lisp_parse_value_internal(lisp_runtime *rt, char *input, int index);
 
-static result lisp_parse_integer(lisp_runtime *rt, char *input, int index)
+/*
+ * Return the line number of index within input. The parser mostly moves
+ * forward, so we count newlines from where we were last time, starting over
+ * when given different input or an earlier index.
+ */
+static unsigned int line_at(lisp_runtime *rt, char *input, int index)
 {
-	int n, rv;
-	lisp_integer *v = (lisp_integer*)lisp_new(rt, type_integer);
-	rv = sscanf(input + index, "%d%n", &v->x, &n);
-	if (rv != 1) {
-		rt->error = "syntax error: error parsing integer";
-		return_result_err(NULL, index, LE_SYNTAX);
-	} else {
-		return_result(v, index + n);
+	if (input != rt->parse_input || index < rt->parse_index) {
+		rt->parse_input = input;
+		rt->parse_index = 0;
+		rt->parse_line = 1;
+	}
+	for (; rt->parse_index < index; rt->parse_index++)
+		if (input[rt->parse_index] == '\n')
+			rt->parse_line++;
+	return rt->parse_line;
+}
+
+/*
+ * Digits are an integer, unless followed by a fraction (a decimal point and
+ * digits) or an exponent (e, an optional sign, and digits), which make them a
+ * float.
+ */
+static result lisp_parse_number(lisp_runtime *rt, char *input, int index)
+{
+	char *s = input + index, *end;
+	int n = 0;
+
+	while (isdigit(s[n]))
+		n++;
+
+	if ((s[n] == '.' && isdigit(s[n + 1])) ||
+	    ((s[n] == 'e' || s[n] == 'E') &&
+	     (isdigit(s[n + 1]) ||
+	      ((s[n + 1] == '+' || s[n + 1] == '-') && isdigit(s[n + 2]))))) {
+		lisp_float *f = lisp_float_new(rt, strtod(s, &end));
+		return_result(f, end - input);
 	}
+	return_result(lisp_bignum_parse(rt, s, n, 0), index + n);
 }
 
 static int skip_space_and_comments(char *input, int index)
@@ -131,9 +159,10 @@ static result lisp_parse_list_or_sexp(lisp_runtime *rt, char *input, int index)
 	r = lisp_parse_value_internal(rt, input, index);
 	if (r.error) return r;
 	else if (!r.result) return_result_err(NULL, r.index, 1);
-	index = r.index;
 	rv = (lisp_list*)lisp_new(rt, type_list);
+	rv->line = line_at(rt, input, index);
 	rv->left = r.result;
+	index = r.index;
 	l = rv;
 
 	while (true) {
@@ -305,36 +334,34 @@ static result lisp_parse_value_internal(lisp_runtime *rt, char *input, int index
 		return lisp_parse_quote(rt, input, index);
 	default:
 		if (isdigit(input[index])) {
-			return lisp_parse_integer(rt, input, index);
+			return lisp_parse_number(rt, input, index);
 		} else {
 			return lisp_parse_symbol(rt, input, index);
 		}
 	}
 }
 
-static void set_error_lineno(lisp_runtime *rt, char *input, int index)
-{
-	int i;
-	rt->error_line = 1;
-	for (i = 0; i < index; i++)
-		if (input[i] == '\n')
-			rt->error_line++;
-}
-
-int lisp_parse_value(lisp_runtime *rt, char *input, int index, lisp_value **output)
+static int parse_value(lisp_runtime *rt, char *input, int index,
+                       lisp_value **output)
 {
 	int bytes;
 	result r = lisp_parse_value_internal(rt, input, index);
 	bytes = r.index - index;
 	if (r.error) {
 		rt->err_num = r.error;
-		set_error_lineno(rt, input, r.index);
+		rt->error_line = line_at(rt, input, r.index);
 		bytes = -1;
 	}
 	*output = r.result;
 	return bytes;
 }
 
+int lisp_parse_value(lisp_runtime *rt, char *input, int index, lisp_value **output)
+{
+	rt->parse_input = NULL; /* the input may be new, at the same address */
+	return parse_value(rt, input, index, output);
+}
+
 lisp_value *lisp_parse_progn(lisp_runtime *rt, char *input)
 {
 	lisp_list *final_result, *prev;
@@ -344,8 +371,9 @@ lisp_value *lisp_parse_progn(lisp_runtime *rt, char *input)
 	final_result = (lisp_list*) lisp_new(rt, type_list);
 	final_result->left = (lisp_value*)lisp_symbol_new(rt, "progn", 0);
 	prev = final_result;
+	rt->parse_input = NULL;
 	for (;;) {
-		bytes = lisp_parse_value(rt, input, index, &expression);
+		bytes = parse_value(rt, input, index, &expression);
 		index += bytes;
 		if (bytes < 0) {
 			return NULL; /* error! */
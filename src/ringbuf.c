@@ -32,7 +32,7 @@ void rb_grow(struct ringbuf *rb)
 		if (oldindex != newindex) {
 			memcpy((char*) rb->data + newindex * rb->dsize,
 			       (char*) rb->data + oldindex * rb->dsize,
-			       rb->nalloc);
+			       rb->dsize);
 		}
 	}
 }
@@ -137,6 +137,82 @@ int lisp_text_compare(void *left, void *right)
 	return strcmp((*sym1)->s, (*sym2)->s);
 }
 
+unsigned int lisp_ptr_hash(void *p)
+{
+	/* objects are at least word aligned, so drop the low bits */
+	return (unsigned int) ((unsigned long) *(void**)p >> 3);
+}
+
+int lisp_ptr_compare(void *left, void *right)
+{
+	return *(void**)left != *(void**)right;
+}
+
+/*
+ * Hash a value so that values which are equal? hash the same. Types which have
+ * no hash of their own (lambdas, scopes, hash maps...) are compared by their
+ * contents, so they can only hash by type.
+ */
+static unsigned int value_hash(lisp_value *v)
+{
+	unsigned int h = 0;
+	unsigned long x;
+	double d;
+	unsigned char *bytes;
+	size_t i;
+	int j;
+
+	if (v->type == type_integer) {
+		x = (unsigned long) ((lisp_integer *) v)->x;
+		return (unsigned int) (x ^ (x >> 16 >> 16));
+	} else if (v->type == type_symbol || v->type == type_string) {
+		return ht_string_hash(&((struct lisp_text *) v)->s);
+	} else if (v->type == type_bignum) {
+		h = ((lisp_bignum *) v)->negative;
+		for (j = 0; j < ((lisp_bignum *) v)->len; j++)
+			h = h * 31 + ((lisp_bignum *) v)->limbs[j];
+		return h;
+	} else if (v->type == type_float) {
+		/* -0.0 and 0.0 are equal, but have different bits */
+		d = ((lisp_float *) v)->x;
+		if (d == 0)
+			d = 0;
+		bytes = (unsigned char *) &d;
+		for (i = 0; i < sizeof(d); i++)
+			h = h * 31 + bytes[i];
+		return h;
+	} else if (v->type == type_list) {
+		while (v->type == type_list && !lisp_nil_p(v)) {
+			h = h * 31 + value_hash(((lisp_list *) v)->left);
+			v = ((lisp_list *) v)->right;
+		}
+		return v->type == type_list ? h : h * 31 + value_hash(v);
+	} else if (v->type == type_vector) {
+		for (j = 0; j < ((lisp_vector *) v)->len; j++)
+			h = h * 31 + value_hash(((lisp_vector *) v)->items[j]);
+		return h;
+	} else if (v->type == type_rope) {
+		/* the same as a string with the same text, which is equal */
+		struct charbuf cb;
+		cb_init(&cb, ((lisp_rope *) v)->length + 1);
+		lisp_rope_flatten(&cb, v);
+		h = ht_string_hash(&cb.buf);
+		cb_destroy(&cb);
+		return h;
+	}
+	return lisp_ptr_hash(&v->type);
+}
+
+unsigned int lisp_value_hash(void *p)
+{
+	return value_hash(*(lisp_value **) p);
+}
+
+int lisp_value_compare(void *left, void *right)
+{
+	return !lisp_compare(*(lisp_value **) left, *(lisp_value **) right);
+}
+
 static lisp_value *scope_new(lisp_runtime *rt)
 {
 	lisp_scope *scope;
@@ -144,6 +220,7 @@ static lisp_value *scope_new(lisp_runtime *rt)
 
 	scope = malloc(sizeof(lisp_scope));
 	scope->up = NULL;
+	scope->global = 0;
 	ht_init(&scope->scope, lisp_text_hash, lisp_text_compare, sizeof(void*), sizeof(void*));
 	return (lisp_value*)scope;
 }
@@ -151,9 +228,16 @@ static lisp_value *scope_new(lisp_runtime *rt)
 static void scope_free(lisp_runtime *rt, void *v)
 {
 	lisp_scope *scope;
+	struct iterator it;
 	(void) rt; /* unused */
 
 	scope = (lisp_scope*) v;
+	if (scope->global) {
+		it = ht_iter_values_ptr(&scope->scope);
+		while (it.has_next(&it))
+			free(it.next(&it));
+		it.close(&it);
+	}
 	ht_destroy(&scope->scope);
 	free(scope);
 }
@@ -164,16 +248,51 @@ static void scope_print(FILE *f, lisp_value *v)
 	struct iterator it = ht_iter_keys_ptr(&scope->scope);
 	fprintf(f, "(scope:");
 	while (it.has_next(&it)) {
-		lisp_value *key = it.next(&it);
-		lisp_value *value = ht_get_ptr(&scope->scope, key);
+		lisp_symbol *key = it.next(&it);
+		lisp_value *value = lisp_scope_get(scope, key);
 		fprintf(f, " ");
-		lisp_print(f, key);
+		lisp_print(f, (lisp_value *) key);
 		fprintf(f, ": ");
 		lisp_print(f, value);
 	}
 	fprintf(f, ")");
 }
 
+/* Yield the value within each cell of a global scope */
+static bool cell_values_has_next(struct iterator *it)
+{
+	struct iterator *cells = it->state_ptr;
+	return cells->has_next(cells);
+}
+
+static void *cell_values_next(struct iterator *it)
+{
+	struct iterator *cells = it->state_ptr;
+	return ((struct lisp_cell *) cells->next(cells))->value;
+}
+
+static void cell_values_close(struct iterator *it)
+{
+	struct iterator *cells = it->state_ptr;
+	cells->close(cells);
+	free(cells);
+}
+
+static struct iterator scope_values(lisp_scope *scope)
+{
+	struct iterator it = {0};
+
+	if (!scope->global)
+		return ht_iter_values_ptr(&scope->scope);
+
+	it.state_ptr = malloc(sizeof(struct iterator));
+	*(struct iterator *) it.state_ptr = ht_iter_values_ptr(&scope->scope);
+	it.has_next = cell_values_has_next;
+	it.next = cell_values_next;
+	it.close = cell_values_close;
+	return it;
+}
+
 static struct iterator scope_expand(lisp_value *v)
 {
 	lisp_scope *scope = (lisp_scope *) v;
@@ -181,12 +300,12 @@ static struct iterator scope_expand(lisp_value *v)
 		return iterator_concat3(
 			iterator_single_value(scope->up),
 			ht_iter_keys_ptr(&scope->scope),
-			ht_iter_values_ptr(&scope->scope)
+			scope_values(scope)
 		);
 	} else {
 		return iterator_concat2(
 			ht_iter_keys_ptr(&scope->scope),
-			ht_iter_values_ptr(&scope->scope)
+			scope_values(scope)
 		);
 	}
 }
@@ -226,13 +345,13 @@ static int scope_compare(lisp_value *self, lisp_value *other)
 	it = ht_iter_keys_ptr(&lhs->scope);
 	while (it.has_next(&it)) {
 		key = (lisp_symbol*) it.next(&it);
-		rhs_value = (lisp_value*) ht_get_ptr(&rhs->scope, key);
+		rhs_value = lisp_scope_get(rhs, key);
 		if (!rhs_value) {
 			/* key not in other scope */
 			it.close(&it);
 			return 0;
 		}
-		value = (lisp_value*) ht_get_ptr(&lhs->scope, key);
+		value = lisp_scope_get(lhs, key);
 		if (!lisp_compare(value, rhs_value)) {
 			it.close(&it);
 			return 0;
@@ -313,6 +432,7 @@ static lisp_value *list_new(lisp_runtime *rt)
 	(void) rt; /* unused */
 
 	list = malloc(sizeof(lisp_list));
+	list->line = 0;
 	list->left = NULL;
 	list->right = NULL;
 	return (lisp_value*) list;
@@ -447,6 +567,8 @@ static int text_compare(lisp_value *self, lisp_value *other)
 	struct lisp_text *lhs, *rhs;
 	if (self == other)
 		return 1;
+	if (self->type == type_string && other->type == type_rope)
+		return lisp_compare(other, self);
 	if (self->type != other->type)
 		return 0;
 	lhs = (struct lisp_text*) self;
@@ -478,7 +600,7 @@ lisp_type *type_integer = &type_integer_obj;
 static void integer_print(FILE *f, lisp_value *v)
 {
 	lisp_integer *integer = (lisp_integer*) v;
-	fprintf(f, "%d", integer->x);
+	fprintf(f, "%ld", integer->x);
 }
 
 static lisp_value *integer_new(lisp_runtime *rt)
@@ -503,6 +625,144 @@ static int integer_compare(lisp_value *self, lisp_value *other)
 	return lhs->x == rhs->x;
 }
 
+/*
+ * bignum
+ */
+
+static void bignum_print(FILE *f, lisp_value *v);
+static lisp_value *bignum_new(lisp_runtime *rt);
+static void bignum_free(lisp_runtime *rt, void *v);
+static int bignum_compare(lisp_value *self, lisp_value *other);
+
+static lisp_type type_bignum_obj = {
+	TYPE_HEADER,
+	/* name */ "bignum",
+	/* print */ bignum_print,
+	/* new */ bignum_new,
+	/* free */ bignum_free,
+	/* expand */ iterator_empty,
+	/* eval */ eval_same,
+	/* call */ call_error,
+	/* compare */ bignum_compare,
+};
+lisp_type *type_bignum = &type_bignum_obj;
+
+static void bignum_print(FILE *f, lisp_value *v)
+{
+	lisp_bignum_print(f, (lisp_bignum *) v);
+}
+
+static lisp_value *bignum_new(lisp_runtime *rt)
+{
+	lisp_bignum *bignum;
+	(void) rt; /* unused */
+
+	bignum = malloc(sizeof(lisp_bignum));
+	bignum->negative = 0;
+	bignum->len = 0;
+	bignum->limbs = NULL;
+	return (lisp_value *) bignum;
+}
+
+static void bignum_free(lisp_runtime *rt, void *v)
+{
+	lisp_bignum *bignum = (lisp_bignum *) v;
+	(void) rt; /* unused */
+
+	free(bignum->limbs);
+	free(bignum);
+}
+
+static int bignum_compare(lisp_value *self, lisp_value *other)
+{
+	if (self == other)
+		return 1;
+	if (self->type != other->type || self->type != type_bignum)
+		return 0;
+	return lisp_bignum_cmp(self, other) == 0;
+}
+
+/*
+ * float
+ */
+
+static void float_print(FILE *f, lisp_value *v);
+static lisp_value *float_new(lisp_runtime *rt);
+static int float_compare(lisp_value *self, lisp_value *other);
+
+static lisp_type type_float_obj = {
+	TYPE_HEADER,
+	/* name */ "float",
+	/* print */ float_print,
+	/* new */ float_new,
+	/* free */ simple_free,
+	/* expand */ iterator_empty,
+	/* eval */ eval_same,
+	/* call */ call_error,
+	/* compare */ float_compare,
+};
+lisp_type *type_float = &type_float_obj;
+
+/*
+ * Format the fewest digits which read back as the same value, and always with
+ * a decimal point or exponent, so that it reads back as a float. Exponents
+ * below 17 are written out in full, so 100.0 isn't printed as 1e+02.
+ * Infinities print as inf or -inf, and NaN always as nan, which don't read
+ * back.
+ */
+void lisp_float_format(char *buf, double x)
+{
+	int precision, exponent;
+	char *e;
+
+	/* printf may give NaN a sign, which means nothing */
+	if (x != x) {
+		strcpy(buf, "nan");
+		return;
+	}
+
+	/* 17 digits always suffice for a double */
+	for (precision = 1; precision < 17; precision++) {
+		sprintf(buf, "%.*g", precision, x);
+		if (strtod(buf, NULL) == x)
+			break;
+	}
+	if (precision == 17)
+		sprintf(buf, "%.17g", x);
+	e = strchr(buf, 'e');
+	if (e && (exponent = atoi(e + 1)) >= 0 && exponent < 17)
+		sprintf(buf, "%.*f",
+		        precision > exponent ? precision - exponent - 1 : 0, x);
+	if (!strpbrk(buf, ".eni"))
+		strcat(buf, ".0");
+}
+
+static void float_print(FILE *f, lisp_value *v)
+{
+	char buf[LISP_FLOAT_BUFSIZE];
+	lisp_float_format(buf, ((lisp_float *) v)->x);
+	fputs(buf, f);
+}
+
+static lisp_value *float_new(lisp_runtime *rt)
+{
+	lisp_float *f;
+	(void) rt; /* unused */
+
+	f = malloc(sizeof(lisp_float));
+	f->x = 0;
+	return (lisp_value *) f;
+}
+
+static int float_compare(lisp_value *self, lisp_value *other)
+{
+	if (self == other)
+		return 1;
+	if (self->type != other->type || self->type != type_float)
+		return 0;
+	return ((lisp_float *) self)->x == ((lisp_float *) other)->x;
+}
+
 /* string */
 
 static lisp_type type_string_obj = {
@@ -554,16 +814,51 @@ static lisp_value *builtin_new(lisp_runtime *rt)
 
 	builtin = malloc(sizeof(lisp_builtin));
 	builtin->call = NULL;
+	builtin->call_v = NULL;
 	builtin->name = NULL;
 	builtin->evald = 0;
 	return (lisp_value*) builtin;
 }
 
+/*
+ * Call a builtin which takes an array, placing its arguments on the value
+ * stack rather than in a new list.
+ */
+static lisp_value *builtin_call_v(lisp_runtime *rt, lisp_scope *scope,
+                                  lisp_builtin *builtin, lisp_list *arguments)
+{
+	lisp_value **argv, *rv;
+	int argc, i = 0;
+
+	if (lisp_is_bad_list(arguments))
+		return lisp_error(rt, LE_SYNTAX, "unexpected cons cell");
+
+	argc = lisp_list_length(arguments);
+	argv = lisp_vstack_push(rt, argc);
+	lisp_for_each(arguments) {
+		if (builtin->evald) {
+			argv[i] = lisp_eval(rt, scope, arguments->left);
+			if (!argv[i]) {
+				lisp_vstack_pop(rt, argc);
+				return NULL;
+			}
+		} else {
+			argv[i] = arguments->left;
+		}
+		i++;
+	}
+	rv = builtin->call_v(rt, scope, argc, argv, builtin->user);
+	lisp_vstack_pop(rt, argc);
+	return rv;
+}
+
 static lisp_value *builtin_call(lisp_runtime *rt, lisp_scope *scope,
                                 lisp_value *c, lisp_list *arguments)
 {
 	lisp_builtin *builtin = (lisp_builtin*) c;
-	if (builtin->evald) {
+	if (builtin->call_v) {
+		return builtin_call_v(rt, scope, builtin, arguments);
+	} else if (builtin->evald) {
 		arguments = lisp_eval_list(rt, scope, arguments);
 		lisp_error_check(arguments);
 	} else if (lisp_is_bad_list(arguments)) {
@@ -585,6 +880,7 @@ static int builtin_compare(lisp_value *self, lisp_value *other)
 	rhs = (lisp_builtin*) other;
 	return (
 		lhs->call == rhs->call
+		&& lhs->call_v == rhs->call_v
 		&& lhs->user == rhs->user
 		&& lhs->evald == rhs->evald
 		&& strcmp(lhs->name, rhs->name) == 0
@@ -597,6 +893,7 @@ static int builtin_compare(lisp_value *self, lisp_value *other)
 
 static void lambda_print(FILE *f, lisp_value *v);
 static lisp_value *lambda_new(lisp_runtime *rt);
+static void lambda_free(lisp_runtime *rt, void *v);
 static lisp_value *lambda_call(lisp_runtime *rt, lisp_scope *scope,
                                lisp_value *c, lisp_list *arguments);
 static struct iterator lambda_expand(lisp_value *v);
@@ -607,7 +904,7 @@ static lisp_type type_lambda_obj = {
 	/* name */ "lambda",
 	/* print */ lambda_print,
 	/* new */ lambda_new,
-	/* free */ simple_free,
+	/* free */ lambda_free,
 	/* expand */ lambda_expand,
 	/* eval */ eval_error,
 	/* call */ lambda_call,
@@ -637,27 +934,119 @@ static lisp_value *lambda_new(lisp_runtime *rt)
 	lambda->closure = NULL;
 	lambda->first_binding = NULL;
 	lambda->lambda_type = TP_LAMBDA;
+	lambda->calls = 0;
+	lambda->jit = NULL;
+	lambda->jit_size = 0;
 	return (lisp_value*) lambda;
 }
 
+static void lambda_free(lisp_runtime *rt, void *v)
+{
+	lisp_lambda *lambda = (lisp_lambda *) v;
+	(void) rt;
+	if (lambda->jit)
+		lisp_jit_free(lambda->jit, lambda->jit_size);
+	free(lambda);
+}
+
+/* Run the body of a lambda, once its arguments are bound in inner */
+static lisp_value *lambda_run(lisp_runtime *rt, lisp_lambda *lambda,
+                              lisp_scope *inner)
+{
+	if (rt->jit && lambda->calls < LISP_JIT_THRESHOLD &&
+	    ++lambda->calls == LISP_JIT_THRESHOLD)
+		lambda->jit = lisp_jit_compile(rt, inner, lambda->code,
+		                               &lambda->jit_size);
+
+	if (lambda->jit)
+		return lambda->jit(rt, inner);
+	return lisp_progn(rt, inner, lambda->code);
+}
+
+lisp_value *lisp_lambda_call_v(lisp_runtime *rt, lisp_lambda *lambda,
+                               int argc, lisp_value **argv)
+{
+	lisp_list *it = lambda->args;
+	lisp_scope *inner;
+	int i;
+
+	inner = (lisp_scope*)lisp_new(rt, type_scope);
+	inner->up = lambda->closure;
+
+	for (i = 0; i < argc && !lisp_nil_p((lisp_value*)it); i++) {
+		lisp_scope_bind(inner, (lisp_symbol*) it->left, argv[i]);
+		it = (lisp_list*) it->right;
+	}
+
+	if (!lisp_nil_p((lisp_value*)it)) {
+		return lisp_error(rt, LE_2FEW, "not enough arguments to lambda call");
+	}
+	if (i < argc) {
+		return lisp_error(rt, LE_2MANY, "too many arguments to lambda call");
+	}
+	return lambda_run(rt, lambda, inner);
+}
+
+lisp_value *lisp_lambda_call_verified(lisp_runtime *rt, lisp_lambda *lambda,
+                                      lisp_value **argv)
+{
+	lisp_list *it = lambda->args;
+	lisp_scope *inner;
+
+	inner = (lisp_scope*)lisp_new(rt, type_scope);
+	inner->up = lambda->closure;
+	lisp_for_each(it)
+		lisp_scope_bind(inner, (lisp_symbol*) it->left, *argv++);
+	return lambda_run(rt, lambda, inner);
+}
+
+/*
+ * Lambdas evaluate their arguments onto the value stack, the same as builtins
+ * which take an array.
+ */
+static lisp_value *lambda_call_v(lisp_runtime *rt, lisp_scope *scope,
+                                 lisp_lambda *lambda, lisp_list *arguments)
+{
+	lisp_value **argv, *rv;
+	int argc, i = 0;
+
+	if (lisp_is_bad_list(arguments))
+		return lisp_error(rt, LE_SYNTAX, "unexpected cons cell");
+
+	argc = lisp_list_length(arguments);
+	argv = lisp_vstack_push(rt, argc);
+	lisp_for_each(arguments) {
+		argv[i] = lisp_eval(rt, scope, arguments->left);
+		if (!argv[i]) {
+			lisp_vstack_pop(rt, argc);
+			return NULL;
+		}
+		i++;
+	}
+	rv = lisp_lambda_call_v(rt, lambda, argc, argv);
+	lisp_vstack_pop(rt, argc);
+	return rv;
+}
+
 static lisp_value *lambda_call(lisp_runtime *rt, lisp_scope *scope,
                                lisp_value *c, lisp_list *arguments)
 {
 	lisp_lambda *lambda = (lisp_lambda*) c;
-	lisp_list *argvalues, *it1, *it2;
+	lisp_list *it1, *it2;
 	lisp_scope *inner;
 	lisp_value *result;
+	struct macro_expansion *cached, expansion;
 
-	if (lambda->lambda_type == TP_MACRO) {
-		/* macros receive their arguments un-evaluated */
-		argvalues = arguments;
-	} else {
-		/* lambdas evaluate their arguments */
-		argvalues = lisp_eval_list(rt, scope, arguments);
-		lisp_error_check(argvalues);
-	}
+	if (lambda->lambda_type == TP_LAMBDA)
+		return lambda_call_v(rt, scope, lambda, arguments);
 
-	if (lisp_is_bad_list(argvalues)) {
+	/* a call site only needs to be expanded once per macro */
+	cached = ht_get(&rt->macro_cache, &arguments);
+	if (cached && cached->macro == lambda)
+		return lisp_eval(rt, scope, cached->code);
+
+	/* macros receive their arguments un-evaluated */
+	if (lisp_is_bad_list(arguments)) {
 		return lisp_error(rt, LE_SYNTAX, "unexpected cons cell");
 	}
 
@@ -665,7 +1054,7 @@ static lisp_value *lambda_call(lisp_runtime *rt, lisp_scope *scope,
 	inner->up = lambda->closure;
 
 	it1 = lambda->args;
-	it2 = argvalues;
+	it2 = arguments;
 	while (!lisp_nil_p((lisp_value*)it1) && !lisp_nil_p((lisp_value*)it2)) {
 		lisp_scope_bind(inner, (lisp_symbol*) it1->left, it2->left);
 		it1 = (lisp_list*) it1->right;
@@ -682,12 +1071,12 @@ static lisp_value *lambda_call(lisp_runtime *rt, lisp_scope *scope,
 	result = lisp_progn(rt, inner, lambda->code);
 	lisp_error_check(result);
 
-	if (lambda->lambda_type == TP_MACRO) {
-		/* for macros, we've now evaluated the macro to get code, now
-		 * evaluate the code */
-		result = lisp_eval(rt, scope, result);
-	}
-	return result;
+	/* for macros, we've now evaluated the macro to get code, now evaluate
+	 * the code */
+	expansion.macro = lambda;
+	expansion.code = result;
+	ht_insert(&rt->macro_cache, &arguments, &expansion);
+	return lisp_eval(rt, scope, result);
 }
 
 static void *lambda_expand_next(struct iterator *it)
@@ -739,6 +1128,113 @@ static int lambda_compare(lisp_value *self, lisp_value *other)
 	);
 }
 
+/*
+ * node
+ */
+
+static void node_print(FILE *f, lisp_value *v);
+static lisp_value *node_new(lisp_runtime *rt);
+static lisp_value *node_eval(lisp_runtime *rt, lisp_scope *scope,
+                             lisp_value *v);
+static struct iterator node_expand(lisp_value *v);
+static int node_compare(lisp_value *self, lisp_value *other);
+
+static lisp_type type_node_obj = {
+	TYPE_HEADER,
+	/* name */ "node",
+	/* print */ node_print,
+	/* new */ node_new,
+	/* free */ simple_free,
+	/* expand */ node_expand,
+	/* eval */ node_eval,
+	/* call */ call_error,
+	/* compare */ node_compare,
+};
+lisp_type *type_node = &type_node_obj;
+
+static void node_print(FILE *f, lisp_value *v)
+{
+	lisp_node *node = (lisp_node *) v;
+	lisp_print(f, node->form);
+}
+
+static lisp_value *node_new(lisp_runtime *rt)
+{
+	lisp_node *node;
+	(void) rt; /* unused */
+
+	node = malloc(sizeof(lisp_node));
+	node->exec = NULL;
+	node->form = NULL;
+	node->a = NULL;
+	node->b = NULL;
+	node->c = NULL;
+	node->body = NULL;
+	node->n = 0;
+	node->cache = NULL;
+	return (lisp_value*) node;
+}
+
+static lisp_value *node_eval(lisp_runtime *rt, lisp_scope *scope,
+                             lisp_value *v)
+{
+	lisp_node *node = (lisp_node *) v;
+	return node->exec(rt, scope, node);
+}
+
+static lisp_value *node_field(lisp_node *node, int index)
+{
+	switch (index) {
+	case 0:
+		return node->form;
+	case 1:
+		return node->a;
+	case 2:
+		return node->b;
+	case 3:
+		return node->c;
+	case 4:
+		return (lisp_value *) node->body;
+	default:
+		return NULL;
+	}
+}
+
+/* fields may be NULL, so skip over those without yielding them */
+static bool node_has_next(struct iterator *it)
+{
+	lisp_node *node = (lisp_node *) it->ds;
+	while (it->index < it->state_int && !node_field(node, it->index))
+		it->index++;
+	return it->index < it->state_int;
+}
+
+static void *node_expand_next(struct iterator *it)
+{
+	return node_field((lisp_node *) it->ds, it->index++);
+}
+
+static struct iterator node_expand(lisp_value *v)
+{
+	struct iterator it = {0};
+	it.ds = v;
+	it.state_int = 5;
+	it.index = 0;
+	it.next = node_expand_next;
+	it.has_next = node_has_next;
+	it.close = iterator_close_noop;
+	return it;
+}
+
+static int node_compare(lisp_value *self, lisp_value *other)
+{
+	if (self == other)
+		return 1;
+	if (self->type != other->type || self->type != type_node)
+		return 0;
+	return lisp_compare(((lisp_node*)self)->form, ((lisp_node*)other)->form);
+}
+
 /*
  * some shortcuts for accessing these type methods on lisp values
  */
@@ -758,19 +1254,92 @@ lisp_value *lisp_eval(lisp_runtime *rt, lisp_scope *scope, lisp_value *value)
 	return value->type->eval(rt, scope, value);
 }
 
+void lisp_stack_push(lisp_runtime *rt, lisp_value *callable, lisp_list *args,
+                     lisp_scope *scope)
+{
+	struct lisp_frame *frame;
+
+	if (rt->stack_depth >= rt->stack_alloc) {
+		rt->stack_alloc *= 2;
+		rt->stack = realloc(rt->stack,
+			sizeof(struct lisp_frame) * rt->stack_alloc);
+	}
+	frame = &rt->stack[rt->stack_depth++];
+	frame->callable = callable;
+	frame->args = args;
+	frame->scope = scope;
+}
+
+void lisp_inline_push(lisp_runtime *rt, lisp_value *callable)
+{
+	struct lisp_inlined *inlined;
+
+	if (rt->inlined_depth >= rt->inlined_alloc) {
+		rt->inlined_alloc *= 2;
+		rt->inlined = realloc(rt->inlined,
+			sizeof(struct lisp_inlined) * rt->inlined_alloc);
+	}
+	inlined = &rt->inlined[rt->inlined_depth++];
+	inlined->callable = callable;
+	inlined->argv = NULL;
+	inlined->depth = rt->stack_depth;
+}
+
 lisp_value *lisp_call(lisp_runtime *rt, lisp_scope *scope,
                       lisp_value *callable, lisp_list *args)
 {
 	lisp_value *rv;
+
 	/* create new stack frame */
-	rt->stack = lisp_list_new(rt, callable, (lisp_value *) rt->stack);
-	rt->stack_depth++;
+	lisp_stack_push(rt, callable, args, scope);
 
 	/* make function call */
 	rv = callable->type->call(rt, scope, callable, args);
 
 	/* get rid of stack frame */
-	rt->stack = (lisp_list*) rt->stack->right;
+	rt->stack_depth--;
+	return rv;
+}
+
+/*
+ * Lambdas and evaluated builtins take the values as they are. Anything else
+ * receives its arguments un-evaluated, so the values are quoted for it.
+ */
+lisp_value *lisp_call_v(lisp_runtime *rt, lisp_scope *scope,
+                        lisp_value *callable, int argc, lisp_value **argv)
+{
+	lisp_builtin *builtin = (lisp_builtin *) callable;
+	lisp_list *args = (lisp_list *) lisp_nil_new(rt);
+	lisp_value *rv;
+	int quote;
+
+	if (callable->type == type_lambda &&
+	    ((lisp_lambda *) callable)->lambda_type == TP_LAMBDA) {
+		lisp_stack_push(rt, callable, args, scope);
+		rv = lisp_lambda_call_v(rt, (lisp_lambda *) callable, argc, argv);
+		rt->stack_depth--;
+		return rv;
+	}
+
+	if (callable->type == type_builtin && builtin->evald &&
+	    builtin->call_v) {
+		lisp_stack_push(rt, callable, args, scope);
+		rv = builtin->call_v(rt, scope, argc, argv, builtin->user);
+		rt->stack_depth--;
+		return rv;
+	}
+
+	quote = callable->type != type_builtin || !builtin->evald;
+	while (argc--) {
+		args = lisp_list_new(rt, quote ?
+			(lisp_value *) lisp_quote(rt, argv[argc]) : argv[argc],
+			(lisp_value *) args);
+	}
+	if (quote)
+		return lisp_call(rt, scope, callable, args);
+
+	lisp_stack_push(rt, callable, args, scope);
+	rv = builtin->call(rt, scope, args, builtin->user);
 	rt->stack_depth--;
 	return rv;
 }
@@ -852,3 +1421,429 @@ static int module_compare(lisp_value *self, lisp_value *other)
 	/* Compare by value for simplicity. */
 	return self == other;
 }
+
+/*
+ * values
+ */
+
+static void values_print(FILE *f, lisp_value *v);
+static lisp_value *values_new(lisp_runtime *rt);
+static void values_free(lisp_runtime *rt, void *v);
+static struct iterator values_expand(lisp_value *v);
+static int values_compare(lisp_value *self, lisp_value *other);
+
+static lisp_type type_values_obj = {
+	TYPE_HEADER,
+	/* name */ "values",
+	/* print */ values_print,
+	/* new */ values_new,
+	/* free */ values_free,
+	/* expand */ values_expand,
+	/* eval */ eval_same,
+	/* call */ call_error,
+	/* compare */ values_compare,
+};
+lisp_type *type_values = &type_values_obj;
+
+static void values_print(FILE *f, lisp_value *v)
+{
+	lisp_values *values = (lisp_values *) v;
+	int i;
+
+	fprintf(f, "<values");
+	for (i = 0; i < values->count; i++) {
+		fprintf(f, " ");
+		lisp_print(f, values->values[i]);
+	}
+	fprintf(f, ">");
+}
+
+static lisp_value *values_new(lisp_runtime *rt)
+{
+	lisp_values *values;
+	(void) rt; /* unused */
+
+	values = malloc(sizeof(lisp_values));
+	values->values = NULL;
+	values->count = 0;
+	return (lisp_value *) values;
+}
+
+static void values_free(lisp_runtime *rt, void *v)
+{
+	lisp_values *values = (lisp_values *) v;
+	(void) rt; /* unused */
+
+	if (values->values != values->inline_values)
+		free(values->values);
+	free(values);
+}
+
+static struct iterator values_expand(lisp_value *v)
+{
+	lisp_values *values = (lisp_values *) v;
+	return iterator_array((void **) values->values, values->count, false);
+}
+
+static int values_compare(lisp_value *self, lisp_value *other)
+{
+	/* values are meant to be received, not compared */
+	return self == other;
+}
+
+/*
+ * vector
+ */
+
+static void vector_print(FILE *f, lisp_value *v);
+static lisp_value *vector_new(lisp_runtime *rt);
+static void vector_free(lisp_runtime *rt, void *v);
+static struct iterator vector_expand(lisp_value *v);
+static int vector_compare(lisp_value *self, lisp_value *other);
+
+static lisp_type type_vector_obj = {
+	TYPE_HEADER,
+	/* name */ "vector",
+	/* print */ vector_print,
+	/* new */ vector_new,
+	/* free */ vector_free,
+	/* expand */ vector_expand,
+	/* eval */ eval_same,
+	/* call */ call_error,
+	/* compare */ vector_compare,
+};
+lisp_type *type_vector = &type_vector_obj;
+
+static void vector_print(FILE *f, lisp_value *v)
+{
+	lisp_vector *vector = (lisp_vector *) v;
+	int i;
+
+	fprintf(f, "#(");
+	for (i = 0; i < vector->len; i++) {
+		if (i)
+			fprintf(f, " ");
+		lisp_print(f, vector->items[i]);
+	}
+	fprintf(f, ")");
+}
+
+static lisp_value *vector_new(lisp_runtime *rt)
+{
+	lisp_vector *vector;
+	(void) rt; /* unused */
+
+	vector = malloc(sizeof(lisp_vector));
+	vector->items = NULL;
+	vector->len = 0;
+	return (lisp_value *) vector;
+}
+
+static void vector_free(lisp_runtime *rt, void *v)
+{
+	lisp_vector *vector = (lisp_vector *) v;
+	(void) rt; /* unused */
+
+	free(vector->items);
+	free(vector);
+}
+
+static struct iterator vector_expand(lisp_value *v)
+{
+	lisp_vector *vector = (lisp_vector *) v;
+	return iterator_array((void **) vector->items, vector->len, false);
+}
+
+static int vector_compare(lisp_value *self, lisp_value *other)
+{
+	lisp_vector *lhs, *rhs;
+	int i;
+
+	if (self == other)
+		return 1;
+	if (self->type != other->type || self->type != type_vector)
+		return 0;
+	lhs = (lisp_vector *) self;
+	rhs = (lisp_vector *) other;
+	if (lhs->len != rhs->len)
+		return 0;
+	for (i = 0; i < lhs->len; i++)
+		if (!lisp_compare(lhs->items[i], rhs->items[i]))
+			return 0;
+	return 1;
+}
+
+/*
+ * hashmap
+ */
+
+static void hashmap_print(FILE *f, lisp_value *v);
+static lisp_value *hashmap_new(lisp_runtime *rt);
+static void hashmap_free(lisp_runtime *rt, void *v);
+static struct iterator hashmap_expand(lisp_value *v);
+static int hashmap_compare(lisp_value *self, lisp_value *other);
+
+static lisp_type type_hashmap_obj = {
+	TYPE_HEADER,
+	/* name */ "hashmap",
+	/* print */ hashmap_print,
+	/* new */ hashmap_new,
+	/* free */ hashmap_free,
+	/* expand */ hashmap_expand,
+	/* eval */ eval_same,
+	/* call */ call_error,
+	/* compare */ hashmap_compare,
+};
+lisp_type *type_hashmap = &type_hashmap_obj;
+
+static void hashmap_print(FILE *f, lisp_value *v)
+{
+	lisp_hashmap *map = (lisp_hashmap *) v;
+	struct iterator it = ht_iter_keys_ptr(&map->table);
+	lisp_value *key;
+	int first = 1;
+
+	fprintf(f, "#hash(");
+	while (it.has_next(&it)) {
+		key = it.next(&it);
+		if (!first)
+			fprintf(f, " ");
+		first = 0;
+		fprintf(f, "(");
+		lisp_print(f, key);
+		fprintf(f, " . ");
+		lisp_print(f, ht_get_ptr(&map->table, key));
+		fprintf(f, ")");
+	}
+	it.close(&it);
+	fprintf(f, ")");
+}
+
+static lisp_value *hashmap_new(lisp_runtime *rt)
+{
+	lisp_hashmap *map;
+	(void) rt; /* unused */
+
+	map = malloc(sizeof(lisp_hashmap));
+	ht_init(&map->table, lisp_value_hash, lisp_value_compare,
+	        sizeof(lisp_value *), sizeof(lisp_value *));
+	return (lisp_value *) map;
+}
+
+static void hashmap_free(lisp_runtime *rt, void *v)
+{
+	lisp_hashmap *map = (lisp_hashmap *) v;
+	(void) rt; /* unused */
+
+	ht_destroy(&map->table);
+	free(map);
+}
+
+static struct iterator hashmap_expand(lisp_value *v)
+{
+	lisp_hashmap *map = (lisp_hashmap *) v;
+	return iterator_concat2(
+		ht_iter_keys_ptr(&map->table),
+		ht_iter_values_ptr(&map->table)
+	);
+}
+
+static int hashmap_compare(lisp_value *self, lisp_value *other)
+{
+	lisp_hashmap *lhs, *rhs;
+	lisp_value *key, *value;
+	struct iterator it;
+
+	if (self == other)
+		return 1;
+	if (self->type != other->type || self->type != type_hashmap)
+		return 0;
+	lhs = (lisp_hashmap *) self;
+	rhs = (lisp_hashmap *) other;
+	if (ht_length(&lhs->table) != ht_length(&rhs->table))
+		return 0;
+
+	it = ht_iter_keys_ptr(&lhs->table);
+	while (it.has_next(&it)) {
+		key = it.next(&it);
+		value = ht_get_ptr(&rhs->table, key);
+		if (!value || !lisp_compare(ht_get_ptr(&lhs->table, key), value)) {
+			it.close(&it);
+			return 0;
+		}
+	}
+	it.close(&it);
+	return 1;
+}
+
+/*
+ * string builder
+ */
+
+static void strbuf_print(FILE *f, lisp_value *v);
+static lisp_value *strbuf_new(lisp_runtime *rt);
+static void strbuf_free(lisp_runtime *rt, void *v);
+static int strbuf_compare(lisp_value *self, lisp_value *other);
+
+static lisp_type type_strbuf_obj = {
+	TYPE_HEADER,
+	/* name */ "string-builder",
+	/* print */ strbuf_print,
+	/* new */ strbuf_new,
+	/* free */ strbuf_free,
+	/* expand */ iterator_empty,
+	/* eval */ eval_same,
+	/* call */ call_error,
+	/* compare */ strbuf_compare,
+};
+lisp_type *type_strbuf = &type_strbuf_obj;
+
+static void strbuf_print(FILE *f, lisp_value *v)
+{
+	fprintf(f, "<string-builder \"%s\">", ((lisp_strbuf *) v)->cb.buf);
+}
+
+static lisp_value *strbuf_new(lisp_runtime *rt)
+{
+	lisp_strbuf *sb;
+	(void) rt; /* unused */
+
+	sb = malloc(sizeof(lisp_strbuf));
+	cb_init(&sb->cb, 16);
+	return (lisp_value *) sb;
+}
+
+static void strbuf_free(lisp_runtime *rt, void *v)
+{
+	lisp_strbuf *sb = (lisp_strbuf *) v;
+	(void) rt; /* unused */
+
+	cb_destroy(&sb->cb);
+	free(sb);
+}
+
+static int strbuf_compare(lisp_value *self, lisp_value *other)
+{
+	/* mutable, so only the same builder is equal */
+	return self == other;
+}
+
+/*
+ * rope
+ */
+
+static void rope_print(FILE *f, lisp_value *v);
+static lisp_value *rope_new(lisp_runtime *rt);
+static struct iterator rope_expand(lisp_value *v);
+static int rope_compare(lisp_value *self, lisp_value *other);
+
+static lisp_type type_rope_obj = {
+	TYPE_HEADER,
+	/* name */ "rope",
+	/* print */ rope_print,
+	/* new */ rope_new,
+	/* free */ simple_free,
+	/* expand */ rope_expand,
+	/* eval */ eval_same,
+	/* call */ call_error,
+	/* compare */ rope_compare,
+};
+lisp_type *type_rope = &type_rope_obj;
+
+/*
+ * Ropes built by appending one piece at a time are as deep as they are long,
+ * so this walks them with a stack of its own rather than recursing.
+ */
+void lisp_rope_flatten(struct charbuf *cb, lisp_value *v)
+{
+	lisp_value **stack;
+	int top = 0, alloc = 16;
+
+	stack = malloc(alloc * sizeof(lisp_value *));
+	stack[top++] = v;
+	while (top > 0) {
+		v = stack[--top];
+		if (v->type != type_rope) {
+			cb_concat(cb, ((lisp_string *) v)->s);
+			continue;
+		}
+		if (top + 2 > alloc) {
+			alloc *= 2;
+			stack = realloc(stack, alloc * sizeof(lisp_value *));
+		}
+		stack[top++] = ((lisp_rope *) v)->right;
+		stack[top++] = ((lisp_rope *) v)->left;
+	}
+	free(stack);
+}
+
+static void rope_print(FILE *f, lisp_value *v)
+{
+	struct charbuf cb;
+
+	cb_init(&cb, ((lisp_rope *) v)->length + 1);
+	lisp_rope_flatten(&cb, v);
+	fputs(cb.buf, f);
+	cb_destroy(&cb);
+}
+
+static lisp_value *rope_new(lisp_runtime *rt)
+{
+	lisp_rope *rope;
+	(void) rt; /* unused */
+
+	rope = malloc(sizeof(lisp_rope));
+	rope->left = NULL;
+	rope->right = NULL;
+	rope->length = 0;
+	return (lisp_value *) rope;
+}
+
+static void *rope_expand_next(struct iterator *it)
+{
+	lisp_rope *rope = (lisp_rope *) it->ds;
+	it->index++;
+	switch (it->index) {
+	case 1:
+		return rope->left;
+	case 2:
+		return rope->right;
+	default:
+		return NULL;
+	}
+}
+
+static struct iterator rope_expand(lisp_value *v)
+{
+	struct iterator it = {0};
+	it.ds = v;
+	it.state_int = 2;
+	it.index = 0;
+	it.next = rope_expand_next;
+	it.has_next = has_next_index_lt_state;
+	it.close = iterator_close_noop;
+	return it;
+}
+
+/* A rope is equal to a string or rope with the same text */
+static int rope_compare(lisp_value *self, lisp_value *other)
+{
+	struct charbuf lhs, rhs;
+	int result;
+
+	if (self == other)
+		return 1;
+	if (other->type != type_rope && other->type != type_string)
+		return 0;
+	if (other->type == type_rope &&
+	    ((lisp_rope *) self)->length != ((lisp_rope *) other)->length)
+		return 0;
+	cb_init(&lhs, ((lisp_rope *) self)->length + 1);
+	cb_init(&rhs, ((lisp_rope *) self)->length + 1);
+	lisp_rope_flatten(&lhs, self);
+	lisp_rope_flatten(&rhs, other);
+	result = strcmp(lhs.buf, rhs.buf) == 0;
+	cb_destroy(&lhs);
+	cb_destroy(&rhs);
+	return result;
+}
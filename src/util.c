@@ -35,12 +35,44 @@ const char *lisp_error_name[LE_MAX_ERR] = {
 	"LE_ASSERT",
 	"LE_VALUE",
 	"LE_ERRNO",
+	"LE_ESCAPE",
 };
 
+/*
+ * Bind a new name in a global scope. Cells for the name in global scopes
+ * further up are now hidden from lookups which pass through this scope.
+ */
+static void scope_bind_cell(lisp_scope *scope, lisp_symbol *symbol,
+                            lisp_value *value)
+{
+	struct lisp_cell *cell = malloc(sizeof(struct lisp_cell));
+	lisp_scope *s;
+
+	cell->value = value;
+	cell->shadowed = 0;
+	ht_insert_ptr(&scope->scope, symbol, cell);
+
+	for (s = scope->up; s; s = s->up) {
+		cell = ht_get_ptr(&s->scope, symbol);
+		if (cell) {
+			if (s->global)
+				cell->shadowed = 1;
+			break;
+		}
+	}
+}
+
 void lisp_scope_bind(lisp_scope *scope, lisp_symbol *symbol, lisp_value *value)
 {
 	lisp_lambda *l;
-	ht_insert_ptr(&scope->scope, symbol, value);
+	struct lisp_cell *cell;
+
+	if (!scope->global)
+		ht_insert_ptr(&scope->scope, symbol, value);
+	else if ((cell = ht_get_ptr(&scope->scope, symbol)))
+		cell->value = value;
+	else
+		scope_bind_cell(scope, symbol, value);
 
 	/* for nicer debugging, record the first name binding for lambdas */
 	if (value->type == type_lambda) {
@@ -51,19 +83,44 @@ void lisp_scope_bind(lisp_scope *scope, lisp_symbol *symbol, lisp_value *value)
 	}
 }
 
-lisp_value *lisp_scope_lookup(lisp_runtime *rt, lisp_scope *scope,
-                              lisp_symbol *symbol)
+lisp_value *lisp_scope_get(lisp_scope *scope, lisp_symbol *symbol)
 {
-	lisp_value *v = ht_get_ptr(&scope->scope, symbol);
-	if (!v) {
-		if (scope->up) {
-			return lisp_scope_lookup(rt, scope->up, symbol);
-		} else {
-			return lisp_error(rt, LE_NOTFOUND, "symbol not found in scope");
+	void *v = ht_get_ptr(&scope->scope, symbol);
+	if (v && scope->global)
+		return ((struct lisp_cell *) v)->value;
+	return v;
+}
+
+lisp_value *lisp_scope_set(lisp_runtime *rt, lisp_scope *scope,
+                           lisp_symbol *symbol, lisp_value *value)
+{
+	for (; scope; scope = scope->up) {
+		if (ht_get_ptr(&scope->scope, symbol)) {
+			lisp_scope_bind(scope, symbol, value);
+			return value;
 		}
-	} else {
-		return v;
 	}
+	return lisp_error(rt, LE_NOTFOUND, "symbol not found in scope");
+}
+
+lisp_value *lisp_scope_find(lisp_scope *scope, lisp_symbol *symbol)
+{
+	lisp_value *v;
+	for (; scope; scope = scope->up) {
+		v = lisp_scope_get(scope, symbol);
+		if (v)
+			return v;
+	}
+	return NULL;
+}
+
+lisp_value *lisp_scope_lookup(lisp_runtime *rt, lisp_scope *scope,
+                              lisp_symbol *symbol)
+{
+	lisp_value *v = lisp_scope_find(scope, symbol);
+	if (!v)
+		return lisp_error(rt, LE_NOTFOUND, "symbol not found in scope");
+	return v;
 }
 
 lisp_value *lisp_scope_lookup_string(lisp_runtime *rt, lisp_scope *scope, char *name)
@@ -83,6 +140,14 @@ void lisp_scope_add_builtin(lisp_runtime *rt, lisp_scope *scope, char *name,
 	lisp_scope_bind(scope, symbol, (lisp_value*)builtin);
 }
 
+void lisp_scope_add_builtin_v(lisp_runtime *rt, lisp_scope *scope, char *name,
+                              lisp_builtin_func_v call, void *user, int evald)
+{
+	lisp_symbol *symbol = lisp_symbol_new(rt, name, 0);
+	lisp_builtin *builtin = lisp_builtin_new_v(rt, name, call, user, evald);
+	lisp_scope_bind(scope, symbol, (lisp_value*)builtin);
+}
+
 lisp_value *lisp_mapper_eval(lisp_runtime *rt, lisp_scope *scope, void *user,
                              lisp_value *input)
 {
@@ -140,11 +205,13 @@ lisp_list *lisp_quote(lisp_runtime *rt, lisp_value *value) {
 	return lisp_quote_with(rt, value, "quote");
 }
 
-static lisp_type *lisp_get_type(char c)
+lisp_type *lisp_format_type(char c)
 {
 	switch (c) {
 	case 'd':
 		return type_integer;
+	case 'f':
+		return type_float;
 	case 'l':
 		return type_list;
 	case 's':
@@ -157,6 +224,10 @@ static lisp_type *lisp_get_type(char c)
 		return type_builtin;
 	case 't':
 		return type_type;
+	case 'v':
+		return type_vector;
+	case 'h':
+		return type_hashmap;
 	}
 	return NULL;
 }
@@ -180,7 +251,7 @@ int lisp_get_args(lisp_runtime *rt, lisp_list *list, char *format, ...)
 			*v = (lisp_value *) list;
 			return 1;
 		}
-		type = lisp_get_type(*format);
+		type = lisp_format_type(*format);
 		if (type != NULL && type != list->left->type) {
 			rt->error = "incorrect argument type";
 			rt->err_num = LE_TYPE;
@@ -202,6 +273,39 @@ int lisp_get_args(lisp_runtime *rt, lisp_list *list, char *format, ...)
 	return 1;
 }
 
+int lisp_get_args_v(lisp_runtime *rt, int argc, lisp_value **argv,
+                    char *format, ...)
+{
+	lisp_value **v;
+	lisp_type *type;
+	va_list va;
+	int i;
+
+	va_start(va, format);
+	for (i = 0; i < argc && *format != '\0'; i++, format++) {
+		v = va_arg(va, lisp_value**);
+		type = lisp_format_type(*format);
+		if (type != NULL && type != argv[i]->type) {
+			rt->error = "incorrect argument type";
+			rt->err_num = LE_TYPE;
+			va_end(va);
+			return 0;
+		}
+		*v = argv[i];
+	}
+	va_end(va);
+	if (*format != '\0') {
+		rt->error = "not enough arguments";
+		rt->err_num = LE_2FEW;
+		return 0;
+	} else if (i < argc) {
+		rt->error = "too many arguments";
+		rt->err_num = LE_2MANY;
+		return 0;
+	}
+	return 1;
+}
+
 lisp_list *lisp_list_of_strings(lisp_runtime *rt, char **list, size_t n, int flags)
 {
 	size_t i;
@@ -271,6 +375,7 @@ lisp_scope *lisp_new_empty_scope(lisp_runtime *rt)
 lisp_scope *lisp_new_default_scope(lisp_runtime *rt)
 {
 	lisp_scope *scope = lisp_new_empty_scope(rt);
+	scope->global = 1;
 	lisp_scope_populate_builtins(rt, scope);
 	return scope;
 }
@@ -278,7 +383,7 @@ lisp_scope *lisp_new_default_scope(lisp_runtime *rt)
 lisp_value *lisp_run_main_if_exists(lisp_runtime *rt, lisp_scope *scope,
                                     int argc, char **argv)
 {
-	lisp_list *args;
+	lisp_value *args;
 	lisp_value *main_func = lisp_scope_lookup(
 		rt, scope, lisp_symbol_new(rt, "main", 0));
 
@@ -287,10 +392,8 @@ lisp_value *lisp_run_main_if_exists(lisp_runtime *rt, lisp_scope *scope,
 		return lisp_nil_new(rt);
 	}
 
-	args = lisp_list_of_strings(rt, argv, argc, 0);
-	args = lisp_quote(rt, (lisp_value*) args);
-	args = lisp_singleton_list(rt, (lisp_value*) args);
-	return lisp_call(rt, scope, main_func, args);
+	args = (lisp_value*) lisp_list_of_strings(rt, argv, argc, 0);
+	return lisp_call_v(rt, scope, main_func, 1, &args);
 }
 
 lisp_builtin *lisp_builtin_new(lisp_runtime *rt, char *name,
@@ -304,6 +407,18 @@ lisp_builtin *lisp_builtin_new(lisp_runtime *rt, char *name,
 	return builtin;
 }
 
+lisp_builtin *lisp_builtin_new_v(lisp_runtime *rt, char *name,
+                                 lisp_builtin_func_v call, void *user,
+                                 int evald)
+{
+	lisp_builtin *builtin = (lisp_builtin*)lisp_new(rt, type_builtin);
+	builtin->call_v = call;
+	builtin->name = name;
+	builtin->user = user;
+	builtin->evald = evald;
+	return builtin;
+}
+
 lisp_value *lisp_nil_new(lisp_runtime *rt)
 {
 	if (rt->nil == NULL) {
@@ -362,22 +477,153 @@ void lisp_list_append(lisp_runtime *rt, lisp_list **head, lisp_list **tail, lisp
 	}
 }
 
-lisp_integer *lisp_integer_new(lisp_runtime *rt, int n)
+lisp_integer *lisp_integer_new(lisp_runtime *rt, long n)
 {
 	lisp_integer *integer = (lisp_integer *) lisp_new(rt, type_integer);
 	integer->x = n;
 	return integer;
 }
 
-int lisp_integer_get(lisp_integer *integer)
+long lisp_integer_get(lisp_integer *integer)
 {
 	return integer->x;
 }
 
+lisp_float *lisp_float_new(lisp_runtime *rt, double x)
+{
+	lisp_float *f = (lisp_float *) lisp_new(rt, type_float);
+	f->x = x;
+	return f;
+}
+
+double lisp_float_get(lisp_float *f)
+{
+	return f->x;
+}
+
+lisp_vector *lisp_vector_new(lisp_runtime *rt, int n, lisp_value *fill)
+{
+	lisp_vector *v = (lisp_vector *) lisp_new(rt, type_vector);
+	int i;
+
+	v->items = malloc(n * sizeof(lisp_value *));
+	v->len = n;
+	for (i = 0; i < n; i++)
+		v->items[i] = fill;
+	return v;
+}
+
+int lisp_vector_length(lisp_vector *v)
+{
+	return v->len;
+}
+
+lisp_value *lisp_vector_get(lisp_vector *v, int index)
+{
+	return v->items[index];
+}
+
+void lisp_vector_set(lisp_vector *v, int index, lisp_value *item)
+{
+	v->items[index] = item;
+}
+
+lisp_hashmap *lisp_hashmap_new(lisp_runtime *rt)
+{
+	return (lisp_hashmap *) lisp_new(rt, type_hashmap);
+}
+
+lisp_value *lisp_hashmap_get(lisp_hashmap *map, lisp_value *key)
+{
+	return ht_get_ptr(&map->table, key);
+}
+
+void lisp_hashmap_set(lisp_hashmap *map, lisp_value *key, lisp_value *value)
+{
+	ht_insert_ptr(&map->table, key, value);
+}
+
+int lisp_hashmap_remove(lisp_hashmap *map, lisp_value *key)
+{
+	return ht_remove_ptr(&map->table, key) == 0;
+}
+
+int lisp_hashmap_length(lisp_hashmap *map)
+{
+	return (int) ht_length(&map->table);
+}
+
+lisp_value *lisp_values_new(lisp_runtime *rt, int n, lisp_value **values)
+{
+	lisp_values *v, *inner;
+	int i;
+
+	if (n == 1)
+		return values[0];
+
+	v = (lisp_values *) lisp_new(rt, type_values);
+	if (n <= LISP_VALUES_INLINE)
+		v->values = v->inline_values;
+	else
+		v->values = malloc(n * sizeof(lisp_value *));
+	v->count = n;
+	for (i = 0; i < n; i++) {
+		/* multiple values within multiple values are just the first one */
+		inner = (lisp_values *) values[i];
+		if (inner->type != type_values)
+			v->values[i] = values[i];
+		else if (inner->count)
+			v->values[i] = inner->values[0];
+		else
+			v->values[i] = lisp_nil_new(rt);
+	}
+	return (lisp_value *) v;
+}
+
+int lisp_values_count(lisp_value *result)
+{
+	if (result->type == type_values)
+		return ((lisp_values *) result)->count;
+	return 1;
+}
+
+lisp_value *lisp_values_get(lisp_value *result, int index)
+{
+	if (result->type == type_values)
+		return ((lisp_values *) result)->values[index];
+	return result;
+}
+
+/*
+ * Inlined calls appear between the frames of the stack, just above the frames
+ * which were there when they were called.
+ */
+static lisp_list *stack_list(lisp_runtime *rt, unsigned int depth,
+                             unsigned int inlined)
+{
+	lisp_list *stack = (lisp_list *) lisp_nil_new(rt);
+	unsigned int i, j = 0;
+
+	for (i = 0; i <= depth; i++) {
+		for (; j < inlined && rt->inlined[j].depth == i; j++)
+			stack = lisp_list_new(rt, rt->inlined[j].callable,
+			                      (lisp_value*) stack);
+		if (i < depth)
+			stack = lisp_list_new(rt, rt->stack[i].callable,
+			                      (lisp_value*) stack);
+	}
+	return stack;
+}
+
+lisp_list *lisp_stack_list(lisp_runtime *rt)
+{
+	return stack_list(rt, rt->stack_depth, rt->inlined_depth);
+}
+
 void lisp_dump_stack(lisp_runtime *rt, lisp_list *stack, FILE *file)
 {
 	if (!stack)
-		stack = rt->stack;
+		stack = lisp_stack_list(rt);
 
 	fprintf(file, "Stack trace (most recent call first):\n");
 	lisp_for_each(stack) {
@@ -391,10 +637,66 @@ lisp_value *lisp_error(lisp_runtime *rt, enum lisp_errno err_num, char *message)
 {
 	rt->error = message;
 	rt->err_num = err_num;
-	rt->error_stack = rt->stack;
+	rt->error_stack = NULL;
+	rt->error_needs_trace = 1;
+	rt->error_depth = rt->stack_depth;
+	rt->error_inlined = rt->inlined_depth;
+	rt->error_value = NULL;
 	return NULL;
 }
 
+void lisp_error_trace(lisp_runtime *rt)
+{
+	if (!rt->error_needs_trace)
+		return;
+	rt->error_needs_trace = 0;
+	rt->error_stack = stack_list(rt, rt->error_depth, rt->error_inlined);
+}
+
+void lisp_error_frame(lisp_runtime *rt, lisp_value *callable, lisp_list *args,
+                      lisp_scope *scope, unsigned int depth,
+                      unsigned int inlined)
+{
+	struct lisp_frame *frame;
+	unsigned int i;
+
+	if (!rt->error_needs_trace || rt->error_depth < depth)
+		return;
+
+	/* the frames the error returned through are still in the array */
+	if (rt->error_depth >= rt->stack_alloc) {
+		rt->stack_alloc *= 2;
+		rt->stack = realloc(rt->stack,
+			sizeof(struct lisp_frame) * rt->stack_alloc);
+	}
+	frame = &rt->stack[depth];
+	memmove(frame + 1, frame,
+	        sizeof(struct lisp_frame) * (rt->error_depth - depth));
+	frame->callable = callable;
+	frame->args = args;
+	frame->scope = scope;
+	rt->error_depth++;
+
+	/* inlined calls made since then were made within the new frame */
+	for (i = inlined; i < rt->error_inlined; i++)
+		rt->inlined[i].depth++;
+}
+
+lisp_value *lisp_error_value(lisp_runtime *rt)
+{
+	lisp_value *name, *message;
+
+	if (rt->error_value)
+		return rt->error_value;
+
+	name = (lisp_value *) lisp_symbol_new(
+		rt, (char *) lisp_error_name[rt->err_num], 0);
+	message = (lisp_value *) lisp_string_new(rt, rt->error, LS_CPY | LS_OWN);
+	return (lisp_value *) lisp_list_new(rt, name, (lisp_value *)
+		lisp_list_new(rt, message, (lisp_value *)
+			lisp_list_new(rt, lisp_nil_new(rt), lisp_nil_new(rt))));
+}
+
 char *lisp_get_error(lisp_runtime *rt)
 {
 	return rt->error;
@@ -409,6 +711,8 @@ void lisp_clear_error(lisp_runtime *rt)
 {
 	rt->error = NULL;
 	rt->error_stack = NULL;
+	rt->error_needs_trace = 0;
+	rt->error_value = NULL;
 	rt->error_line = 0;
 	rt->err_num = 0;
 }
@@ -432,6 +736,7 @@ void lisp_print_error(lisp_runtime *rt, FILE *file)
 		fprintf(file, "Error %s: %s\n", lisp_error_name[rt->err_num], rt->error);
 	}
 
+	lisp_error_trace(rt);
 	if (rt->error_stack)
 		lisp_dump_stack(rt, rt->error_stack, file);
 }
@@ -494,5 +799,16 @@ lisp_list *lisp_map(lisp_runtime *rt, lisp_scope *scope, void *user,
 
 int lisp_truthy(lisp_value *v)
 {
-	return v->type == type_integer && ((lisp_integer*)v)->x;
+	/* a bignum is never zero */
+	return (v->type == type_integer && ((lisp_integer*)v)->x) ||
+		v->type == type_bignum ||
+		(v->type == type_float && ((lisp_float*)v)->x != 0);
+}
+
+lisp_value *lisp_boolean(lisp_runtime *rt, int value)
+{
+	value = value ? 1 : 0;
+	if (!rt->booleans[value])
+		rt->booleans[value] = (lisp_value *) lisp_integer_new(rt, value);
+	return rt->booleans[value];
 }
@@ -13,6 +13,15 @@ import sys
 ERROR_EXITCODE = 211
 
 
+def get_flags(script):
+    flags_re = re.compile(r'; FLAGS\((.*)\)')
+    with open(script, 'r') as f:
+        for line in f:
+            if flags_re.match(line):
+                return flags_re.match(line).group(1).split()
+    return []
+
+
 def get_expected_code_and_output(script):
     reading_output = False
     output = ''
@@ -34,6 +43,7 @@ def run_test_script(script, runner):
         '-q',
         '--error-exitcode={}'.format(ERROR_EXITCODE),
         runner,
+    ] + get_flags(script) + [
         script,
     ]
     proc = subprocess.Popen(
@@ -0,0 +1,1029 @@
+/*
+ * funlisp-cc.c: compile a file of funlisp code to C
+ *
+ * The output is a C file which uses only the public API (funlisp.h). It
+ * defines a function create_NAME_module(), which returns a module equivalent
+ * to loading the lisp file with lisp_import_file(). Link it against
+ * libfunlisp.a, and register the module with lisp_register_module().
+ *
+ * Functions defined at the top level, i.e. (define name (lambda (args) ...)),
+ * are compiled to C functions, and bound in the module as builtins. Integer
+ * arithmetic and comparisons, if, cond, let, progn and quote are compiled to
+ * plain C, unless the file re-binds their names. Calls between functions compiled from the same file are direct C
+ * calls, so re-defining one of them at runtime does not affect the others.
+ * That is, unless the name is also bound by a builtin or an import, since code
+ * which runs before the definition must see that. Other calls look up the
+ * function at runtime, just like the interpreter.
+ *
+ * Functions which can't be compiled (because they use lambda, macros, define,
+ * eval, quasiquote, etc), and any other top-level code, are evaluated by the
+ * interpreter when the module is created.
+ *
+ * Like the funlisp binary, this depends on POSIX.2 for getopt().
+ *
+ * Stephen Brennan <stephen@brennan.io>
+ */
+
+#define _POSIX_C_SOURCE 2
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "funlisp.h"
+
+/* A top-level function which we may compile. */
+struct function {
+	lisp_value *form; /* the define */
+	char *name;
+	lisp_list *params;
+	lisp_list *body;
+	int nparams;
+	int compiled; /* whether we are (still) able to compile it */
+};
+
+struct compiler {
+	lisp_runtime *rt;
+	lisp_list *forms;
+	struct function *funcs;
+	int nfuncs;
+	/* names of macros defined at the top level */
+	char **macros;
+	int nmacros;
+	/* names of builtins re-bound at the top level, and imported names */
+	char **rebound;
+	int nrebound;
+	int helpers; /* which helpers the compiled functions use */
+};
+
+#define HELPER_TRUTHY      1
+#define HELPER_CALL_GLOBAL 2
+
+/* Mapping from local variable names to the C variable holding them */
+struct env {
+	char *name;
+	int var;
+	struct env *next;
+};
+
+/* State while generating a single function */
+struct gen {
+	struct compiler *cc;
+	FILE *out;
+	int depth;
+	int vars;  /* number of variables t0, t1, ... */
+	int argc;  /* size of argv needed for calls */
+	int helpers;
+	int failed;
+};
+
+/* Syntax which compiled functions can't support, since it needs a scope. */
+static char *unsupported[] = {
+	"lambda", "macro", "define", "eval", "quasiquote", "unquote",
+	"assert-error", "import", "set!", "while", "dotimes", "for-each",
+	"let-values", "try",
+};
+
+/* Syntax which compiled functions implement themselves */
+static char *syntax[] = {"quote", "if", "cond", "let", "progn"};
+
+/* Arithmetic and comparisons, which are computed inline on integers */
+static struct {
+	char *name;
+	char *op;
+	int argc;
+} operators[] = {
+	{"+", "+", 2}, {"-", "-", 2}, {"*", "*", 2}, {"/", "/", 2},
+	{"-", "-", 1},
+	{"==", "==", 2}, {"=", "==", 2}, {"!=", "!=", 2},
+	{">", ">", 2}, {">=", ">=", 2}, {"<", "<", 2}, {"<=", "<=", 2},
+};
+
+#define nelem(arr) (sizeof(arr) / sizeof(arr[0]))
+
+static int compile(struct gen *g, struct env *env, lisp_value *expr);
+
+/*
+ * Small accessors for the shape of code
+ */
+
+static int is_symbol(lisp_value *v, char *name)
+{
+	return lisp_is(v, type_symbol) &&
+		strcmp(lisp_symbol_get((lisp_symbol *) v), name) == 0;
+}
+
+static lisp_value *car(lisp_value *v)
+{
+	return lisp_list_get_left((lisp_list *) v);
+}
+
+static lisp_value *cdr(lisp_value *v)
+{
+	return lisp_list_get_right((lisp_list *) v);
+}
+
+/* Return the length of v if it is a proper list, else -1. */
+static int length(lisp_value *v)
+{
+	int n = 0;
+	while (lisp_is(v, type_list) && !lisp_nil_p(v)) {
+		v = cdr(v);
+		n++;
+	}
+	return lisp_is(v, type_list) ? n : -1;
+}
+
+static int symbol_list(lisp_value *v)
+{
+	if (length(v) < 0)
+		return 0;
+	for (; !lisp_nil_p(v); v = cdr(v))
+		if (!lisp_is(car(v), type_symbol))
+			return 0;
+	return 1;
+}
+
+static struct env *env_find(struct env *env, char *name)
+{
+	for (; env; env = env->next)
+		if (strcmp(env->name, name) == 0)
+			return env;
+	return NULL;
+}
+
+static struct function *find_function(struct compiler *cc, char *name)
+{
+	int i;
+	for (i = 0; i < cc->nfuncs; i++)
+		if (cc->funcs[i].compiled && strcmp(cc->funcs[i].name, name) == 0)
+			return &cc->funcs[i];
+	return NULL;
+}
+
+static int in_names(char **names, int n, char *name)
+{
+	int i;
+	for (i = 0; i < n; i++)
+		if (strcmp(names[i], name) == 0)
+			return 1;
+	return 0;
+}
+
+static int is_macro(struct compiler *cc, char *name)
+{
+	return in_names(cc->macros, cc->nmacros, name);
+}
+
+/*
+ * Output helpers
+ */
+
+static void line(struct gen *g, char *fmt, ...)
+{
+	va_list ap;
+	int i;
+
+	for (i = 0; i < g->depth; i++)
+		fputc('\t', g->out);
+	va_start(ap, fmt);
+	vfprintf(g->out, fmt, ap);
+	va_end(ap);
+	fputc('\n', g->out);
+}
+
+static void c_string(FILE *out, char *s)
+{
+	fputc('"', out);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(out, "\\%c", *s);
+		else if (*s == '\n')
+			fputs("\\n", out);
+		else if (*s == '\t')
+			fputs("\\t", out);
+		else if (isprint((unsigned char) *s))
+			fputc(*s, out);
+		else
+			fprintf(out, "\\%03o", (unsigned char) *s);
+	}
+	fputc('"', out);
+}
+
+static void c_ident(FILE *out, char *s)
+{
+	for (; *s; s++)
+		fputc(isalnum((unsigned char) *s) ? *s : '_', out);
+}
+
+/* Output a C expression which creates a copy of v. */
+static void construct(FILE *out, lisp_value *v)
+{
+	double x;
+
+	if (lisp_is(v, type_integer)) {
+		fprintf(out, "(lisp_value *) lisp_integer_new(rt, %ldL)",
+		        lisp_integer_get((lisp_integer *) v));
+	} else if (lisp_is(v, type_float)) {
+		x = lisp_float_get((lisp_float *) v);
+		if (x - x == 0)
+			fprintf(out, "(lisp_value *) lisp_float_new(rt, %.17g)", x);
+		else
+			fprintf(out, "(lisp_value *) lisp_float_new(rt, %sHUGE_VAL)",
+			        x < 0 ? "-" : "");
+	} else if (lisp_is(v, type_bignum)) {
+		fputs("lisp_integer_from_string(rt, \"", out);
+		lisp_print(out, v);
+		fputs("\")", out);
+	} else if (lisp_is(v, type_string)) {
+		fputs("(lisp_value *) lisp_string_new(rt, ", out);
+		c_string(out, lisp_string_get((lisp_string *) v));
+		fputs(", 0)", out);
+	} else if (lisp_is(v, type_symbol)) {
+		fputs("(lisp_value *) lisp_symbol_new(rt, ", out);
+		c_string(out, lisp_symbol_get((lisp_symbol *) v));
+		fputs(", 0)", out);
+	} else if (lisp_nil_p(v)) {
+		fputs("lisp_nil_new(rt)", out);
+	} else {
+		fputs("(lisp_value *) lisp_list_new(rt,\n\t\t", out);
+		construct(out, car(v));
+		fputs(",\n\t\t", out);
+		construct(out, cdr(v));
+		fputs(")", out);
+	}
+}
+
+static void function_name(FILE *out, struct compiler *cc, struct function *fn,
+                          char prefix)
+{
+	fprintf(out, "%c%d_", prefix, (int) (fn - cc->funcs));
+	c_ident(out, fn->name);
+}
+
+static void function_signature(FILE *out, struct compiler *cc,
+                               struct function *fn)
+{
+	int i;
+	fputs("static lisp_value *", out);
+	function_name(out, cc, fn, 'f');
+	fputs("(lisp_runtime *rt, lisp_scope *m", out);
+	for (i = 0; i < fn->nparams; i++)
+		fprintf(out, ", lisp_value *t%d", i);
+	fputs(")", out);
+}
+
+/*
+ * Code generation. Each expression is stored into a new variable, and compile()
+ * returns its number. Errors are returned as soon as they happen.
+ */
+
+static int new_var(struct gen *g)
+{
+	return g->vars++;
+}
+
+static void check(struct gen *g, int var)
+{
+	line(g, "if (!t%d)", var);
+	line(g, "\treturn NULL;");
+}
+
+static int compile_body(struct gen *g, struct env *env, lisp_value *body)
+{
+	int var = -1;
+
+	if (lisp_nil_p(body)) {
+		var = new_var(g);
+		line(g, "t%d = lisp_nil_new(rt);", var);
+	}
+	for (; !lisp_nil_p(body); body = cdr(body))
+		var = compile(g, env, car(body));
+	return var;
+}
+
+static int compile_constant(struct gen *g, lisp_value *value)
+{
+	int var = new_var(g), i;
+
+	for (i = 0; i < g->depth; i++)
+		fputc('\t', g->out);
+	fprintf(g->out, "t%d = ", var);
+	construct(g->out, value);
+	fputs(";\n", g->out);
+	return var;
+}
+
+static void store_args(struct gen *g, int *vars, int argc)
+{
+	int i;
+	if (argc > g->argc)
+		g->argc = argc;
+	for (i = 0; i < argc; i++)
+		line(g, "argv[%d] = t%d;", i, vars[i]);
+}
+
+/* Compile each argument, returning their variables (which must be freed) */
+static int *compile_args(struct gen *g, struct env *env, lisp_value *args)
+{
+	int *vars = calloc(length(args) + 1, sizeof(int)), i = 0;
+	for (; !lisp_nil_p(args); args = cdr(args))
+		vars[i++] = compile(g, env, car(args));
+	return vars;
+}
+
+static int compile_if(struct gen *g, struct env *env, lisp_value *args)
+{
+	int var, cond, branch;
+
+	if (length(args) != 3) {
+		g->failed = 1;
+		return 0;
+	}
+
+	var = new_var(g);
+	cond = compile(g, env, car(args));
+	g->helpers |= HELPER_TRUTHY;
+	line(g, "if (cc_truthy(t%d)) {", cond);
+	g->depth++;
+	branch = compile(g, env, car(cdr(args)));
+	line(g, "t%d = t%d;", var, branch);
+	g->depth--;
+	line(g, "} else {");
+	g->depth++;
+	branch = compile(g, env, car(cdr(cdr(args))));
+	line(g, "t%d = t%d;", var, branch);
+	g->depth--;
+	line(g, "}");
+	return var;
+}
+
+static void compile_clauses(struct gen *g, struct env *env, lisp_value *clauses,
+                            int var)
+{
+	lisp_value *clause;
+	int test, branch;
+
+	if (lisp_nil_p(clauses)) {
+		line(g, "t%d = lisp_nil_new(rt);", var);
+		return;
+	}
+
+	clause = car(clauses);
+	if (length(clause) != 2) {
+		g->failed = 1;
+		return;
+	}
+	test = compile(g, env, car(clause));
+	g->helpers |= HELPER_TRUTHY;
+	line(g, "if (cc_truthy(t%d)) {", test);
+	g->depth++;
+	branch = compile(g, env, car(cdr(clause)));
+	line(g, "t%d = t%d;", var, branch);
+	g->depth--;
+	line(g, "} else {");
+	g->depth++;
+	compile_clauses(g, env, cdr(clauses), var);
+	g->depth--;
+	line(g, "}");
+}
+
+static int compile_cond(struct gen *g, struct env *env, lisp_value *args)
+{
+	int var = new_var(g);
+	if (length(args) < 0) {
+		g->failed = 1;
+		return 0;
+	}
+	compile_clauses(g, env, args, var);
+	return var;
+}
+
+/* let binds each name in turn, so later values can refer to earlier names */
+static int compile_let(struct gen *g, struct env *env, lisp_value *args)
+{
+	lisp_value *bindings, *binding;
+	struct env *inner = env, *new;
+	int var;
+
+	if (length(args) < 1 || length(car(args)) < 0) {
+		g->failed = 1;
+		return 0;
+	}
+
+	for (bindings = car(args); !lisp_nil_p(bindings); bindings = cdr(bindings)) {
+		binding = car(bindings);
+		if (length(binding) != 2 || !lisp_is(car(binding), type_symbol)) {
+			g->failed = 1;
+			break;
+		}
+		new = malloc(sizeof(struct env));
+		new->name = lisp_symbol_get((lisp_symbol *) car(binding));
+		new->var = compile(g, inner, car(cdr(binding)));
+		new->next = inner;
+		inner = new;
+	}
+
+	var = g->failed ? 0 : compile_body(g, inner, cdr(args));
+	while (inner != env) {
+		new = inner->next;
+		free(inner);
+		inner = new;
+	}
+	return var;
+}
+
+static int compile_operator(struct gen *g, struct env *env, char *op, int argc,
+                            char *name, lisp_value *args)
+{
+	int *vars = compile_args(g, env, args);
+	int var = new_var(g);
+	char *guard;
+
+	if (argc == 1) {
+		line(g, "if (SMALL(t%d)) {", vars[0]);
+		line(g, "\tt%d = (lisp_value *) lisp_integer_new(rt, %s INT(t%d));",
+		     var, op, vars[0]);
+	} else if (strcmp(op, "/") == 0) {
+		/* LONG_MIN / -1 overflows, so leave that to the builtin */
+		line(g, "if (ISINT(t%d) && ISINT(t%d) && INT(t%d) != 0 && INT(t%d) != -1) {",
+		     vars[0], vars[1], vars[1], vars[1]);
+		line(g, "\tt%d = (lisp_value *) lisp_integer_new(rt, INT(t%d) / INT(t%d));",
+		     var, vars[0], vars[1]);
+	} else {
+		/* arithmetic which may overflow is left to the builtin */
+		guard = strchr("+-*", op[0]) ? "SMALL" : "ISINT";
+		line(g, "if (%s(t%d) && %s(t%d)) {", guard, vars[0], guard,
+		     vars[1]);
+		line(g, "\tt%d = (lisp_value *) lisp_integer_new(rt, INT(t%d) %s INT(t%d));",
+		     var, vars[0], op, vars[1]);
+	}
+	line(g, "} else {");
+	g->depth++;
+	store_args(g, vars, argc);
+	g->helpers |= HELPER_CALL_GLOBAL;
+	line(g, "t%d = cc_call_global(rt, m, \"%s\", %d, argv);", var, name, argc);
+	check(g, var);
+	g->depth--;
+	line(g, "}");
+	free(vars);
+	return var;
+}
+
+static int compile_direct(struct gen *g, struct env *env, struct function *fn,
+                          lisp_value *args)
+{
+	int *vars = compile_args(g, env, args);
+	int var = new_var(g), i;
+
+	for (i = 0; i < g->depth; i++)
+		fputc('\t', g->out);
+	fprintf(g->out, "t%d = ", var);
+	function_name(g->out, g->cc, fn, 'f');
+	fputs("(rt, m", g->out);
+	for (i = 0; i < fn->nparams; i++)
+		fprintf(g->out, ", t%d", vars[i]);
+	fputs(");\n", g->out);
+	check(g, var);
+	free(vars);
+	return var;
+}
+
+static int compile_call(struct gen *g, struct env *env, int callee,
+                        lisp_value *args)
+{
+	int *vars = compile_args(g, env, args);
+	int argc = length(args), var = new_var(g);
+
+	store_args(g, vars, argc);
+	line(g, "t%d = lisp_call_v(rt, m, t%d, %d, %s);", var, callee, argc,
+	     argc ? "argv" : "NULL");
+	check(g, var);
+	free(vars);
+	return var;
+}
+
+/*
+ * Compile a list, which is a call unless its operator is a special form (or an
+ * operator we compile inline) which hasn't been shadowed by a local variable.
+ */
+static int compile_list(struct gen *g, struct env *env, lisp_value *expr)
+{
+	lisp_value *op = car(expr), *args = cdr(expr);
+	struct function *fn;
+	char *name;
+	unsigned int i;
+	int argc = length(args);
+
+	if (argc < 0 || !lisp_is(op, type_symbol) ||
+	    env_find(env, lisp_symbol_get((lisp_symbol *) op)))
+		goto call;
+
+	name = lisp_symbol_get((lisp_symbol *) op);
+	for (i = 0; i < nelem(unsupported); i++) {
+		if (strcmp(name, unsupported[i]) == 0) {
+			g->failed = 1;
+			return 0;
+		}
+	}
+	if (is_macro(g->cc, name)) {
+		g->failed = 1;
+		return 0;
+	}
+	if (in_names(g->cc->rebound, g->cc->nrebound, name)) {
+		/* only the interpreter can tell whether syntax was re-bound yet */
+		for (i = 0; i < nelem(syntax); i++) {
+			if (strcmp(name, syntax[i]) == 0) {
+				g->failed = 1;
+				return 0;
+			}
+		}
+		goto call;
+	}
+
+	if (strcmp(name, "quote") == 0 && argc == 1) {
+		return compile_constant(g, car(args));
+	} else if (strcmp(name, "if") == 0) {
+		return compile_if(g, env, args);
+	} else if (strcmp(name, "cond") == 0) {
+		return compile_cond(g, env, args);
+	} else if (strcmp(name, "let") == 0) {
+		return compile_let(g, env, args);
+	} else if (strcmp(name, "progn") == 0) {
+		return compile_body(g, env, args);
+	}
+
+	fn = find_function(g->cc, name);
+	if (fn && fn->nparams == argc)
+		return compile_direct(g, env, fn, args);
+	if (fn)
+		goto call;
+
+	for (i = 0; i < nelem(operators); i++)
+		if (strcmp(name, operators[i].name) == 0 && argc == operators[i].argc)
+			return compile_operator(g, env, operators[i].op, argc, name,
+			                        args);
+
+call:
+	if (argc < 0) {
+		g->failed = 1;
+		return 0;
+	}
+	return compile_call(g, env, compile(g, env, op), args);
+}
+
+static int compile(struct gen *g, struct env *env, lisp_value *expr)
+{
+	struct env *local;
+	int var;
+
+	if (g->failed)
+		return 0;
+
+	if (lisp_is(expr, type_symbol)) {
+		local = env_find(env, lisp_symbol_get((lisp_symbol *) expr));
+		if (local)
+			return local->var;
+		var = new_var(g);
+		line(g, "t%d = lisp_scope_lookup_string(rt, m, \"%s\");", var,
+		     lisp_symbol_get((lisp_symbol *) expr));
+		check(g, var);
+		return var;
+	} else if (lisp_is(expr, type_integer) || lisp_is(expr, type_bignum) ||
+	           lisp_is(expr, type_float) || lisp_is(expr, type_string)) {
+		return compile_constant(g, expr);
+	} else if (lisp_is(expr, type_list) && !lisp_nil_p(expr)) {
+		return compile_list(g, env, expr);
+	}
+
+	g->failed = 1;
+	return 0;
+}
+
+/*
+ * Compile fn, writing it to out. Returns false if it can't be compiled, in
+ * which case nothing is written.
+ */
+static int compile_function(struct compiler *cc, struct function *fn,
+                            FILE *out)
+{
+	struct gen g;
+	struct env *env = NULL, *new;
+	lisp_value *params;
+	int result, i, c;
+
+	g.cc = cc;
+	g.out = tmpfile();
+	g.depth = 1;
+	g.vars = 0;
+	g.argc = 0;
+	g.helpers = 0;
+	g.failed = 0;
+
+	for (params = (lisp_value *) fn->params; !lisp_nil_p(params);
+	     params = cdr(params)) {
+		new = malloc(sizeof(struct env));
+		new->name = lisp_symbol_get((lisp_symbol *) car(params));
+		new->var = new_var(&g);
+		new->next = env;
+		env = new;
+	}
+
+	result = compile_body(&g, env, (lisp_value *) fn->body);
+	line(&g, "return t%d;", result);
+
+	while (env) {
+		new = env->next;
+		free(env);
+		env = new;
+	}
+
+	if (g.failed) {
+		fclose(g.out);
+		return 0;
+	}
+	cc->helpers |= g.helpers;
+
+	function_signature(out, cc, fn);
+	fputs("\n{\n", out);
+	for (i = fn->nparams; i < g.vars; i++)
+		fprintf(out, "\tlisp_value *t%d;\n", i);
+	if (g.argc)
+		fprintf(out, "\tlisp_value *argv[%d];\n", g.argc);
+	fputs("\t(void) m;\n", out);
+	for (i = 0; i < fn->nparams; i++)
+		fprintf(out, "\t(void) t%d;\n", i);
+	rewind(g.out);
+	while ((c = fgetc(g.out)) != EOF)
+		fputc(c, out);
+	fputs("}\n\n", out);
+	fclose(g.out);
+	return 1;
+}
+
+/*
+ * Find the functions defined at the top level, and the names of macros.
+ * Functions which are defined more than once are left to the interpreter, since
+ * we couldn't tell which definition a call refers to. Likewise, a name which
+ * is also a builtin or an import refers to something else until it is defined,
+ * so it is always looked up at runtime.
+ */
+static void find_functions(struct compiler *cc)
+{
+	lisp_value *forms, *form, *value;
+	lisp_scope *builtins = lisp_new_default_scope(cc->rt);
+	struct function *fn;
+	char *name;
+	int n = length((lisp_value *) cc->forms), i, j;
+
+	cc->funcs = calloc(n, sizeof(struct function));
+	cc->macros = calloc(n, sizeof(char *));
+	cc->rebound = calloc(n, sizeof(char *));
+	cc->nfuncs = cc->nmacros = cc->nrebound = 0;
+
+	for (forms = (lisp_value *) cc->forms; !lisp_nil_p(forms);
+	     forms = cdr(forms)) {
+		form = car(forms);
+		if (length(form) < 2 || !lisp_is(car(cdr(form)), type_symbol) ||
+		    !(is_symbol(car(form), "define") ||
+		      is_symbol(car(form), "import")))
+			continue;
+
+		name = lisp_symbol_get((lisp_symbol *) car(cdr(form)));
+		if (is_symbol(car(form), "import") ||
+		    lisp_scope_lookup_string(cc->rt, builtins, name))
+			cc->rebound[cc->nrebound++] = name;
+		lisp_clear_error(cc->rt);
+		if (length(form) != 3 || !is_symbol(car(form), "define"))
+			continue;
+
+		value = car(cdr(cdr(form)));
+		if (length(value) >= 2 && is_symbol(car(value), "macro")) {
+			cc->macros[cc->nmacros++] = name;
+		} else if (length(value) >= 2 && is_symbol(car(value), "lambda") &&
+		           symbol_list(car(cdr(value)))) {
+			fn = &cc->funcs[cc->nfuncs++];
+			fn->form = form;
+			fn->name = name;
+			fn->params = (lisp_list *) car(cdr(value));
+			fn->body = (lisp_list *) cdr(cdr(value));
+			fn->nparams = length(car(cdr(value)));
+			fn->compiled = 1;
+		}
+	}
+
+	for (i = 0; i < cc->nfuncs; i++) {
+		for (j = 0; j < cc->nfuncs; j++) {
+			if (i != j && strcmp(cc->funcs[i].name, cc->funcs[j].name) == 0)
+				cc->funcs[i].compiled = 0;
+		}
+		if (is_macro(cc, cc->funcs[i].name))
+			cc->funcs[i].compiled = 0;
+	}
+}
+
+static char *prelude[] = {
+	"#include <limits.h>",
+	"#include <math.h>",
+	"#include <stdio.h>",
+	"",
+	"#include \"funlisp.h\"",
+	"",
+	"#define ISINT(v) lisp_is((v), type_integer)",
+	"#define INT(v) lisp_integer_get((lisp_integer *) (v))",
+	"/* integers small enough that +, - or * of two can't overflow a long */",
+	"#define HALF (1L << (sizeof(long) * CHAR_BIT / 2 - 1))",
+	"#define SMALL(v) (ISINT(v) && INT(v) > -HALF && INT(v) < HALF)",
+	"",
+};
+
+static char *helper_truthy[] = {
+	"static int cc_truthy(lisp_value *v)",
+	"{",
+	"\tif (ISINT(v))",
+	"\t\treturn INT(v) != 0;",
+	"\treturn lisp_is(v, type_bignum) ||",
+	"\t\t(lisp_is(v, type_float) && lisp_float_get((lisp_float *) v) != 0);",
+	"}",
+	"",
+};
+
+static char *helper_call_global[] = {
+	"static lisp_value *cc_call_global(lisp_runtime *rt, lisp_scope *scope,",
+	"                                  char *name, int argc, lisp_value **argv)",
+	"{",
+	"\tlisp_value *f = lisp_scope_lookup_string(rt, scope, name);",
+	"\tif (!f)",
+	"\t\treturn NULL;",
+	"\treturn lisp_call_v(rt, scope, f, argc, argv);",
+	"}",
+	"",
+};
+
+static void write_lines(FILE *out, char **lines, unsigned int n)
+{
+	unsigned int i;
+	for (i = 0; i < n; i++)
+		fprintf(out, "%s\n", lines[i]);
+}
+
+/*
+ * Functions may call each other directly, so when one can't be compiled, the
+ * others must be compiled again without assuming that they can call it.
+ */
+static void compile_functions(struct compiler *cc, FILE *out)
+{
+	FILE *tmp = NULL;
+	int i, changed = 1, c;
+
+	while (changed) {
+		if (tmp)
+			fclose(tmp);
+		tmp = tmpfile();
+		changed = 0;
+		cc->helpers = 0;
+		for (i = 0; i < cc->nfuncs; i++) {
+			if (!cc->funcs[i].compiled)
+				continue;
+			if (!compile_function(cc, &cc->funcs[i], tmp)) {
+				cc->funcs[i].compiled = 0;
+				changed = 1;
+			}
+		}
+	}
+
+	write_lines(out, prelude, nelem(prelude));
+	if (cc->helpers & HELPER_TRUTHY)
+		write_lines(out, helper_truthy, nelem(helper_truthy));
+	if (cc->helpers & HELPER_CALL_GLOBAL)
+		write_lines(out, helper_call_global, nelem(helper_call_global));
+
+	for (i = 0; i < cc->nfuncs; i++) {
+		if (!cc->funcs[i].compiled)
+			continue;
+		function_signature(out, cc, &cc->funcs[i]);
+		fputs(";\n", out);
+	}
+	fputs("\n", out);
+
+	rewind(tmp);
+	while ((c = fgetc(tmp)) != EOF)
+		fputc(c, out);
+	fclose(tmp);
+}
+
+static void write_wrapper(struct compiler *cc, struct function *fn, FILE *out)
+{
+	int i;
+
+	fputs("static lisp_value *", out);
+	function_name(out, cc, fn, 'b');
+	fputs("(lisp_runtime *rt, lisp_scope *scope,\n"
+	      "\tint argc, lisp_value **argv, void *user)\n{\n"
+	      "\t(void) scope;\n", out);
+	if (fn->nparams == 0)
+		fputs("\t(void) argv;\n", out);
+	fprintf(out, "\tif (argc < %d)\n"
+	        "\t\treturn lisp_error(rt, LE_2FEW, "
+	        "\"not enough arguments to lambda call\");\n", fn->nparams);
+	fprintf(out, "\tif (argc > %d)\n"
+	        "\t\treturn lisp_error(rt, LE_2MANY, "
+	        "\"too many arguments to lambda call\");\n", fn->nparams);
+	fputs("\treturn ", out);
+	function_name(out, cc, fn, 'f');
+	fputs("(rt, (lisp_scope *) user", out);
+	for (i = 0; i < fn->nparams; i++)
+		fprintf(out, ", argv[%d]", i);
+	fputs(");\n}\n\n", out);
+}
+
+static struct function *compiled_function(struct compiler *cc,
+                                          lisp_value *form)
+{
+	int i;
+	for (i = 0; i < cc->nfuncs; i++)
+		if (cc->funcs[i].form == form && cc->funcs[i].compiled)
+			return &cc->funcs[i];
+	return NULL;
+}
+
+static void write_module(struct compiler *cc, char *module, char *file,
+                         FILE *out)
+{
+	lisp_value *forms;
+	struct function *fn;
+	int i;
+
+	for (i = 0; i < cc->nfuncs; i++)
+		if (cc->funcs[i].compiled)
+			write_wrapper(cc, &cc->funcs[i], out);
+
+	fputs("lisp_module *create_", out);
+	c_ident(out, module);
+	fputs("_module(lisp_runtime *rt)\n{\n", out);
+	fputs("\tlisp_module *module = lisp_new_module(rt,\n"
+	      "\t\tlisp_string_new(rt, ", out);
+	c_string(out, module);
+	fputs(", 0),\n\t\tlisp_string_new(rt, ", out);
+	c_string(out, file);
+	fputs(", 0));\n", out);
+	fputs("\tlisp_scope *m = lisp_module_get_scope(module);\n\n", out);
+	fputs("\tlisp_scope_populate_builtins(rt, m);\n", out);
+
+	for (forms = (lisp_value *) cc->forms; !lisp_nil_p(forms);
+	     forms = cdr(forms)) {
+		fn = compiled_function(cc, car(forms));
+		if (fn) {
+			fputs("\tlisp_scope_add_builtin_v(rt, m, ", out);
+			c_string(out, fn->name);
+			fputs(", ", out);
+			function_name(out, cc, fn, 'b');
+			fputs(", m, 1);\n", out);
+		} else {
+			fputs("\tif (!lisp_eval(rt, m,\n\t\t", out);
+			construct(out, car(forms));
+			fputs("))\n\t\treturn NULL;\n", out);
+		}
+	}
+	fputs("\treturn module;\n}\n", out);
+}
+
+/* Like the funlisp binary, run the main function of the module */
+static void write_main(char *module, FILE *out)
+{
+	fputs("\nint main(int argc, char **argv)\n"
+	      "{\n"
+	      "\tlisp_runtime *rt = lisp_runtime_new();\n"
+	      "\tlisp_module *module;\n"
+	      "\tlisp_value *result = NULL;\n"
+	      "\tint rv = 0;\n"
+	      "\n"
+	      "\tlisp_enable_symcache(rt);\n"
+	      "\tlisp_enable_strcache(rt);\n"
+	      "\tmodule = create_", out);
+	c_ident(out, module);
+	fputs("_module(rt);\n"
+	      "\tif (module) {\n"
+	      "\t\tlisp_register_module(rt, module);\n"
+	      "\t\tresult = lisp_run_main_if_exists(rt,\n"
+	      "\t\t\tlisp_module_get_scope(module), argc, argv);\n"
+	      "\t}\n"
+	      "\tif (!module || !result) {\n"
+	      "\t\tlisp_print_error(rt, stderr);\n"
+	      "\t\trv = 1;\n"
+	      "\t} else if (lisp_is(result, type_integer)) {\n"
+	      "\t\trv = lisp_integer_get((lisp_integer *) result);\n"
+	      "\t}\n"
+	      "\tlisp_runtime_free(rt);\n"
+	      "\treturn rv;\n"
+	      "}\n", out);
+}
+
+/* The default module name is the file name, without directory or extension */
+static char *module_name(char *file)
+{
+	char *base = strrchr(file, '/'), *name, *dot;
+
+	base = base ? base + 1 : file;
+	name = malloc(strlen(base) + 1);
+	strcpy(name, base);
+	dot = strrchr(name, '.');
+	if (dot && dot != name)
+		*dot = '\0';
+	return name;
+}
+
+static int help(void)
+{
+	puts(
+		"Usage: funlisp-cc [options...] file  compile file to C\n"
+		"\n"
+		"Options:\n"
+		" -h        Show this help message and exit\n"
+		" -m NAME   Name of the module (default: the file name)\n"
+		" -o FILE   Write C to FILE (default: standard output)\n"
+		" -e        Also write a main() function, which runs the\n"
+		"           module's main function like the funlisp binary"
+	);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct compiler cc;
+	char *module = NULL, *output = NULL;
+	int opt, executable = 0, rv = 0;
+	lisp_value *code;
+	FILE *in, *out = stdout;
+
+	while ((opt = getopt(argc, argv, "hm:o:e")) != -1) {
+		switch (opt) {
+		case 'm':
+			module = optarg;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'e':
+			executable = 1;
+			break;
+		case 'h': /* fall through */
+		default:
+			return help();
+		}
+	}
+	if (optind != argc - 1)
+		return help();
+
+	in = fopen(argv[optind], "r");
+	if (!in) {
+		perror("open");
+		return 1;
+	}
+
+	cc.rt = lisp_runtime_new();
+	code = lisp_parse_progn_f(cc.rt, in);
+	fclose(in);
+	if (!code) {
+		lisp_print_error(cc.rt, stderr);
+		lisp_runtime_free(cc.rt);
+		return 1;
+	}
+
+	if (output) {
+		out = fopen(output, "w");
+		if (!out) {
+			perror("open");
+			lisp_runtime_free(cc.rt);
+			return 1;
+		}
+	}
+	if (!module)
+		module = module_name(argv[optind]);
+	else
+		module = strcpy(malloc(strlen(module) + 1), module);
+
+	/* skip the progn */
+	cc.forms = (lisp_list *) cdr(code);
+	find_functions(&cc);
+
+	fprintf(out, "/* Generated by funlisp-cc from %s */\n", argv[optind]);
+	compile_functions(&cc, out);
+	write_module(&cc, module, argv[optind], out);
+	if (executable)
+		write_main(module, out);
+
+	if (output && fclose(out) != 0) {
+		perror("write");
+		rv = 1;
+	}
+	free(module);
+	free(cc.funcs);
+	free(cc.macros);
+	free(cc.rebound);
+	lisp_runtime_free(cc.rt);
+	return rv;
+}
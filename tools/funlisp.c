@@ -23,6 +23,11 @@
 
 int disable_symcache = 0;
 int disable_strcache = 0;
+int enable_folding = 0;
+int enable_checking = 0;
+int disable_analysis = 0;
+int enable_jit = 0;
+int print_stats = 0;
 int line_continue = 0;
 extern char **environ;
 
@@ -195,6 +200,14 @@ int repl_run(void)
 		lisp_enable_symcache(rt);
 	if (!disable_strcache)
 		lisp_enable_strcache(rt);
+	if (enable_folding)
+		lisp_enable_folding(rt);
+	if (enable_checking)
+		lisp_enable_checking(rt);
+	if (disable_analysis)
+		lisp_disable_analysis(rt);
+	if (enable_jit)
+		lisp_enable_jit(rt);
 	scope = lisp_new_default_scope(rt);
 
 	repl_run_with_rt(rt, scope);
@@ -202,6 +215,20 @@ int repl_run(void)
 	return 0;
 }
 
+/**
+ * Print call site statistics, if they were requested.
+ */
+void stats(lisp_runtime *rt)
+{
+	struct lisp_quicken_stats qs;
+
+	if (!print_stats)
+		return;
+	lisp_get_quicken_stats(rt, &qs);
+	fprintf(stderr, "call sites specialized: %lu, deoptimized: %lu\n",
+	        qs.specialized, qs.deoptimized);
+}
+
 /**
  * Run a file with some arguments.
  */
@@ -224,6 +251,14 @@ int file_run(char *name, int argc, char **argv, int repl)
 		lisp_enable_symcache(rt);
 	if (!disable_strcache)
 		lisp_enable_strcache(rt);
+	if (enable_folding)
+		lisp_enable_folding(rt);
+	if (enable_checking)
+		lisp_enable_checking(rt);
+	if (disable_analysis)
+		lisp_disable_analysis(rt);
+	if (enable_jit)
+		lisp_enable_jit(rt);
 	scope = lisp_new_default_scope(rt);
 
 	if (!lisp_load_file(rt, scope, file)) {
@@ -246,6 +281,7 @@ int file_run(char *name, int argc, char **argv, int repl)
 	} else if (lisp_is(result, type_integer)) {
 		rv = lisp_integer_get((lisp_integer *) result);
 	}
+	stats(rt);
 	lisp_runtime_free(rt);
 	return rv;
 }
@@ -260,6 +296,13 @@ int help(void)
 		" -h   Show this help message and exit\n"
 		" -v   Show the funlisp version and exit\n"
 		" -x   When file is specified, load it and run REPL rather than main\n"
+		" -O   Fold constant expressions when functions are defined\n"
+		" -A   Disable analysis of special forms within functions\n"
+		" -C   Check calls within functions when they are defined\n"
+		" -J   Compile frequently called functions to machine code"
+	);
+	puts(
+		" -S   Print call site statistics after running file\n"
 		" -T   Disable sTring caching\n"
 		" -Y   Disable sYmbol caching"
 	);
@@ -276,7 +319,7 @@ int main(int argc, char **argv)
 {
 	int opt;
 	int file_repl = 0;
-	while ((opt = getopt(argc, argv, "hvxYT")) != -1) {
+	while ((opt = getopt(argc, argv, "hvxYTOACJS")) != -1) {
 		switch (opt) {
 		case 'x':
 			file_repl = 1;
@@ -290,6 +333,21 @@ int main(int argc, char **argv)
 		case 'Y':
 			disable_symcache = 1;
 			break;
+		case 'O':
+			enable_folding = 1;
+			break;
+		case 'A':
+			disable_analysis = 1;
+			break;
+		case 'C':
+			enable_checking = 1;
+			break;
+		case 'J':
+			enable_jit = 1;
+			break;
+		case 'S':
+			print_stats = 1;
+			break;
 		case 'h': /* fall through */
 		default:
 			return help();